@@ -0,0 +1,174 @@
+/*
+Copyright (c) 2014 Inaki Griego
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+		1. The origin of this software must not be misrepresented; you must not
+		claim that you wrote the original software. If you use this software
+		in a product, an acknowledgment in the product documentation would be
+		appreciated but is not required.
+
+		2. Altered source versions must be plainly marked as such, and must not be
+		misrepresented as being the original software.
+
+		3. This notice may not be removed or altered from any source
+		distribution.
+*/
+
+
+
+// Parallel algorithms benchmark: times parallelTransform, parallelReduce, parallelInclusiveScan, parallelCopyIf and parallelSort against their
+// sequential std counterparts over std::vector<float> of 1M, 10M and 100M elements (or the sizes given), checking both give the same result.
+//
+// Usage: algorithms [element numbers, 1000000 10000000 100000000 by default]
+//
+// Benchmarks use std::chrono so they need a C++11 compiler:
+//   g++ -O2 -std=c++11 -pthread algorithms.cpp ../../concurrency/*.cpp ../../concurrency/tinythread/tinythread.cpp -o algorithms
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include <numeric>
+#include <functional>
+#include <random>
+
+#include "../../concurrency/concurrency.h"
+
+using namespace Olagarro;
+using namespace Olagarro::Concurrency;
+
+typedef std::chrono::steady_clock SteadyClock;
+
+float transformation(float value)
+{
+	return value * 0.5f + 1.0f;
+}
+
+bool isBig(float value)
+{
+	return 0.5f < value;
+}
+
+template<typename Function>
+double milliseconds(Function function)
+{
+	const SteadyClock::time_point Start = SteadyClock::now();
+
+	function();
+
+	return std::chrono::duration<double, std::milli>(SteadyClock::now() - Start).count();
+}
+
+void printRow(const char* name, double sequential, double parallel, bool equal)
+{
+	std::cout << std::setw(16) << name << std::setw(14) << sequential << std::setw(14) << parallel << std::setw(10) << sequential / parallel
+			  << (equal? "" : "   MISMATCH") << "\n";
+}
+
+void benchmark(std::size_t elementNumber)
+{
+	std::vector<float> input(elementNumber);
+	std::mt19937 generator(12345);
+	std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+
+	for(float& value : input)
+	{
+		value = distribution(generator);
+	}
+
+	std::vector<float> sequential(elementNumber);
+	std::vector<float> parallel(elementNumber);
+
+	std::cout << "\n" << elementNumber << " elements\n";
+	std::cout << std::setw(16) << "algorithm" << std::setw(14) << "std (ms)" << std::setw(14) << "parallel (ms)" << std::setw(10) << "speedup" << "\n";
+
+	{
+		const double Sequential = milliseconds([&]{ std::transform(input.begin(), input.end(), sequential.begin(), transformation); });
+		const double Parallel = milliseconds([&]{ parallelTransform(input.begin(), input.end(), parallel.begin(), transformation); });
+
+		printRow("transform", Sequential, Parallel, sequential == parallel);
+	}
+
+	{
+		// Sums in double, so both results are close enough to compare despite the different order of additions
+		double sequentialSum = 0.0;
+		double parallelSum = 0.0;
+
+		const double Sequential = milliseconds([&]{ sequentialSum = std::accumulate(input.begin(), input.end(), 0.0); });
+		const double Parallel = milliseconds([&]{ parallelSum = parallelReduce(input.begin(), input.end(), 0.0); });
+
+		printRow("reduce", Sequential, Parallel, std::abs(sequentialSum - parallelSum) < 1e-6 * sequentialSum);
+	}
+
+	{
+		// Scanned in double for the same reason as reduce: both scans accumulate in input's type
+		const std::vector<double> doubles(input.begin(), input.end());
+		std::vector<double> sequentialScan(elementNumber);
+		std::vector<double> parallelScan(elementNumber);
+
+		const double Sequential = milliseconds([&]{ std::partial_sum(doubles.begin(), doubles.end(), sequentialScan.begin()); });
+		const double Parallel = milliseconds([&]{ parallelInclusiveScan(doubles.begin(), doubles.end(), parallelScan.begin(), std::plus<double>()); });
+
+		printRow("inclusive scan", Sequential, Parallel, std::abs(sequentialScan.back() - parallelScan.back()) < 1e-6 * sequentialScan.back());
+	}
+
+	{
+		std::vector<float>::iterator sequentialEnd;
+		std::vector<float>::iterator parallelEnd;
+
+		const double Sequential = milliseconds([&]{ sequentialEnd = std::copy_if(input.begin(), input.end(), sequential.begin(), isBig); });
+		const double Parallel = milliseconds([&]{ parallelEnd = parallelCopyIf(input.begin(), input.end(), parallel.begin(), isBig); });
+
+		printRow("copyIf", Sequential, Parallel, sequentialEnd - sequential.begin() == parallelEnd - parallel.begin() &&
+				 std::equal(sequential.begin(), sequentialEnd, parallel.begin()));
+	}
+
+	{
+		sequential = input;
+		parallel = input;
+
+		const double Sequential = milliseconds([&]{ std::sort(sequential.begin(), sequential.end()); });
+		const double Parallel = milliseconds([&]{ parallelSort(parallel.begin(), parallel.end()); });
+
+		printRow("sort", Sequential, Parallel, sequential == parallel);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<std::size_t> sizes;
+
+	for(int i = 1; i < argc; ++ i)
+	{
+		sizes.push_back(std::strtoul(argv[i], 0, 10));
+	}
+
+	if(sizes.empty())
+	{
+		sizes.push_back(1000000);
+		sizes.push_back(10000000);
+		sizes.push_back(100000000);
+	}
+
+	std::cout << "ThreadPool: " << ThreadPool::instance().threadNumber() << " JobThreads\n";
+	std::cout << std::fixed << std::setprecision(2);
+
+	for(std::size_t i = 0; i < sizes.size(); ++ i)
+	{
+		benchmark(sizes[i]);
+	}
+
+	std::cout << std::flush;
+
+	return 0;
+}
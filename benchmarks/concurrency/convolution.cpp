@@ -0,0 +1,171 @@
+/*
+Copyright (c) 2014 Inaki Griego
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+		1. The origin of this software must not be misrepresented; you must not
+		claim that you wrote the original software. If you use this software
+		in a product, an acknowledgment in the product documentation would be
+		appreciated but is not required.
+
+		2. Altered source versions must be plainly marked as such, and must not be
+		misrepresented as being the original software.
+
+		3. This notice may not be removed or altered from any source
+		distribution.
+*/
+
+
+
+
+// 2D convolution benchmark: applies a (2 * radius + 1)^2 box kernel to a width x height float image, once with a flat concurrentFor over every output
+// pixel (the 1D split) and once with concurrentFor2D for several tile sizes. Both produce exactly the same image, which is checked.
+//
+// Usage: convolution [width, 4096 by default] [height, 4096 by default] [radius, 3 by default] [passes, 5 by default]
+//
+// Benchmarks use std::chrono so they need a C++11 compiler:
+//   g++ -O2 -std=c++11 -pthread convolution.cpp ../../concurrency/*.cpp ../../concurrency/tinythread/tinythread.cpp -o convolution
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <algorithm>
+
+#include "../../concurrency/concurrency.h"
+
+using namespace Olagarro;
+using namespace Olagarro::Concurrency;
+
+struct Image
+{
+	Image(unsigned width, unsigned height) :
+		width(width),
+		height(height),
+		pixels(static_cast<std::size_t>(width) * height, 0.0f)
+	{
+	}
+
+	unsigned width;
+	unsigned height;
+	std::vector<float> pixels;
+};
+
+// Output pixel (row, column): average of the input pixels around it, clamping coordinates at the borders
+inline float convolve(const Image& input, int radius, int row, int column)
+{
+	const int Width = static_cast<int>(input.width);
+	const int Height = static_cast<int>(input.height);
+
+	float sum = 0.0f;
+
+	for(int y = row - radius; y <= row + radius; ++ y)
+	{
+		const float* inputRow = &input.pixels[static_cast<std::size_t>(std::min(std::max(y, 0), Height - 1)) * Width];
+
+		for(int x = column - radius; x <= column + radius; ++ x)
+		{
+			sum += inputRow[std::min(std::max(x, 0), Width - 1)];
+		}
+	}
+
+	return sum / static_cast<float>((2 * radius + 1) * (2 * radius + 1));
+}
+
+// 1D split: every output pixel is an element of the flat range
+struct FlatConvolution
+{
+	const Image* input;
+	int radius;
+
+	void operator()(int index, float& output) const
+	{
+		output = convolve(*input, radius, index / static_cast<int>(input->width), index % static_cast<int>(input->width));
+	}
+};
+
+struct TiledConvolution
+{
+	const Image* input;
+	Image* output;
+	int radius;
+
+	void operator()(const Tile2D& tile) const
+	{
+		for(unsigned row = tile.rowBegin; row < tile.rowEnd; ++ row)
+		{
+			float* outputRow = &output->pixels[static_cast<std::size_t>(row) * output->width];
+
+			for(unsigned column = tile.columnBegin; column < tile.columnEnd; ++ column)
+			{
+				outputRow[column] = convolve(*input, radius, row, column);
+			}
+		}
+	}
+};
+
+template<typename Function>
+double milliseconds(Function function, int passes)
+{
+	// Warm up
+	function();
+
+	const std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+
+	for(int i = 0; i < passes; ++ i)
+	{
+		function();
+	}
+
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - Start).count() / passes;
+}
+
+int main(int argc, char** argv)
+{
+	const unsigned Width = 1 < argc? std::strtoul(argv[1], 0, 10) : 4096;
+	const unsigned Height = 2 < argc? std::strtoul(argv[2], 0, 10) : 4096;
+	const int Radius = 3 < argc? std::atoi(argv[3]) : 3;
+	const int Passes = 4 < argc? std::atoi(argv[4]) : 5;
+
+	Image input(Width, Height);
+
+	for(std::size_t i = 0; i < input.pixels.size(); ++ i)
+	{
+		input.pixels[i] = static_cast<float>((i * 2654435761u) % 1000) / 1000.0f;
+	}
+
+	std::cout << "ThreadPool: " << ThreadPool::instance().threadNumber() << " JobThreads\n";
+	std::cout << Width << "x" << Height << " image, " << 2 * Radius + 1 << "x" << 2 * Radius + 1 << " kernel, " << Passes << " passes (ms per pass)\n";
+	std::cout << std::fixed << std::setprecision(2);
+
+	Image flat(Width, Height);
+	const FlatConvolution FlatFunctor = { &input, Radius };
+
+	const double FlatTime = milliseconds([&]{ concurrentFor(flat.pixels.begin(), flat.pixels.end(), FlatFunctor).result(); }, Passes);
+
+	std::cout << std::setw(20) << "1D split" << std::setw(12) << FlatTime << "\n";
+
+	const unsigned TileSizes[] = { 16, 32, 64, 128, 256 };
+
+	for(unsigned tileSize : TileSizes)
+	{
+		Image tiled(Width, Height);
+		const TiledConvolution TiledFunctor = { &input, &tiled, Radius };
+
+		const double TiledTime = milliseconds([&]{ concurrentFor2D(Height, Width, tileSize, TiledFunctor).result(); }, Passes);
+
+		std::cout << std::setw(14) << "tiles " << std::setw(3) << tileSize << "x" << std::setw(3) << std::left << tileSize << std::right
+				  << std::setw(10) << TiledTime << std::setw(10) << FlatTime / TiledTime << "x" << (tiled.pixels == flat.pixels? "" : "   MISMATCH") << "\n";
+	}
+
+	std::cout << std::flush;
+
+	return 0;
+}
@@ -0,0 +1,203 @@
+/*
+Copyright (c) 2014 Inaki Griego
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+		1. The origin of this software must not be misrepresented; you must not
+		claim that you wrote the original software. If you use this software
+		in a product, an acknowledgment in the product documentation would be
+		appreciated but is not required.
+
+		2. Altered source versions must be plainly marked as such, and must not be
+		misrepresented as being the original software.
+
+		3. This notice may not be removed or altered from any source
+		distribution.
+*/
+
+
+// Job queue benchmark: compares ThreadPool's lock-free pending job queue (MPMCQueue) with the std::queue + mutex it replaced.
+// Every producer thread pushes its share of the jobs while the same number of consumer threads pop them until all are consumed.
+//
+// Benchmarks use std::chrono so they need a C++11 compiler:
+//   g++ -O2 -std=c++11 -pthread jobqueue.cpp ../../concurrency/*.cpp ../../concurrency/tinythread/tinythread.cpp -o jobqueue
+
+#include <iostream>
+#include <iomanip>
+#include <queue>
+#include <vector>
+#include <chrono>
+
+#include "../../concurrency/concurrency.h"
+
+using namespace Olagarro;
+using namespace Olagarro::Concurrency;
+
+typedef Shared<Job, AtomicMTPolicy> JobPointer;
+
+class EmptyJob : public Job
+{
+public:
+	std::string name() const
+	{
+		return "EmptyJob";
+	}
+
+private:
+	void executeJob()
+	{
+	}
+};
+
+class MutexQueue
+{
+public:
+	void push(const JobPointer& job)
+	{
+		tthread::lock_guard<tthread::mutex> guard(mMutex);
+		mJobs.push(job);
+	}
+
+	bool pop(JobPointer& job)
+	{
+		tthread::lock_guard<tthread::mutex> guard(mMutex);
+
+		if(mJobs.empty())
+		{
+			return false;
+		}
+
+		job = mJobs.front();
+		mJobs.pop();
+		return true;
+	}
+
+private:
+	tthread::mutex mMutex;
+	std::queue<JobPointer> mJobs;
+};
+
+template<typename Queue>
+struct BenchmarkState
+{
+	BenchmarkState(const std::vector<JobPointer>& jobs, int producerNumber) :
+		jobs(jobs),
+		producerNumber(producerNumber),
+		started(0),
+		consumed(0)
+	{
+	}
+
+	Queue queue;
+	const std::vector<JobPointer>& jobs;
+	int producerNumber;
+	Atomic<int> started;
+	Atomic<int> consumed;
+};
+
+template<typename Queue>
+struct ThreadParam
+{
+	BenchmarkState<Queue>* state;
+	int index;
+};
+
+template<typename Queue>
+void producer(void* param)
+{
+	ThreadParam<Queue>* threadParam = static_cast<ThreadParam<Queue>*>(param);
+	BenchmarkState<Queue>& state = *threadParam->state;
+
+	while(0 == state.started.load())
+	{
+	}
+
+	for(std::size_t i = threadParam->index; i < state.jobs.size(); i += state.producerNumber)
+	{
+		state.queue.push(state.jobs[i]);
+	}
+}
+
+template<typename Queue>
+void consumer(void* param)
+{
+	BenchmarkState<Queue>& state = *static_cast<ThreadParam<Queue>*>(param)->state;
+	const int Total = static_cast<int>(state.jobs.size());
+
+	while(0 == state.started.load())
+	{
+	}
+
+	JobPointer job;
+
+	while(state.consumed.load(MemoryOrderRelaxed) < Total)
+	{
+		if(state.queue.pop(job))
+		{
+			state.consumed.fetchAdd(1);
+		}
+	}
+}
+
+template<typename Queue>
+double run(const std::vector<JobPointer>& jobs, int threadNumber)
+{
+	BenchmarkState<Queue> state(jobs, threadNumber);
+	std::vector< ThreadParam<Queue> > params(threadNumber);
+	std::vector<tthread::thread*> threads;
+
+	for(int i = 0; i < threadNumber; ++ i)
+	{
+		params[i].state = &state;
+		params[i].index = i;
+		threads.push_back(new tthread::thread(producer<Queue>, &params[i]));
+		threads.push_back(new tthread::thread(consumer<Queue>, &params[i]));
+	}
+
+	const std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+
+	state.started.store(1);
+
+	for(std::size_t i = 0; i < threads.size(); ++ i)
+	{
+		threads[i]->join();
+		delete threads[i];
+	}
+
+	const double Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+
+	return jobs.size() / Seconds;
+}
+
+int main(int /*argc*/, char** /*argv*/)
+{
+	const int JobNumber = 1000000;
+
+	std::vector<JobPointer> jobs;
+	jobs.reserve(JobNumber);
+
+	for(int i = 0; i < JobNumber; ++ i)
+	{
+		jobs.push_back(JobPointer(new EmptyJob()));
+	}
+
+	std::cout << "Push + pop throughput of " << JobNumber << " jobs (millions of jobs per second), producers = consumers\n";
+	std::cout << std::setw(10) << "producers" << std::setw(16) << "std::queue" << std::setw(16) << "MPMCQueue" << std::endl;
+
+	for(int threadNumber = 1; threadNumber <= 64; threadNumber *= 2)
+	{
+		const double MutexThroughput = run<MutexQueue>(jobs, threadNumber);
+		const double LockFreeThroughput = run< MPMCQueue<JobPointer> >(jobs, threadNumber);
+
+		std::cout << std::setw(10) << threadNumber << std::fixed << std::setprecision(2)
+				  << std::setw(16) << MutexThroughput / 1e6 << std::setw(16) << LockFreeThroughput / 1e6 << std::endl;
+	}
+
+	return 0;
+}
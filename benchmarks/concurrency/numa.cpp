@@ -0,0 +1,151 @@
+/*
+Copyright (c) 2014 Inaki Griego
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+		1. The origin of this software must not be misrepresented; you must not
+		claim that you wrote the original software. If you use this software
+		in a product, an acknowledgment in the product documentation would be
+		appreciated but is not required.
+
+		2. Altered source versions must be plainly marked as such, and must not be
+		misrepresented as being the original software.
+
+		3. This notice may not be removed or altered from any source
+		distribution.
+*/
+
+
+
+// NUMA bandwidth benchmark: streams over a large std::vector<float> with concurrentFor, once with its memory first touched by the main thread (so
+// every page lives in main thread's node) and once with its memory first touched by a concurrentFor over the same range (so every slice's pages
+// live in the node whose JobThreads process it). In single node machines both numbers should be about the same.
+//
+// Usage: numa [megabytes, 1024 by default] [passes, 20 by default]
+//
+// Benchmarks use std::chrono so they need a C++11 compiler:
+//   g++ -O2 -std=c++11 -pthread numa.cpp ../../concurrency/*.cpp ../../concurrency/tinythread/tinythread.cpp -o numa
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <algorithm>
+
+#include "../../concurrency/concurrency.h"
+
+using namespace Olagarro;
+using namespace Olagarro::Concurrency;
+
+// Leaves elements uninitialized, so vector's pages are first touched by whoever writes them first, not by its constructor
+template<typename T>
+struct DefaultInitAllocator : public std::allocator<T>
+{
+	template<typename U>
+	struct rebind
+	{
+		typedef DefaultInitAllocator<U> other;
+	};
+
+	DefaultInitAllocator() {}
+
+	template<typename U>
+	DefaultInitAllocator(const DefaultInitAllocator<U>&) {}
+
+	template<typename U>
+	void construct(U* pointer)
+	{
+		::new(static_cast<void*>(pointer)) U;
+	}
+
+	template<typename U, typename ... Args>
+	void construct(U* pointer, Args&& ... args)
+	{
+		::new(static_cast<void*>(pointer)) U(std::forward<Args>(args)...);
+	}
+};
+
+typedef std::vector< float, DefaultInitAllocator<float> > FloatVector;
+
+struct Fill
+{
+	void operator()(int /*index*/, float& value) const
+	{
+		value = 1.0f;
+	}
+};
+
+// Reads and writes every element: 8 bytes of traffic per element
+struct Scale
+{
+	void operator()(int /*index*/, float& value) const
+	{
+		value = value * 0.999f + 0.001f;
+	}
+};
+
+double bandwidth(FloatVector& values, int passes)
+{
+	// Warm up, so both cases start with the pages already mapped
+	concurrentFor(values.begin(), values.end(), Scale()).result();
+
+	const std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+
+	for(int i = 0; i < passes; ++ i)
+	{
+		concurrentFor(values.begin(), values.end(), Scale()).result();
+	}
+
+	const double Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+
+	return 2.0 * sizeof(float) * values.size() * passes / Seconds / 1e9;
+}
+
+int main(int argc, char** argv)
+{
+	const std::size_t Megabytes = 1 < argc? std::strtoul(argv[1], 0, 10) : 1024;
+	const int Passes = 2 < argc? std::atoi(argv[2]) : 20;
+	const std::size_t ElementNumber = Megabytes * 1024 * 1024 / sizeof(float);
+
+	const NumaTopology& topology = NumaTopology::system();
+
+	std::cout << "NUMA nodes: " << topology.nodeNumber() << "\n";
+
+	for(std::size_t i = 0; i < topology.nodeNumber(); ++ i)
+	{
+		std::cout << "  node " << topology.node(i).id << ": " << topology.node(i).cpus.size() << " CPUs\n";
+	}
+
+	std::cout << "ThreadPool: " << ThreadPool::instance().threadNumber() << " JobThreads in " << ThreadPool::instance().nodeNumber() << " nodes\n";
+	std::cout << "Streaming " << Megabytes << " MB, " << Passes << " passes (GB/s)\n";
+
+	double mainThreadTouch = 0.0;
+	double concurrentForTouch = 0.0;
+
+	{
+		FloatVector values(ElementNumber);
+		std::fill(values.begin(), values.end(), 1.0f);
+
+		mainThreadTouch = bandwidth(values, Passes);
+	}
+
+	{
+		FloatVector values(ElementNumber);
+		concurrentFor(values.begin(), values.end(), Fill()).result();
+
+		concurrentForTouch = bandwidth(values, Passes);
+	}
+
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << std::setw(28) << "main thread first touch" << std::setw(10) << mainThreadTouch << "\n";
+	std::cout << std::setw(28) << "concurrentFor first touch" << std::setw(10) << concurrentForTouch << std::endl;
+
+	return 0;
+}
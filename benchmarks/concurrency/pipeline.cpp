@@ -0,0 +1,255 @@
+/*
+Copyright (c) 2014 Inaki Griego
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+		1. The origin of this software must not be misrepresented; you must not
+		claim that you wrote the original software. If you use this software
+		in a product, an acknowledgment in the product documentation would be
+		appreciated but is not required.
+
+		2. Altered source versions must be plainly marked as such, and must not be
+		misrepresented as being the original software.
+
+		3. This notice may not be removed or altered from any source
+		distribution.
+*/
+
+
+
+
+// Pipeline benchmark: streams a file through three stages, read chunk (source) -> encode chunk (parallel) -> write chunk (serial in order), and
+// compares it with reading, encoding and writing every chunk in a sequential loop. Encoding applies a byte substitution and calculates the
+// chunk's CRC-32 bit by bit, so it costs more than reading and writing. Both outputs must be equal.
+//
+// Usage: pipeline [input file, a generated 128 MB file by default] [chunk size in KB, 256 by default] [tokens in flight, 2 per JobThread by default]
+//
+// Benchmarks use std::chrono so they need a C++11 compiler:
+//   g++ -O2 -std=c++11 -pthread pipeline.cpp ../../concurrency/*.cpp ../../concurrency/tinythread/tinythread.cpp -o pipeline
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <random>
+
+#include "../../concurrency/concurrency.h"
+
+using namespace Olagarro;
+using namespace Olagarro::Concurrency;
+
+const char* const GeneratedInput = "pipeline_input.tmp";
+const char* const SequentialOutput = "pipeline_sequential.tmp";
+const char* const PipelineOutput = "pipeline_pipeline.tmp";
+
+struct Chunk
+{
+	Chunk() :
+		size(0),
+		crc(0)
+	{
+	}
+
+	std::vector<unsigned char> data;
+	std::size_t size;
+	unsigned crc;
+};
+
+class ReadChunk
+{
+public:
+	ReadChunk(std::FILE* file, std::size_t chunkSize) :
+		mFile(file),
+		mChunkSize(chunkSize)
+	{
+	}
+
+	bool operator()(Chunk& chunk)
+	{
+		// Tokens are reused, so the buffer is only allocated the first time
+		chunk.data.resize(mChunkSize);
+		chunk.size = std::fread(&chunk.data[0], 1, mChunkSize, mFile);
+
+		return 0 < chunk.size;
+	}
+
+private:
+	std::FILE* mFile;
+	std::size_t mChunkSize;
+};
+
+void encodeChunk(Chunk& chunk)
+{
+	unsigned crc = 0xFFFFFFFFu;
+
+	for(std::size_t i = 0; i < chunk.size; ++ i)
+	{
+		crc ^= chunk.data[i];
+
+		for(int bit = 0; bit < 8; ++ bit)
+		{
+			crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+		}
+
+		chunk.data[i] = static_cast<unsigned char>(chunk.data[i] * 167u + 13u);
+	}
+
+	chunk.crc = ~crc;
+}
+
+class WriteChunk
+{
+public:
+	WriteChunk(std::FILE* file, unsigned long long& crcSum) :
+		mFile(file),
+		mCrcSum(&crcSum)
+	{
+	}
+
+	void operator()(Chunk& chunk)
+	{
+		std::fwrite(&chunk.data[0], 1, chunk.size, mFile);
+		*mCrcSum = *mCrcSum * 31 + chunk.crc;
+	}
+
+private:
+	std::FILE* mFile;
+	unsigned long long* mCrcSum;
+};
+
+void generateInput(const char* path, std::size_t size)
+{
+	std::FILE* file = std::fopen(path, "wb");
+	std::mt19937 generator(12345);
+	std::vector<unsigned char> buffer(1 << 20);
+
+	for(std::size_t written = 0; written < size; written += buffer.size())
+	{
+		for(std::size_t i = 0; i < buffer.size(); ++ i)
+		{
+			buffer[i] = static_cast<unsigned char>(generator());
+		}
+
+		std::fwrite(&buffer[0], 1, buffer.size(), file);
+	}
+
+	std::fclose(file);
+}
+
+bool equalFiles(const char* first, const char* second)
+{
+	std::FILE* firstFile = std::fopen(first, "rb");
+	std::FILE* secondFile = std::fopen(second, "rb");
+	std::vector<char> firstBuffer(1 << 20);
+	std::vector<char> secondBuffer(1 << 20);
+	bool equal = true;
+
+	while(equal)
+	{
+		const std::size_t FirstSize = std::fread(&firstBuffer[0], 1, firstBuffer.size(), firstFile);
+		const std::size_t SecondSize = std::fread(&secondBuffer[0], 1, secondBuffer.size(), secondFile);
+
+		equal = FirstSize == SecondSize && std::equal(firstBuffer.begin(), firstBuffer.begin() + FirstSize, secondBuffer.begin());
+
+		if(0 == FirstSize)
+		{
+			break;
+		}
+	}
+
+	std::fclose(firstFile);
+	std::fclose(secondFile);
+
+	return equal;
+}
+
+template<typename Function>
+double seconds(Function function)
+{
+	const std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+
+	function();
+
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+}
+
+int main(int argc, char** argv)
+{
+	const bool Generated = argc < 2;
+	const char* const Input = Generated? GeneratedInput : argv[1];
+	const std::size_t ChunkSize = 1024 * (2 < argc? std::strtoul(argv[2], 0, 10) : 256);
+	const std::size_t Tokens = 3 < argc? std::strtoul(argv[3], 0, 10) : 2 * ThreadPool::instance().threadNumber();
+
+	if(Generated)
+	{
+		generateInput(GeneratedInput, 128 << 20);
+	}
+
+	unsigned long long sequentialCrcs = 0;
+	unsigned long long pipelineCrcs = 0;
+	std::size_t bytes = 0;
+
+	const double Sequential = seconds([&]
+	{
+		std::FILE* input = std::fopen(Input, "rb");
+		std::FILE* output = std::fopen(SequentialOutput, "wb");
+		ReadChunk read(input, ChunkSize);
+		WriteChunk write(output, sequentialCrcs);
+		Chunk chunk;
+
+		while(read(chunk))
+		{
+			encodeChunk(chunk);
+			write(chunk);
+			bytes += chunk.size;
+		}
+
+		std::fclose(input);
+		std::fclose(output);
+	});
+
+	const double Parallel = seconds([&]
+	{
+		std::FILE* input = std::fopen(Input, "rb");
+		std::FILE* output = std::fopen(PipelineOutput, "wb");
+
+		Pipeline<Chunk>().source(ReadChunk(input, ChunkSize))
+						 .stage(ParallelStage, encodeChunk)
+						 .stage(SerialInOrderStage, WriteChunk(output, pipelineCrcs))
+						 .run(Tokens).result();
+
+		std::fclose(input);
+		std::fclose(output);
+	});
+
+	const bool Equal = sequentialCrcs == pipelineCrcs && equalFiles(SequentialOutput, PipelineOutput);
+
+	std::cout << "ThreadPool: " << ThreadPool::instance().threadNumber() << " JobThreads, " << Tokens << " tokens of " << ChunkSize / 1024
+			  << " KB\n";
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << std::setw(12) << "" << std::setw(12) << "seconds" << std::setw(12) << "MB/s" << "\n";
+	std::cout << std::setw(12) << "sequential" << std::setw(12) << Sequential << std::setw(12) << bytes / Sequential / (1 << 20) << "\n";
+	std::cout << std::setw(12) << "pipeline" << std::setw(12) << Parallel << std::setw(12) << bytes / Parallel / (1 << 20)
+			  << (Equal? "" : "   MISMATCH") << "\n";
+	std::cout << std::flush;
+
+	std::remove(SequentialOutput);
+	std::remove(PipelineOutput);
+
+	if(Generated)
+	{
+		std::remove(GeneratedInput);
+	}
+
+	return 0;
+}
@@ -0,0 +1,123 @@
+/*
+Copyright (c) 2014 Inaki Griego
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+		1. The origin of this software must not be misrepresented; you must not
+		claim that you wrote the original software. If you use this software
+		in a product, an acknowledgment in the product documentation would be
+		appreciated but is not required.
+
+		2. Altered source versions must be plainly marked as such, and must not be
+		misrepresented as being the original software.
+
+		3. This notice may not be removed or altered from any source
+		distribution.
+*/
+
+
+
+
+// Skewed workload benchmark: runs concurrentFor over elements whose cost grows with their index (the last ones cost much more than the first ones)
+// with every partitioner, to compare the static split against dynamic batches taken from a shared atomic cursor, and against adaptive splitting.
+//
+// Usage: skewed [element number, 200000 by default] [passes, 5 by default]
+//
+// Benchmarks use std::chrono so they need a C++11 compiler:
+//   g++ -O2 -std=c++11 -pthread skewed.cpp ../../concurrency/*.cpp ../../concurrency/tinythread/tinythread.cpp -o skewed
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <cmath>
+
+#include "../../concurrency/concurrency.h"
+
+using namespace Olagarro;
+using namespace Olagarro::Concurrency;
+
+// Element i costs about 1 + 64 * i / elementNumber iterations, so the last slice of a static split has much more work than the first one
+struct SkewedWork
+{
+	int elementNumber;
+
+	void operator()(int index, double& value) const
+	{
+		const int Iterations = 16 * (1 + 64 * static_cast<long long>(index) / elementNumber);
+
+		double result = value;
+
+		for(int i = 0; i < Iterations; ++ i)
+		{
+			result = std::sqrt(result + i);
+		}
+
+		value = result;
+	}
+};
+
+int main(int argc, char** argv)
+{
+	const int ElementNumber = 1 < argc? std::atoi(argv[1]) : 200000;
+	const int Passes = 2 < argc? std::atoi(argv[2]) : 5;
+
+	std::vector<double> values(ElementNumber, 1.0);
+	const SkewedWork Work = { ElementNumber };
+
+	struct Case
+	{
+		const char* name;
+		Partitioner partitioner;
+	};
+
+	const Case Cases[] =
+	{
+		{ "static", staticPartitioner() },
+		{ "fixed grain 1024", fixedGrainPartitioner(1024) },
+		{ "adaptive 64", adaptivePartitioner(64) },
+		{ "dynamic 16", dynamicPartitioner(16) },
+		{ "dynamic 64", dynamicPartitioner(64) },
+		{ "dynamic 256", dynamicPartitioner(256) },
+		{ "dynamic 1024", dynamicPartitioner(1024) }
+	};
+
+	std::cout << "ThreadPool: " << ThreadPool::instance().threadNumber() << " JobThreads\n";
+	std::cout << ElementNumber << " elements, " << Passes << " passes (ms per pass)\n";
+	std::cout << std::fixed << std::setprecision(2);
+
+	double staticTime = 0.0;
+
+	for(const Case& benchmarkCase : Cases)
+	{
+		// Warm up
+		concurrentFor(values.begin(), values.end(), Work, benchmarkCase.partitioner).result();
+
+		const std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+
+		for(int i = 0; i < Passes; ++ i)
+		{
+			concurrentFor(values.begin(), values.end(), Work, benchmarkCase.partitioner).result();
+		}
+
+		const double Time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - Start).count() / Passes;
+
+		if(0.0 == staticTime)
+		{
+			staticTime = Time;
+		}
+
+		std::cout << std::setw(20) << benchmarkCase.name << std::setw(12) << Time << std::setw(10) << staticTime / Time << "x\n";
+	}
+
+	std::cout << std::flush;
+
+	return 0;
+}
@@ -0,0 +1,114 @@
+/*
+Copyright (c) 2014 Inaki Griego
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+		1. The origin of this software must not be misrepresented; you must not
+		claim that you wrote the original software. If you use this software
+		in a product, an acknowledgment in the product documentation would be
+		appreciated but is not required.
+
+		2. Altered source versions must be plainly marked as such, and must not be
+		misrepresented as being the original software.
+
+		3. This notice may not be removed or altered from any source
+		distribution.
+*/
+
+
+
+
+// Tiny jobs benchmark: measures how fast ThreadPool hands out jobs which do almost nothing, so the cost is all in enqueueing, waking up and pulling.
+// - Burst: one thread launches a queue of tiny jobs (1M by default) and waits for all of them. Reports millions of jobs per second.
+// - Back to back: one thread launches a tiny job and waits for it before launching the next one. Reports microseconds per job.
+// Both run with JobThreads blocking as soon as they run out of work (spin 0, every job has to wake one up through the kernel), with the default
+// search spin and with a longer one.
+//
+// Usage: tinyjobs [job number, 1000000 by default] [JobThread number, hardware threads by default]
+//
+// Benchmarks use std::chrono so they need a C++11 compiler:
+//   g++ -O2 -std=c++11 -pthread tinyjobs.cpp ../../concurrency/*.cpp ../../concurrency/tinythread/tinythread.cpp -o tinyjobs
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include <cstdlib>
+#include <algorithm>
+
+#include "../../concurrency/concurrency.h"
+
+using namespace Olagarro;
+using namespace Olagarro::Concurrency;
+
+Atomic<int> doneJobs;
+
+void tinyJob()
+{
+	doneJobs.fetchAdd(1, MemoryOrderRelaxed);
+}
+
+double burstJobsPerSecond(int jobNumber)
+{
+	doneJobs.store(0);
+
+	const std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+
+	for(int i = 0; i < jobNumber; ++ i)
+	{
+		launchJob(tinyJob);
+	}
+
+	while(doneJobs.load() < jobNumber)
+	{
+		std::this_thread::yield();
+	}
+
+	return jobNumber / std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+}
+
+double backToBackMicroseconds(int jobNumber)
+{
+	const std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+
+	for(int i = 0; i < jobNumber; ++ i)
+	{
+		launchJob(tinyJob).result();
+	}
+
+	return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - Start).count() / jobNumber;
+}
+
+int main(int argc, char** argv)
+{
+	const int JobNumber = 1 < argc? std::atoi(argv[1]) : 1000000;
+	const unsigned ThreadNumber = 2 < argc? static_cast<unsigned>(std::atoi(argv[2])) : HardwareThreadNumber;
+
+	std::cout << "ThreadPool: " << ThreadNumber << " JobThreads\n";
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << std::setw(14) << "spin (us)" << std::setw(22) << "burst (M jobs/s)" << std::setw(26) << "back to back (us/job)" << "\n";
+
+	const Clock::Duration Spins[] = { 0, OLAGARRO_PARK_SPIN_NANOSECONDS, 200000 };
+
+	for(Clock::Duration spin : Spins)
+	{
+		ThreadPool pool(ThreadNumber);
+		pool.setParkSpin(spin);
+		ThreadPool::Scope scope(pool);
+
+		const double Burst = burstJobsPerSecond(JobNumber);
+		const double BackToBack = backToBackMicroseconds(std::max(1, JobNumber / 10));
+
+		std::cout << std::setw(14) << spin / 1000 << std::setw(22) << Burst / 1e6 << std::setw(26) << BackToBack << "\n";
+	}
+
+	std::cout << std::flush;
+
+	return 0;
+}
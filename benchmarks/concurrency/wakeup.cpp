@@ -0,0 +1,192 @@
+/*
+Copyright (c) 2014 Inaki Griego
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+		1. The origin of this software must not be misrepresented; you must not
+		claim that you wrote the original software. If you use this software
+		in a product, an acknowledgment in the product documentation would be
+		appreciated but is not required.
+
+		2. Altered source versions must be plainly marked as such, and must not be
+		misrepresented as being the original software.
+
+		3. This notice may not be removed or altered from any source
+		distribution.
+*/
+
+
+
+
+// Wake up latency benchmark:
+// - Ping-pong: two threads wake each other up in turns through a mutex and condition variable (the way BlockingThread used to park JobThreads) and
+//   through Parker, blocking at once on the futex and spinning first. Reports the average round trip.
+// - ThreadPool: launches tiny jobs into an idle pool, waiting gap microseconds between them, and reports how long it takes from enqueueing a job
+//   to a JobThread starting it, with and without spinning before parking.
+//
+// Usage: wakeup [rounds, 20000 by default] [gap in microseconds between pool jobs, 200 by default]
+//
+// Benchmarks use std::chrono so they need a C++11 compiler:
+//   g++ -O2 -std=c++11 -pthread wakeup.cpp ../../concurrency/*.cpp ../../concurrency/tinythread/tinythread.cpp -o wakeup
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <cstdlib>
+#include <algorithm>
+
+#include "../../concurrency/concurrency.h"
+#include "../../concurrency/parker.h"
+
+using namespace Olagarro;
+using namespace Olagarro::Concurrency;
+
+// The condition variable handshake BlockingThread used before Parker
+class CondVarParker
+{
+public:
+	CondVarParker() :
+		mNotified(false)
+	{
+	}
+
+	void park()
+	{
+		tthread::lock_guard<tthread::mutex> guard(mMutex);
+
+		while(!mNotified)
+		{
+			mCondVariable.wait(mMutex);
+		}
+
+		mNotified = false;
+	}
+
+	void unpark()
+	{
+		tthread::lock_guard<tthread::mutex> guard(mMutex);
+
+		mNotified = true;
+		mCondVariable.notify_one();
+	}
+
+private:
+	tthread::mutex mMutex;
+	tthread::condition_variable mCondVariable;
+	bool mNotified;
+};
+
+template<typename ParkerType>
+double pingPongMicroseconds(ParkerType& ping, ParkerType& pong, int rounds)
+{
+	std::thread ponger([&]
+	{
+		for(int i = 0; i < rounds; ++ i)
+		{
+			ping.park();
+			pong.unpark();
+		}
+	});
+
+	const std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+
+	for(int i = 0; i < rounds; ++ i)
+	{
+		ping.unpark();
+		pong.park();
+	}
+
+	const double Microseconds = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - Start).count();
+
+	ponger.join();
+
+	return Microseconds / rounds;
+}
+
+Atomic<long long> jobStart;
+
+void recordStart()
+{
+	jobStart.store(static_cast<long long>(Clock::now()));
+}
+
+// Median and 99th percentile of the time from enqueueing a job to its start, in microseconds
+void poolLatency(ThreadPool& pool, int rounds, int gapMicroseconds, double& median, double& percentile99)
+{
+	ThreadPool::Scope scope(pool);
+
+	std::vector<double> latencies;
+	latencies.reserve(rounds);
+
+	for(int i = 0; i < rounds; ++ i)
+	{
+		// Lets JobThreads go idle, and park if they don't spin that long
+		std::this_thread::sleep_for(std::chrono::microseconds(gapMicroseconds));
+
+		const Clock::TimePoint Enqueued = Clock::now();
+		launchJob(recordStart).result();
+
+		latencies.push_back((jobStart.load() - static_cast<long long>(Enqueued)) / 1000.0);
+	}
+
+	std::sort(latencies.begin(), latencies.end());
+	median = latencies[latencies.size() / 2];
+	percentile99 = latencies[latencies.size() * 99 / 100];
+}
+
+int main(int argc, char** argv)
+{
+	const int Rounds = 1 < argc? std::atoi(argv[1]) : 20000;
+	const int Gap = 2 < argc? std::atoi(argv[2]) : 200;
+
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << "Ping-pong, " << Rounds << " rounds (microseconds per round trip)\n";
+
+	{
+		CondVarParker ping;
+		CondVarParker pong;
+		std::cout << std::setw(28) << "mutex + condition variable" << std::setw(10) << pingPongMicroseconds(ping, pong, Rounds) << "\n";
+	}
+
+	{
+		Parker ping(0);
+		Parker pong(0);
+		std::cout << std::setw(28) << "Parker, no spin" << std::setw(10) << pingPongMicroseconds(ping, pong, Rounds) << "\n";
+	}
+
+	{
+		Parker ping;
+		Parker pong;
+		std::cout << std::setw(28) << "Parker, default spin" << std::setw(10) << pingPongMicroseconds(ping, pong, Rounds) << "\n";
+	}
+
+	const int PoolRounds = std::max(1, Rounds / 10);
+
+	std::cout << "\nThreadPool, " << PoolRounds << " jobs " << Gap << " us apart (microseconds from enqueue to start: median, 99th percentile)\n";
+
+	const Clock::Duration Spins[] = { 0, OLAGARRO_PARK_SPIN_NANOSECONDS, 1000ll * Gap * 2 };
+
+	for(Clock::Duration spin : Spins)
+	{
+		ThreadPool pool(4);
+		pool.setParkSpin(spin);
+
+		double median = 0.0;
+		double percentile99 = 0.0;
+		poolLatency(pool, PoolRounds, Gap, median, percentile99);
+
+		std::cout << std::setw(20) << "spin " << std::setw(8) << spin / 1000 << " us" << std::setw(10) << median << std::setw(10) << percentile99 << "\n";
+	}
+
+	std::cout << std::flush;
+
+	return 0;
+}
@@ -24,65 +24,138 @@ freely, subject to the following restrictions:
 #ifndef Shared_H
 #define Shared_H
 
-#include <cassert>
-
 namespace Olagarro
 {
 
 
-template<typename T>
-class Guard
+struct VoidMTPolicy
+{
+public:
+	VoidMTPolicy()
+	{
+	}
+	inline void lock(){}
+	inline void unlock(){}
+};
+
+
+/**
+ * @brief Reference counter used by Shared. MTPolicy's lock() and unlock() protect the count. It can be specialized for policies which don't need
+ * any lock (see AtomicMTPolicy in concurrency module)
+ */
+template<typename MTPolicy>
+class ReferenceCounter
 {
 public:
-	Guard(T** lockerObj) :
-		mLockerObj(lockerObj)
+	explicit ReferenceCounter(int count = 0) :
+		mCount(count)
 	{
-		assert(*lockerObj && "Guard::Guard(): Passed object is not a valid one");
-		(*mLockerObj)->lock();
 	}
-	~Guard()
+
+	void increase()
 	{
-		if(*mLockerObj)
-		{
-			(*mLockerObj)->unlock();
-		}
+		mPolicy.lock();
+		++ mCount;
+		mPolicy.unlock();
+	}
+
+	/**
+	 * @brief decrease
+	 * @return true if there are no more references
+	 */
+	bool decrease()
+	{
+		mPolicy.lock();
+		const bool Released = 0 >= -- mCount;
+		mPolicy.unlock();
+
+		return Released;
 	}
 
 private:
-	T** mLockerObj;
+	MTPolicy mPolicy;
+	int mCount;
 };
 
-struct VoidMTPolicy
+/**
+ * @brief Base class for objects which keep their own reference count (intrusive mode).
+ *
+ * Shared detects when T derives from ReferenceCounted<MTPolicy> and uses the counter inside the object instead of allocating one, so sharing an
+ * object costs no allocation at all apart from the object itself. It also makes safe to create several Shared objects from the same raw pointer.
+ */
+template<typename MTPolicy = VoidMTPolicy>
+class ReferenceCounted
 {
 public:
-	VoidMTPolicy()
+	//! Used by Shared, not meant to be called by client code
+	ReferenceCounter<MTPolicy>& referenceCounter()
 	{
+		return mReferenceCounter;
 	}
-	inline void lock(){}
-	inline void unlock(){}
+
+protected:
+	ReferenceCounted()
+	{
+	}
+
+	// Copies are new objects: they don't share the count of the original one
+	ReferenceCounted(const ReferenceCounted&)
+	{
+	}
+
+	ReferenceCounted& operator = (const ReferenceCounted&)
+	{
+		return *this;
+	}
+
+	~ReferenceCounted()
+	{
+	}
+
+private:
+	ReferenceCounter<MTPolicy> mReferenceCounter;
 };
 
+namespace Detail
+{
+
+// Overload resolution chooses the first version only if T derives from ReferenceCounted<MTPolicy>
+template<typename MTPolicy>
+inline ReferenceCounter<MTPolicy>* intrusiveCounter(ReferenceCounted<MTPolicy>* instance)
+{
+	return &instance->referenceCounter();
+}
+
+template<typename MTPolicy>
+inline ReferenceCounter<MTPolicy>* intrusiveCounter(...)
+{
+	return 0;
+}
+
+}
 
+/**
+ * @brief Reference counted smart pointer. MTPolicy tells how the reference count is protected: VoidMTPolicy (not thread safe), MutexMTPolicy or
+ * AtomicMTPolicy. If T derives from ReferenceCounted<MTPolicy> the count lives inside the instance, otherwise a counter is allocated along with it
+ */
 template<typename T, typename MTPolicy = VoidMTPolicy>
 class Shared
 {
 public:
 	Shared() :
-		mMTPolicyObj(0),
 		mInstance(0),
 		mCounter(0)
 	{
 	}
 
 	Shared(T* instance) :
-		mMTPolicyObj(instance? new MTPolicy() : 0),
 		mInstance(instance),
-		mCounter(instance? new int(1) : 0)
+		mCounter(0)
 	{
+		attach();
 	}
 
 	Shared(const Shared<T, MTPolicy>& other) :
-		mMTPolicyObj(other.mMTPolicyObj),
 		mInstance(other.mInstance),
 		mCounter(other.mCounter)
 	{
@@ -91,16 +164,11 @@ public:
 
 	Shared<T, MTPolicy>& operator = (const Shared<T, MTPolicy>& other)
 	{
-		if(this != &other)
+		if(mCounter != other.mCounter)
 		{
-			// Get rid of our old reference
-			decreaseReference();
-
-			mMTPolicyObj = other.mMTPolicyObj;
-			mInstance = other.mInstance;
-			mCounter = other.mCounter;
-
-			increaseReference();
+			// Take the new reference first, so releasing ours cannot destroy other's instance
+			Shared<T, MTPolicy> copy(other);
+			swap(copy);
 		}
 
 		return *this;
@@ -113,11 +181,19 @@ public:
 
 	void reset(T* instance)
 	{
-		decreaseReference();
+		Shared<T, MTPolicy> newShared(instance);
+		swap(newShared);
+	}
 
-		mMTPolicyObj = new MTPolicy();
-		mInstance = instance;
-		mCounter = new int(1);
+	void swap(Shared<T, MTPolicy>& other)
+	{
+		T* instance = mInstance;
+		mInstance = other.mInstance;
+		other.mInstance = instance;
+
+		ReferenceCounter<MTPolicy>* counter = mCounter;
+		mCounter = other.mCounter;
+		other.mCounter = counter;
 	}
 
 	const T* get() const
@@ -152,55 +228,62 @@ public:
 
 	bool isNull() const
 	{
-		return 0 == mCounter;
+		return 0 == mInstance;
 	}
 
 private:
-	void decreaseReference()
+	void attach()
 	{
-		if(!mMTPolicyObj)
+		if(!mInstance)
 		{
 			return;
 		}
 
-		Guard<MTPolicy> guard(&mMTPolicyObj);
+		mCounter = Detail::intrusiveCounter<MTPolicy>(mInstance);
 
-		// If mMTPolicyObj has been deleted while we were blocked
-		if(!mMTPolicyObj)
+		if(mCounter)
+		{
+			mCounter->increase();
+		}
+		else
+		{
+			mCounter = new ReferenceCounter<MTPolicy>(1);
+		}
+	}
+
+	void decreaseReference()
+	{
+		if(!mCounter)
 		{
 			return;
 		}
 
-		if(0 >= --(*mCounter))
+		if(mCounter->decrease())
 		{
-			delete mInstance;
-			mInstance = 0;
+			const bool Intrusive = 0 != Detail::intrusiveCounter<MTPolicy>(mInstance);
 
-			delete mCounter;
-			mCounter = 0;
+			delete mInstance;
 
-			mMTPolicyObj->unlock();
-			delete mMTPolicyObj;
-			mMTPolicyObj = 0;
+			if(!Intrusive)
+			{
+				delete mCounter;
+			}
 		}
+
+		mInstance = 0;
+		mCounter = 0;
 	}
 
 	void increaseReference()
 	{
-		if(!mMTPolicyObj)
+		if(mCounter)
 		{
-			return;
+			mCounter->increase();
 		}
-
-		Guard<MTPolicy> guard(&mMTPolicyObj);
-
-		++ (*mCounter);
 	}
 
-
-	MTPolicy* mMTPolicyObj;
 	T* mInstance;
-	int* mCounter;
+	ReferenceCounter<MTPolicy>* mCounter;
 };
 
 }
@@ -0,0 +1,225 @@
+/*
+Copyright (c) 2014 Inaki Griego
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+		1. The origin of this software must not be misrepresented; you must not
+		claim that you wrote the original software. If you use this software
+		in a product, an acknowledgment in the product documentation would be
+		appreciated but is not required.
+
+		2. Altered source versions must be plainly marked as such, and must not be
+		misrepresented as being the original software.
+
+		3. This notice may not be removed or altered from any source
+		distribution.
+*/
+
+
+#ifndef ATOMIC_H
+#define ATOMIC_H
+
+#include "tinythread/tinythread.h"
+
+#if defined(_MSC_VER)
+	#include <intrin.h>
+#endif
+
+namespace Olagarro
+{
+
+namespace Concurrency
+{
+
+/**
+ * @brief Memory orderings accepted by Atomic operations. They have the same meaning as C++11's std::memory_order values
+ */
+enum MemoryOrder
+{
+	MemoryOrderRelaxed,
+	MemoryOrderAcquire,
+	MemoryOrderRelease,
+	MemoryOrderAcquireRelease,
+	MemoryOrderSequential
+};
+
+#if defined(__GNUC__)
+
+namespace Detail
+{
+
+inline int gccMemoryOrder(MemoryOrder order)
+{
+	switch(order)
+	{
+	case MemoryOrderRelaxed:			return __ATOMIC_RELAXED;
+	case MemoryOrderAcquire:			return __ATOMIC_ACQUIRE;
+	case MemoryOrderRelease:			return __ATOMIC_RELEASE;
+	case MemoryOrderAcquireRelease:		return __ATOMIC_ACQ_REL;
+	default:							return __ATOMIC_SEQ_CST;
+	}
+}
+
+}
+
+#endif
+
+/**
+ * @brief Minimal atomic variable for integral and pointer types.
+ *
+ * Concurrency module is written in C++ 2003 so std::atomic is not available. This class offers the small subset of it the module needs, built on top of
+ * compiler intrinsics (GCC/Clang __atomic builtins and MSVC Interlocked functions). T must be an integral or pointer type of 4 or 8 bytes.
+ */
+template<typename T>
+class Atomic
+{
+public:
+	explicit Atomic(T value = T()) :
+		mValue(value)
+	{
+	}
+
+	T load(MemoryOrder order = MemoryOrderSequential) const
+	{
+#if defined(__GNUC__)
+		return __atomic_load_n(&mValue, Detail::gccMemoryOrder(order));
+#elif defined(_MSC_VER)
+		(void)order;
+		T value = mValue;
+		_ReadWriteBarrier();
+		return value;
+#endif
+	}
+
+	void store(T value, MemoryOrder order = MemoryOrderSequential)
+	{
+#if defined(__GNUC__)
+		__atomic_store_n(&mValue, value, Detail::gccMemoryOrder(order));
+#elif defined(_MSC_VER)
+		exchange(value, order);
+#endif
+	}
+
+	T exchange(T value, MemoryOrder order = MemoryOrderSequential)
+	{
+#if defined(__GNUC__)
+		return __atomic_exchange_n(&mValue, value, Detail::gccMemoryOrder(order));
+#elif defined(_MSC_VER)
+		(void)order;
+		T previous = load();
+		while(!compareExchange(previous, value))
+		{
+		}
+		return previous;
+#endif
+	}
+
+	/**
+	 * @brief compareExchange Stores desired if current value equals expected. Otherwise expected is updated with current value
+	 * @return true if the value has been replaced
+	 */
+	bool compareExchange(T& expected, T desired, MemoryOrder order = MemoryOrderSequential)
+	{
+#if defined(__GNUC__)
+		return __atomic_compare_exchange_n(&mValue, &expected, desired, false, Detail::gccMemoryOrder(order),
+										   MemoryOrderRelease == order || MemoryOrderAcquireRelease == order? __ATOMIC_ACQUIRE : Detail::gccMemoryOrder(order));
+#elif defined(_MSC_VER)
+		(void)order;
+		T previous = msvcCompareExchange(desired, expected);
+		if(previous == expected)
+		{
+			return true;
+		}
+		expected = previous;
+		return false;
+#endif
+	}
+
+	T fetchAdd(T value, MemoryOrder order = MemoryOrderSequential)
+	{
+#if defined(__GNUC__)
+		return __atomic_fetch_add(&mValue, value, Detail::gccMemoryOrder(order));
+#elif defined(_MSC_VER)
+		T previous = load();
+		while(!compareExchange(previous, previous + value, order))
+		{
+		}
+		return previous;
+#endif
+	}
+
+	T fetchSub(T value, MemoryOrder order = MemoryOrderSequential)
+	{
+#if defined(__GNUC__)
+		return __atomic_fetch_sub(&mValue, value, Detail::gccMemoryOrder(order));
+#elif defined(_MSC_VER)
+		T previous = load();
+		while(!compareExchange(previous, previous - value, order))
+		{
+		}
+		return previous;
+#endif
+	}
+
+	//! Address of the value, for operating system primitives which wait on a memory address (Linux futexes)
+	volatile T* address()
+	{
+		return &mValue;
+	}
+
+private:
+#if defined(_MSC_VER)
+	T msvcCompareExchange(T desired, T expected)
+	{
+		if(4 == sizeof(T))
+		{
+			return (T)_InterlockedCompareExchange(reinterpret_cast<volatile long*>(&mValue), (long)desired, (long)expected);
+		}
+		return (T)_InterlockedCompareExchange64(reinterpret_cast<volatile __int64*>(&mValue), (__int64)desired, (__int64)expected);
+	}
+#endif
+
+	Atomic(const Atomic&);
+	Atomic& operator = (const Atomic&);
+
+	volatile T mValue;
+};
+
+/**
+ * @brief Full memory barrier
+ */
+inline void atomicThreadFence(MemoryOrder order = MemoryOrderSequential)
+{
+#if defined(__GNUC__)
+	__atomic_thread_fence(Detail::gccMemoryOrder(order));
+#elif defined(_MSC_VER)
+	(void)order;
+	MemoryBarrier();
+#endif
+}
+
+/**
+ * @brief Tells the CPU calling thread is spinning: saves power and frees resources for the sibling hyperthread
+ */
+inline void cpuRelax()
+{
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+	__builtin_ia32_pause();
+#elif defined(__GNUC__) && (defined(__aarch64__) || defined(__arm__))
+	__asm__ __volatile__("yield");
+#elif defined(_MSC_VER)
+	YieldProcessor();
+#endif
+}
+
+}
+
+}
+
+#endif // ATOMIC_H
@@ -0,0 +1,74 @@
+/*
+Copyright (c) 2014 Inaki Griego
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+		1. The origin of this software must not be misrepresented; you must not
+		claim that you wrote the original software. If you use this software
+		in a product, an acknowledgment in the product documentation would be
+		appreciated but is not required.
+
+		2. Altered source versions must be plainly marked as such, and must not be
+		misrepresented as being the original software.
+
+		3. This notice may not be removed or altered from any source
+		distribution.
+*/
+
+
+#ifndef ATOMICMTPOLICY_H
+#define ATOMICMTPOLICY_H
+
+#include "atomic.h"
+#include "../common/shared.h"
+
+namespace Olagarro
+{
+
+namespace Concurrency
+{
+
+/**
+ * @brief Shared's policy for reference counts shared between threads without any lock: the count is an atomic integer, so copying a Shared is a
+ * single atomic increment
+ */
+struct AtomicMTPolicy
+{
+};
+
+}
+
+template<>
+class ReferenceCounter<Concurrency::AtomicMTPolicy>
+{
+public:
+	explicit ReferenceCounter(int count = 0) :
+		mCount(count)
+	{
+	}
+
+	void increase()
+	{
+		// Whoever copies a reference already owns one, so no ordering is needed
+		mCount.fetchAdd(1, Concurrency::MemoryOrderRelaxed);
+	}
+
+	bool decrease()
+	{
+		// Release our writes to the instance and, if we are the last owner, acquire everybody else's before deleting it
+		return 1 == mCount.fetchSub(1, Concurrency::MemoryOrderAcquireRelease);
+	}
+
+private:
+	Concurrency::Atomic<int> mCount;
+};
+
+}
+
+#endif // ATOMICMTPOLICY_H
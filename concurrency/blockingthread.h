@@ -26,6 +26,8 @@ freely, subject to the following restrictions:
 
 #include <string>
 #include "thread.h"
+#include "parker.h"
+#include "atomic.h"
 #include "../common/shared.h"
 #include <cassert>
 
@@ -36,7 +38,8 @@ namespace Concurrency
 {
 
 /**
- * @brief A thread which its blocked by default, does its job and then blocks itself again
+ * @brief A thread which its blocked by default, does its job and then blocks itself again. It blocks on a Parker, so resumeJob() wakes up this
+ * thread only and a resume requested shortly after the job ends does not even reach the kernel
  */
 template<typename HostClass>
 class BlockingThread : public Thread<HostClass>
@@ -44,8 +47,8 @@ class BlockingThread : public Thread<HostClass>
 public:
 	BlockingThread(const std::string& name) :
 		Thread<HostClass>(name),
-		mFinishThread(false),
-		mWorking(false)
+		mFinishThread(0),
+		mRequestedJobs(0)
 	{
 	}
 
@@ -66,21 +69,30 @@ public:
 	{
 		preJobTasks();
 
-		while(!mFinishThread)
+		while(true)
 		{
-			tthread::lock_guard<tthread::mutex> guard(mJobMutex);
-			mJobStartCondVar.wait(mJobMutex);
+			// A resumeJob() call done while we were working is not lost: its permit remains and park() returns immediately
+			mParker.park();
 
-			if(mFinishThread)
+			if(mFinishThread.load(MemoryOrderAcquire))
 			{
 				break; // If finish() has been called while we were blocked
 			}
 
+			// Requests seen here are served by this performJob() call
+			int servedJobs = mRequestedJobs.load(MemoryOrderAcquire);
+
 			performJob();
 
 			performBeforeBlocking();
 
-			mWorking = false;
+			// If nobody requested another job meanwhile we are not working anymore, otherwise the pending permit makes the loop run again
+			if(mRequestedJobs.compareExchange(servedJobs, 0, MemoryOrderAcquireRelease))
+			{
+				tthread::lock_guard<tthread::mutex> guard(mJobMutex);
+
+				mWaitCondVar.notify_all();
+			}
 		}
 
 		postJobTasks();
@@ -90,9 +102,8 @@ public:
 	{
 		assert(Thread<HostClass>::isRunning() && "BlockingThread::resumeJob(): thread is not running");
 
-		mWorking = true;
-
-		mJobStartCondVar.notify_all();
+		mRequestedJobs.fetchAdd(1, MemoryOrderRelease);
+		mParker.unpark();
 	}
 
 	/**
@@ -105,8 +116,12 @@ public:
 			return; // Thread already finished, just return
 		}
 
-		// Just try to lock mJobMutex. If thread is working then we get blocked until it finishes, otherwise thread is waiting and we can exit that method
 		tthread::lock_guard<tthread::mutex> guard(mJobMutex);
+
+		while(isWorking() && !mFinishThread.load())
+		{
+			mWaitCondVar.wait(mJobMutex);
+		}
 	}
 
 	/**
@@ -119,16 +134,27 @@ public:
 			return;
 		}
 
-		mFinishThread = true;
+		mFinishThread.store(1, MemoryOrderRelease);
+		mParker.unpark();
+
+		{
+			tthread::lock_guard<tthread::mutex> guard(mJobMutex);
 
-		mJobStartCondVar.notify_all();
+			mWaitCondVar.notify_all();
+		}
 
 		Thread<HostClass>::join();
 	}
 
 	bool isWorking() const
 	{
-		return mWorking;
+		return 0 != mRequestedJobs.load(MemoryOrderAcquire);
+	}
+
+	//! How long, in nanoseconds, the thread spins waiting for a new job before blocking in the kernel
+	void setParkSpin(Clock::Duration spin)
+	{
+		mParker.setSpin(spin);
 	}
 
 protected:
@@ -151,13 +177,13 @@ protected:
 	virtual void postJobTasks() {}
 
 private:
+	Parker mParker;
+	// Only used by waitForJob()
 	tthread::mutex mJobMutex;
-	tthread::mutex mWaitMutex;
-	mutable tthread::mutex mWorkingMutex;
-	tthread::condition_variable mJobStartCondVar;
 	tthread::condition_variable mWaitCondVar;
-	bool mFinishThread;
-	bool mWorking;
+	Atomic<int> mFinishThread;
+	// resumeJob() calls not served yet, not 0 while the thread is working
+	Atomic<int> mRequestedJobs;
 };
 
 }
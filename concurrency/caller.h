@@ -24,6 +24,17 @@ freely, subject to the following restrictions:
 #ifndef CALLER_H
 #define CALLER_H
 
+#include <new>
+#include "tinythread/tinythread.h"
+
+#if defined(_TTHREAD_CPP11_)
+	#include <cstddef>
+	#include <functional>
+	#include <tuple>
+	#include <type_traits>
+	#include <utility>
+#endif
+
 namespace Olagarro
 {
 
@@ -216,6 +227,191 @@ private:
 	Functor& mFunctor;
 };
 
+#if defined(_TTHREAD_CPP11_)
+
+namespace Detail
+{
+
+template<std::size_t ... Indices>
+struct IndexSequence
+{
+};
+
+template<std::size_t N, std::size_t ... Indices>
+struct MakeIndexSequence : MakeIndexSequence<N - 1, N - 1, Indices...>
+{
+};
+
+template<std::size_t ... Indices>
+struct MakeIndexSequence<0, Indices...>
+{
+	typedef IndexSequence<Indices...> Type;
+};
+
+// Calls functions, function pointers and functors
+template<typename Function, typename ... ParamTypes>
+auto invoke(Function& function, ParamTypes&& ... params) -> decltype(function(std::forward<ParamTypes>(params)...))
+{
+	return function(std::forward<ParamTypes>(params)...);
+}
+
+// Calls member functions: first parameter is the instance (an object, a pointer or a std::reference_wrapper)
+template<typename Method, typename ClassType, typename Instance, typename ... ParamTypes>
+auto invoke(Method ClassType::* method, Instance&& instance, ParamTypes&& ... params)
+	-> decltype(std::mem_fn(method)(std::forward<Instance>(instance), std::forward<ParamTypes>(params)...))
+{
+	return std::mem_fn(method)(std::forward<Instance>(instance), std::forward<ParamTypes>(params)...);
+}
+
+//! Type returned by calling a Function with ParamTypes parameters, as they are stored by VariadicCaller
+template<typename Function, typename ... ParamTypes>
+using InvokeResult = typename std::decay<decltype(invoke(std::declval<typename std::decay<Function>::type&>(),
+														 std::declval<typename std::decay<ParamTypes>::type>()...))>::type;
+
+}
+
+/**
+ * @brief Caller for any callable entity and any number of parameters (C++11 only). Callable and parameters are stored by value (moved in when they
+ * are rvalues) and parameters are moved into the call, same as std::thread or std::async do. Use std::ref to pass a reference
+ */
+template<typename ReturnType, typename Function, typename ... ParamTypes>
+class VariadicCaller : public Caller<ReturnType>
+{
+public:
+	template<typename FunctionArg, typename ... ParamArgs>
+	explicit VariadicCaller(FunctionArg&& function, ParamArgs&& ... params) :
+		mFunction(std::forward<FunctionArg>(function)),
+		mParams(std::forward<ParamArgs>(params)...)
+	{
+	}
+
+	ReturnType performCall()
+	{
+		return call(typename Detail::MakeIndexSequence<sizeof...(ParamTypes)>::Type());
+	}
+
+private:
+	template<std::size_t ... Indices>
+	ReturnType call(Detail::IndexSequence<Indices...>)
+	{
+		return Detail::invoke(mFunction, std::move(std::get<Indices>(mParams))...);
+	}
+
+	Function mFunction;
+	std::tuple<ParamTypes...> mParams;
+};
+
+#endif
+
+/**
+ * @brief Owns a Caller. Small callers (most of them: a function pointer and a parameter or two) are stored inside the object itself, bigger ones
+ * are allocated on the heap
+ */
+template<typename ReturnType>
+class CallerStorage
+{
+public:
+	CallerStorage() :
+		mCaller(0)
+	{
+	}
+
+#if defined(_TTHREAD_CPP11_)
+	// Callers are moved in, so parameters stored by value are never copied
+	template<typename CallerType>
+	explicit CallerStorage(CallerType&& caller)
+	{
+		typedef typename std::decay<CallerType>::type Type;
+
+		if(fitsInline<Type>())
+		{
+			mCaller = new(mStorage.buffer) Type(std::forward<CallerType>(caller));
+		}
+		else
+		{
+			mCaller = new Type(std::forward<CallerType>(caller));
+		}
+	}
+#else
+	template<typename CallerType>
+	explicit CallerStorage(const CallerType& caller)
+	{
+		if(fitsInline<CallerType>())
+		{
+			mCaller = new(mStorage.buffer) CallerType(caller);
+		}
+		else
+		{
+			mCaller = new CallerType(caller);
+		}
+	}
+#endif
+
+	~CallerStorage()
+	{
+		if(isInline())
+		{
+			mCaller->~Caller<ReturnType>();
+		}
+		else
+		{
+			delete mCaller;
+		}
+	}
+
+	ReturnType performCall()
+	{
+		return mCaller->performCall();
+	}
+
+private:
+	enum { InlineSize = 64 };
+
+	union InlineStorage
+	{
+		char buffer[InlineSize];
+		double alignDouble;
+		long long alignLongLong;
+		void* alignPointer;
+	};
+
+	// Alignment of Type: C++03 has no alignof, the padding before a Type that follows a char gives it
+	template<typename Type>
+	struct AlignmentOf
+	{
+#if defined(_TTHREAD_CPP11_)
+		enum { Value = alignof(Type) };
+#else
+		struct Probe
+		{
+			char first;
+			Type second;
+		};
+
+		enum { Value = sizeof(Probe) - sizeof(Type) };
+#endif
+	};
+
+	// Over-aligned callers (a parameter declared with alignas(32), for instance) go to the heap like big ones
+	template<typename Type>
+	static bool fitsInline()
+	{
+		return sizeof(Type) <= sizeof(InlineStorage) &&
+			   static_cast<int>(AlignmentOf<Type>::Value) <= static_cast<int>(AlignmentOf<InlineStorage>::Value);
+	}
+
+	bool isInline() const
+	{
+		return static_cast<const void*>(mCaller) == static_cast<const void*>(mStorage.buffer);
+	}
+
+	CallerStorage(const CallerStorage&);
+	CallerStorage& operator = (const CallerStorage&);
+
+	Caller<ReturnType>* mCaller;
+	InlineStorage mStorage;
+};
+
 }
 
 }
@@ -0,0 +1,54 @@
+#include "cancellation.h"
+
+namespace Olagarro
+{
+
+namespace Concurrency
+{
+
+thread_local const CancellationToken* CancellationToken::sCurrentToken = 0;
+
+CancellationToken::Scope::Scope(const CancellationToken& token) :
+	mToken(token),
+	mPreviousToken(sCurrentToken)
+{
+	sCurrentToken = &mToken;
+}
+
+CancellationToken::Scope::~Scope()
+{
+	sCurrentToken = mPreviousToken;
+}
+
+CancellationToken::CancellationToken() :
+	mState(new State())
+{
+}
+
+CancellationToken::CancellationToken(NoState)
+{
+}
+
+CancellationToken CancellationToken::none()
+{
+	return CancellationToken(NoState());
+}
+
+const CancellationToken& CancellationToken::current()
+{
+	static const CancellationToken noneToken = none();
+
+	return sCurrentToken? *sCurrentToken : noneToken;
+}
+
+void CancellationToken::cancel()
+{
+	if(!mState.isNull())
+	{
+		mState->cancelled.store(1, MemoryOrderRelease);
+	}
+}
+
+}
+
+}
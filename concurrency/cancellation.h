@@ -0,0 +1,136 @@
+/*
+Copyright (c) 2014 Inaki Griego
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+		1. The origin of this software must not be misrepresented; you must not
+		claim that you wrote the original software. If you use this software
+		in a product, an acknowledgment in the product documentation would be
+		appreciated but is not required.
+
+		2. Altered source versions must be plainly marked as such, and must not be
+		misrepresented as being the original software.
+
+		3. This notice may not be removed or altered from any source
+		distribution.
+*/
+
+
+#ifndef CANCELLATION_H
+#define CANCELLATION_H
+
+#include <stdexcept>
+#include "atomic.h"
+#include "atomicmtpolicy.h"
+#include "../common/shared.h"
+
+namespace Olagarro
+{
+
+namespace Concurrency
+{
+
+/**
+ * @brief Thrown by Future::result() and such when the job was cancelled before it was done
+ */
+class JobCancelled : public std::runtime_error
+{
+public:
+	JobCancelled() :
+		std::runtime_error("Job cancelled")
+	{
+	}
+};
+
+/**
+ * @brief Lets client code stop jobs it is not interested in anymore.
+ *
+ * Jobs created while a token is selected with a Scope (and jobs created by those jobs, like concurrentFor slices or continuations) are bound to it.
+ * Once the token is cancelled, bound jobs which have not started yet are dropped as soon as a JobThread takes them out of their queue, concurrentFor
+ * slices stop between elements and running functions can check CancellationToken::current().isCancelled() to finish early. Futures of cancelled
+ * jobs are ready: isCancelled() returns true and result() throws JobCancelled. cancel() does not look for queued jobs, so their futures become ready
+ * (and cancelled) only when a JobThread gets to them, after the jobs in front of them. A concurrentFor() whose slices all finished before the
+ * cancellation is not cancelled: its work is complete.
+ *
+ * \code
+ * CancellationToken token;
+ *
+ * {
+ *   CancellationToken::Scope scope(token);
+ *   thumbnails = concurrentFor(images.begin(), images.end(), MakeThumbnail());
+ * }
+ *
+ * // User closed the gallery
+ * token.cancel();
+ * \endcode
+ *
+ * Tokens are cheap handles: copies share the same state.
+ */
+class CancellationToken
+{
+public:
+	class Scope;
+
+	//! Creates a new token, not cancelled
+	CancellationToken();
+
+	//! Token which can never be cancelled, that of jobs created out of any Scope
+	static CancellationToken none();
+
+	/**
+	 * @brief current Token of calling thread: the one of the innermost Scope, which includes the token of the job being executed
+	 */
+	static const CancellationToken& current();
+
+	void cancel();
+
+	bool isCancelled() const
+	{
+		return !mState.isNull() && 0 != mState->cancelled.load(MemoryOrderAcquire);
+	}
+
+private:
+	struct State : public ReferenceCounted<AtomicMTPolicy>
+	{
+		Atomic<int> cancelled;
+	};
+
+	struct NoState
+	{
+	};
+
+	explicit CancellationToken(NoState);
+
+	static thread_local const CancellationToken* sCurrentToken;
+
+	Shared<State, AtomicMTPolicy> mState;
+};
+
+/**
+ * @brief Selects the token of jobs created by calling thread while the object lives. Scopes can be nested
+ */
+class CancellationToken::Scope
+{
+public:
+	explicit Scope(const CancellationToken& token);
+	~Scope();
+
+private:
+	Scope(const Scope&);
+	Scope& operator = (const Scope&);
+
+	CancellationToken mToken;
+	const CancellationToken* mPreviousToken;
+};
+
+}
+
+}
+
+#endif // CANCELLATION_H
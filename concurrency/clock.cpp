@@ -0,0 +1,41 @@
+#include "clock.h"
+
+#if defined(_TTHREAD_WIN32_)
+	#include <windows.h>
+#else
+	#include <time.h>
+#endif
+
+namespace Olagarro
+{
+
+namespace Concurrency
+{
+
+Clock::TimePoint Clock::now()
+{
+#if defined(_TTHREAD_WIN32_)
+	static LARGE_INTEGER frequency;
+	static bool frequencyQueried = 0 != QueryPerformanceFrequency(&frequency);
+
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+
+	// Split in seconds and remainder so multiplying by 10^9 does not overflow
+	const unsigned long long ticks = static_cast<unsigned long long>(counter.QuadPart);
+	const unsigned long long ticksPerSecond = static_cast<unsigned long long>(frequency.QuadPart);
+
+	(void)frequencyQueried;
+
+	return (ticks / ticksPerSecond) * 1000000000ull + ((ticks % ticksPerSecond) * 1000000000ull) / ticksPerSecond;
+#else
+	timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+
+	return static_cast<TimePoint>(time.tv_sec) * 1000000000ull + static_cast<TimePoint>(time.tv_nsec);
+#endif
+}
+
+}
+
+}
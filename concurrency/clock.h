@@ -0,0 +1,63 @@
+/*
+Copyright (c) 2014 Inaki Griego
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+		1. The origin of this software must not be misrepresented; you must not
+		claim that you wrote the original software. If you use this software
+		in a product, an acknowledgment in the product documentation would be
+		appreciated but is not required.
+
+		2. Altered source versions must be plainly marked as such, and must not be
+		misrepresented as being the original software.
+
+		3. This notice may not be removed or altered from any source
+		distribution.
+*/
+
+
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include "tinythread/tinythread.h"
+
+namespace Olagarro
+{
+
+namespace Concurrency
+{
+
+/**
+ * @brief Monotonic clock used for timed waits. Its values are only meaningful relative to each other: they are not affected by system time changes
+ */
+class Clock
+{
+public:
+	//! Nanoseconds since an unspecified starting point
+	typedef unsigned long long TimePoint;
+	//! Nanoseconds
+	typedef long long Duration;
+
+	static TimePoint now();
+
+	/**
+	 * @brief toDuration Converts a tinythread duration (tthread::chrono::milliseconds and such) to Clock's unit
+	 */
+	template<typename Rep, typename Period>
+	static Duration toDuration(const tthread::chrono::duration<Rep, Period>& duration)
+	{
+		return static_cast<Duration>(static_cast<double>(duration.count()) * Period::_as_double() * 1000000000.0);
+	}
+};
+
+}
+
+}
+
+#endif // CLOCK_H
@@ -27,14 +27,19 @@ freely, subject to the following restrictions:
 
 #include "job.h"
 #include "concurrentfor.h"
+#include "partitioner.h"
 #include "threadpool.h"
 #include "future.h"
+#include "parallelalgorithms.h"
+#include "tiles.h"
+#include "pipeline.h"
+#include <iterator>
 
 //! Olagarro namespace: It contains Olagarro's all classes, functions, etc.
 namespace Olagarro
 {
 
-/** @brief Concurrency module's namespace: Not all the classes that appear in this documentation are meant to be used by client code. In fact, only Future, launchJob and the two versions of concurrentFor are meant to be used
+/** @brief Concurrency module's namespace: Not all the classes that appear in this documentation are meant to be used by client code. In fact, only Future, launchJob, the two versions of concurrentFor, concurrentFor2D and concurrentFor3D, the parallel algorithms (parallelTransform, parallelReduce, parallelInclusiveScan, parallelExclusiveScan, parallelCopyIf and parallelSort), Partitioner, Pipeline (with StageMode), ThreadPool (to create pools and select them with ThreadPool::Scope), its telemetry (ThreadPoolTelemetry and TelemetryDumper) and Trace are meant to be used
  * by library's client code, all other classes are for internal use.
  */
 namespace Concurrency
@@ -48,13 +53,15 @@ namespace Concurrency
 template<typename ReturnType>
 Future<ReturnType> launchJob(ReturnType (*function)(void))
 {
-	Shared<Job, MutexMTPolicy> job(new CallerJob<ReturnType>(new Function0ParamCaller<ReturnType>(function)));
+	Shared<Job, AtomicMTPolicy> job(new CallerJob<ReturnType>(Function0ParamCaller<ReturnType>(function)));
 
-	ThreadPool::instance().enqueueJob(job);
+	ThreadPool::current().enqueueJob(job);
 
 	return Future<ReturnType>(job);
 }
 
+// In C++11 the variadic launchJob() covers this case and it also moves the parameter instead of copying it
+#if !defined(_TTHREAD_CPP11_)
 //! Launches a function asynchronously accepting a parameter
 /*!
 	\param function A free function which takes an argument and returns a value (void return type is also valid)
@@ -64,12 +71,13 @@ Future<ReturnType> launchJob(ReturnType (*function)(void))
 template<typename ReturnType, typename Param1Type>
 Future<ReturnType> launchJob(ReturnType (*function)(Param1Type), Param1Type param1)
 {
-	Shared<Job, MutexMTPolicy> job(new CallerJob<ReturnType>(new CopyFunction1ParamCaller<ReturnType, Param1Type>(function, param1)));
+	Shared<Job, AtomicMTPolicy> job(new CallerJob<ReturnType>(CopyFunction1ParamCaller<ReturnType, Param1Type>(function, param1)));
 
-	ThreadPool::instance().enqueueJob(job);
+	ThreadPool::current().enqueueJob(job);
 
 	return Future<ReturnType>(job);
 }
+#endif
 
 //! Launches a function asynchronously accepting a parameter
 /*!
@@ -80,9 +88,9 @@ Future<ReturnType> launchJob(ReturnType (*function)(Param1Type), Param1Type para
 template<typename ReturnType, typename Param1Type>
 Future<ReturnType> launchJob(ReturnType (*function)(const Param1Type&), const Param1Type& param1)
 {
-	Shared<Job, MutexMTPolicy> job(new CallerJob<ReturnType>(new ConstFunction1ParamCaller<ReturnType, Param1Type>(function, param1)));
+	Shared<Job, AtomicMTPolicy> job(new CallerJob<ReturnType>(ConstFunction1ParamCaller<ReturnType, Param1Type>(function, param1)));
 
-	ThreadPool::instance().enqueueJob(job);
+	ThreadPool::current().enqueueJob(job);
 
 	return Future<ReturnType>(job);
 }
@@ -97,9 +105,9 @@ Future<ReturnType> launchJob(ReturnType (*function)(const Param1Type&), const Pa
 template<typename ReturnType, typename Param1Type>
 Future<ReturnType> launchJob(ReturnType (*function)(Param1Type&), Param1Type& param1)
 {
-	Shared<Job, MutexMTPolicy> job(new CallerJob<ReturnType>(new Function1ParamCaller<ReturnType, Param1Type>(function, param1)));
+	Shared<Job, AtomicMTPolicy> job(new CallerJob<ReturnType>(Function1ParamCaller<ReturnType, Param1Type>(function, param1)));
 
-	ThreadPool::instance().enqueueJob(job);
+	ThreadPool::current().enqueueJob(job);
 
 	return Future<ReturnType>(job);
 }
@@ -114,9 +122,9 @@ Future<ReturnType> launchJob(ReturnType (*function)(Param1Type&), Param1Type& pa
 template<typename ReturnType, typename ClassType>
 Future<ReturnType> launchJob(ClassType& instance, ReturnType (ClassType::*method)())
 {
-	Shared<Job, MutexMTPolicy> job(new CallerJob<ReturnType>(new Method0ParamCaller<ClassType, ReturnType>(instance, method)));
+	Shared<Job, AtomicMTPolicy> job(new CallerJob<ReturnType>(Method0ParamCaller<ClassType, ReturnType>(instance, method)));
 
-	ThreadPool::instance().enqueueJob(job);
+	ThreadPool::current().enqueueJob(job);
 
 	return Future<ReturnType>(job);
 }
@@ -131,9 +139,9 @@ Future<ReturnType> launchJob(ClassType& instance, ReturnType (ClassType::*method
 template<typename ReturnType, typename ClassType, typename Param1Type>
 Future<ReturnType> launchJob(ClassType& instance, ReturnType (ClassType::*method)(Param1Type), Param1Type param1)
 {
-	Shared<Job, MutexMTPolicy> job(new CallerJob<ReturnType>(new CopyMethod1ParamCaller<ClassType, ReturnType, Param1Type>(instance, method, param1)));
+	Shared<Job, AtomicMTPolicy> job(new CallerJob<ReturnType>(CopyMethod1ParamCaller<ClassType, ReturnType, Param1Type>(instance, method, param1)));
 
-	ThreadPool::instance().enqueueJob(job);
+	ThreadPool::current().enqueueJob(job);
 
 	return Future<ReturnType>(job);
 }
@@ -148,9 +156,9 @@ Future<ReturnType> launchJob(ClassType& instance, ReturnType (ClassType::*method
 template<typename ReturnType, typename ClassType, typename Param1Type>
 Future<ReturnType> launchJob(ClassType& instance, ReturnType (ClassType::*method)(const Param1Type&), const Param1Type& param1)
 {
-	Shared<Job, MutexMTPolicy> job(new CallerJob<ReturnType>(new ConstMethod1ParamCaller<ClassType, ReturnType, Param1Type>(instance, method, param1)));
+	Shared<Job, AtomicMTPolicy> job(new CallerJob<ReturnType>(ConstMethod1ParamCaller<ClassType, ReturnType, Param1Type>(instance, method, param1)));
 
-	ThreadPool::instance().enqueueJob(job);
+	ThreadPool::current().enqueueJob(job);
 
 	return Future<ReturnType>(job);
 }
@@ -165,9 +173,9 @@ Future<ReturnType> launchJob(ClassType& instance, ReturnType (ClassType::*method
 template<typename ReturnType, typename ClassType, typename Param1Type>
 Future<ReturnType> launchJob(ClassType& instance, ReturnType (ClassType::*method)(Param1Type&), Param1Type& param1)
 {
-	Shared<Job, MutexMTPolicy> job(new CallerJob<ReturnType>(new Method1ParamCaller<ClassType, ReturnType, Param1Type>(instance, method, param1)));
+	Shared<Job, AtomicMTPolicy> job(new CallerJob<ReturnType>(Method1ParamCaller<ClassType, ReturnType, Param1Type>(instance, method, param1)));
 
-	ThreadPool::instance().enqueueJob(job);
+	ThreadPool::current().enqueueJob(job);
 
 	return Future<ReturnType>(job);
 }
@@ -175,7 +183,8 @@ Future<ReturnType> launchJob(ClassType& instance, ReturnType (ClassType::*method
 
 //! Launches a functor's operator () asynchronously
 /*!
-	As concurrency module only offers 0 or 1 parameter function/method versions, functors versions allow to encapsulate more elaborated calls.
+	As concurrency module only offers 0 or 1 parameter function/method versions in C++ 2003 (C++11 has a variadic version), functors versions allow to
+	encapsulate more elaborated calls.
 	For example if we have this function:
 
 	\code
@@ -215,9 +224,9 @@ Future<ReturnType> launchJob(ClassType& instance, ReturnType (ClassType::*method
 template<typename ReturnType, typename Functor>
 Future<ReturnType> launchJob(const Functor& functor)
 {
-	Shared<Job, MutexMTPolicy> job(new CallerJob<ReturnType>(new ConstFunctor0ParamCaller<ReturnType, Functor>(functor)));
+	Shared<Job, AtomicMTPolicy> job(new CallerJob<ReturnType>(ConstFunctor0ParamCaller<ReturnType, Functor>(functor)));
 
-	ThreadPool::instance().enqueueJob(job);
+	ThreadPool::current().enqueueJob(job);
 
 	return Future<ReturnType>(job);
 }
@@ -228,14 +237,73 @@ Future<ReturnType> launchJob(const Functor& functor)
 template<typename ReturnType, typename Functor>
 Future<ReturnType> launchJob(Functor& functor)
 {
-	Shared<Job, MutexMTPolicy> job(new CallerJob<ReturnType>(new Functor0ParamCaller<ReturnType, Functor>(functor)));
+	Shared<Job, AtomicMTPolicy> job(new CallerJob<ReturnType>(Functor0ParamCaller<ReturnType, Functor>(functor)));
 
-	ThreadPool::instance().enqueueJob(job);
+	ThreadPool::current().enqueueJob(job);
 
 	return Future<ReturnType>(job);
 }
 
 
+#if defined(_TTHREAD_CPP11_)
+
+namespace Detail
+{
+
+// A non const lvalue binds better to the variadic launchJob() than to the const& overload, which would then copy it instead of referencing it
+template<typename Function, typename ... ParamTypes>
+struct IsConstReferenceCall : std::false_type
+{
+};
+
+template<typename ReturnType, typename ParamType>
+struct IsConstReferenceCall<ReturnType (*)(const ParamType&), ParamType&> : std::true_type
+{
+};
+
+}
+
+//! Launches any callable entity asynchronously with any number of parameters (C++11 only)
+/*!
+	Function and parameters are stored in the job by value: rvalues are moved in and lvalues copied, so big buffers can be handed over to the job
+	without any copy using std::move. When the job runs, stored parameters are moved into the call, so move-only types are also accepted. Use std::ref
+	or std::cref to pass a reference instead, in which case it's up to the caller to keep the object alive and to deal with synchronization issues.
+
+	\code
+	std::vector<float> samples(loadSamples());
+
+	// No wrapper functor needed for several parameters, and samples is moved into the job instead of copied
+	Future<float> rms = launchJob([](const std::vector<float>& data, float gain, int channel) { return computeRms(data, gain, channel); },
+								  std::move(samples), 0.5f, 2);
+
+	// Member functions take the instance (an object, a pointer or a std::ref) as first parameter
+	Future<bool> saved = launchJob(&Document::save, &document, std::string("file.txt"));
+	\endcode
+
+	Calls matching one of the other launchJob() overloads exactly (the ones for 0 or 1 parameter functions and methods) still use them, so they behave
+	as in C++98: a function taking a const reference called with a non const lvalue gets that object by reference, not a copy, and it must outlive
+	the job. Pass an rvalue (std::move or a temporary) to have it stored in the job instead.
+
+	\param function A free function, function pointer, functor, lambda or member function
+	\param params function's parameters
+	\return A Future which will contain function's result once it finishes its job
+*/
+template<typename Function, typename ... ParamTypes>
+typename std::enable_if<!Detail::IsConstReferenceCall<typename std::decay<Function>::type, ParamTypes...>::value,
+						Future< Detail::InvokeResult<Function, ParamTypes...> > >::type launchJob(Function&& function, ParamTypes&& ... params)
+{
+	typedef Detail::InvokeResult<Function, ParamTypes...> ReturnType;
+	typedef VariadicCaller<ReturnType, typename std::decay<Function>::type, typename std::decay<ParamTypes>::type...> CallerType;
+
+	Shared<Job, AtomicMTPolicy> job(new CallerJob<ReturnType>(CallerType(std::forward<Function>(function), std::forward<ParamTypes>(params)...)));
+
+	ThreadPool::current().enqueueJob(job);
+
+	return Future<ReturnType>(job);
+}
+
+#endif
+
 template<typename ParamType>
 class Param1WrapperFunctor
 {
@@ -259,12 +327,13 @@ private:
 	\param begin Range's start position iterator
 	\param end Range's end position iterator
 	\param function A function which takes range's type's reference as parameter. This reference will be used to change range's current element
+	\param partitioner How the range is divided in slices, see Partitioner. By default one slice per CPU
 	\return A Future<void>. This object is used to know when concurrentFor has finished its job
 */
 template<typename InputIterator, typename ParamType>
-Future<void> concurrentFor(InputIterator begin, InputIterator end, void (*function)(ParamType&))
+Future<void> concurrentFor(InputIterator begin, InputIterator end, void (*function)(ParamType&), const Partitioner& partitioner = Partitioner())
 {
-	return concurrentFor(begin, end, Param1WrapperFunctor<ParamType>(function));
+	return concurrentFor(begin, end, Param1WrapperFunctor<ParamType>(function), partitioner);
 }
 
 template<typename ParamType>
@@ -289,30 +358,61 @@ private:
 	\param begin Range's start position iterator
 	\param end Range's end position iterator
 	\param function A function which takes element's index and element's reference as parameters
+	\param partitioner How the range is divided in slices, see Partitioner
 	\return A Future<void>. This object is used to know when concurrentFor has finished its job
 */
 template<typename InputIterator, typename ParamType>
-Future<void> concurrentFor(InputIterator begin, InputIterator end, void (*function)(int index, ParamType&))
+Future<void> concurrentFor(InputIterator begin, InputIterator end, void (*function)(int index, ParamType&), const Partitioner& partitioner = Partitioner())
 {
-	return concurrentFor(begin, end, Param2WrapperFunctor<ParamType>(function));
+	return concurrentFor(begin, end, Param2WrapperFunctor<ParamType>(function), partitioner);
 }
 
 
+// concurrentFor() for random access ranges
+template<typename InputIterator, typename Functor>
+Future<void> launchConcurrentFor(InputIterator begin, InputIterator end, const Functor& functor, const Partitioner& partitioner,
+								 std::random_access_iterator_tag)
+{
+	Shared<Job, AtomicMTPolicy> job(new ConcurrentForJob<InputIterator, Functor>(begin, end, functor, partitioner));
+
+	if(partitioner.isSerial(end - begin))
+	{
+		job->execute();
+	}
+	else
+	{
+		ThreadPool::current().enqueueJob(job);
+	}
+
+	return Future<void>(job);
+}
+
+// concurrentFor() for forward and bidirectional ranges: range's size is unknown, so it is always launched as a job
+template<typename InputIterator, typename Functor>
+Future<void> launchConcurrentFor(InputIterator begin, InputIterator end, const Functor& functor, const Partitioner& partitioner,
+								 std::forward_iterator_tag)
+{
+	Shared<Job, AtomicMTPolicy> job(new ForwardConcurrentForJob<InputIterator, Functor>(begin, end, functor, partitioner));
+
+	ThreadPool::current().enqueueJob(job);
+
+	return Future<void>(job);
+}
+
 //! This version expects a functor which defines operator() accepting 2 parameters: first one a current's element index and the second one the element's reference
-/*!
-\param begin Range's start position iterator
+/*! Ranges without random access iterators (std::list, std::map...) are supported too: they are walked once to find where every chunk of elements starts,
+	keeping a few iterators per JobThread, and then chunks are processed concurrently, so they don't need to be copied into a vector first.
+\param begin Range's start position iterator. At least a forward iterator
 \param end Range's end position iterator
 \param functor A functor which operator () takes element's index and element's reference as parameters
+\param partitioner How the range is divided in slices, see Partitioner. Random access ranges not bigger than its grain size are executed by the calling thread before returning.
+For other ranges its grain size is the minimum number of elements per chunk
 \return A Future<void>. This object is used to know when concurrentFor has finished its job
 */
 template<typename InputIterator, typename Functor>
-Future<void> concurrentFor(InputIterator begin, InputIterator end, const Functor& functor)
+Future<void> concurrentFor(InputIterator begin, InputIterator end, const Functor& functor, const Partitioner& partitioner = Partitioner())
 {
-	Shared<Job, MutexMTPolicy> job(new ConcurrentForJob<InputIterator, Functor>(begin, end, functor));
-
-	ThreadPool::instance().enqueueJob(job);
-
-	return Future<void>(job);
+	return launchConcurrentFor(begin, end, functor, partitioner, typename std::iterator_traits<InputIterator>::iterator_category());
 }
 
 //! This version executes for concurrently and also applies a merging or reducing method.
@@ -350,19 +450,89 @@ Future<void> concurrentFor(InputIterator begin, InputIterator end, const Functor
 
 		\param begin Range's start position iterator
 		\param end Range's end position iterator
-		\param functor A functor with operator () and merge() methods defined (see example). Be aware that functor will be copied many times (each thread has its own copy and so does Future return object)
+		\param functor A functor with operator () and merge() methods defined (see example). Be aware that functor will be copied many times (each slice or thread has its own copy and so does Future return object)
+		\param partitioner How the range is divided in slices, see Partitioner. Ranges not bigger than its grain size are executed by the calling thread before returning
+		\param accumulation Whether every slice or every thread gets its own copy of functor, see Accumulation. Copies are merged pairwise in parallel, in no particular order
 		\return A Future<FunctorType> which holds functor's copy
 */
 template<typename InputIterator, typename Functor>
-Future<Functor> concurrentReductorFor(InputIterator begin, InputIterator end, Functor functor)
+Future<Functor> concurrentReductorFor(InputIterator begin, InputIterator end, Functor functor, const Partitioner& partitioner = Partitioner(),
+									  Accumulation accumulation = SliceAccumulators)
 {
-	Shared<Job, MutexMTPolicy> job(new ConcurrentReductorForJob<InputIterator, Functor>(begin, end, functor));
+	Shared<Job, AtomicMTPolicy> job(new ConcurrentReductorForJob<InputIterator, Functor>(begin, end, functor, partitioner, accumulation));
 
-	ThreadPool::instance().enqueueJob(job);
+	if(partitioner.isSerial(end - begin))
+	{
+		job->execute();
+	}
+	else
+	{
+		ThreadPool::current().enqueueJob(job);
+	}
 
 	return Future<Functor>(job);
 }
 
+//! Launches a functor concurrently over the tiles of a 2D grid
+/*! The grid of rows x columns elements is divided in square tiles of tileSize x tileSize elements (smaller at right and bottom borders), which are
+	distributed among the JobThreads like concurrentFor() does with elements. Tiles are numbered in row major order and slices take contiguous tiles,
+	so a tile small enough to fit in cache keeps its rows' neighbours in cache too, unlike a flat concurrentFor over every element:
+	\code
+	struct Blur
+	{
+		void operator () (const Olagarro::Concurrency::Tile2D& tile)
+		{
+			for(unsigned row = tile.rowBegin; row < tile.rowEnd; ++ row)
+			{
+				for(unsigned column = tile.columnBegin; column < tile.columnEnd; ++ column)
+				{
+					// Read input's neighbours of (row, column) and write output
+				}
+			}
+		}
+	};
+
+	concurrentFor2D(height, width, 64, Blur()).result();
+	\endcode
+	\param rows Grid's row number
+	\param columns Grid's column number
+	\param tileSize Tiles' side in elements. The grid can have up to INT_MAX tiles
+	\param functor A functor which operator () takes a const Tile2D&. Each slice has its own copy
+	\param partitioner How the tiles are divided in slices, see Partitioner. Its grain size is in tiles
+	\return A Future<void>. This object is used to know when concurrentFor2D has finished its job
+*/
+template<typename Functor>
+Future<void> concurrentFor2D(unsigned rows, unsigned columns, unsigned tileSize, const Functor& functor, const Partitioner& partitioner = Partitioner())
+{
+	tileSize = std::max(1u, tileSize);
+
+	const unsigned TileNumber = gridTileNumber(tileNumber(rows, tileSize), tileNumber(columns, tileSize));
+
+	return concurrentFor(CountingIterator(0), CountingIterator(TileNumber), Tile2DFunctor<Functor>(rows, columns, tileSize, functor), partitioner);
+}
+
+//! Same as concurrentFor2D() for a 3D grid of layers x rows x columns elements, divided in cubic tiles
+/*!
+	\param layers Grid's layer number
+	\param rows Grid's row number
+	\param columns Grid's column number
+	\param tileSize Tiles' side in elements. The grid can have up to INT_MAX tiles
+	\param functor A functor which operator () takes a const Tile3D&. Each slice has its own copy
+	\param partitioner How the tiles are divided in slices, see Partitioner. Its grain size is in tiles
+	\return A Future<void>. This object is used to know when concurrentFor3D has finished its job
+*/
+template<typename Functor>
+Future<void> concurrentFor3D(unsigned layers, unsigned rows, unsigned columns, unsigned tileSize, const Functor& functor,
+							 const Partitioner& partitioner = Partitioner())
+{
+	tileSize = std::max(1u, tileSize);
+
+	const unsigned TileNumber = gridTileNumber(tileNumber(rows, tileSize), tileNumber(columns, tileSize), tileNumber(layers, tileSize));
+
+	return concurrentFor(CountingIterator(0), CountingIterator(TileNumber), Tile3DFunctor<Functor>(layers, rows, columns, tileSize, functor),
+						 partitioner);
+}
+
 }
 
 }
@@ -21,10 +21,15 @@ freely, subject to the following restrictions:
 		distribution.
 */
 
+
 #ifndef CONCURRENTFOR_H
 #define CONCURRENTFOR_H
 
 #include "job.h"
+#include "atomic.h"
+#include "partitioner.h"
+#include "tiles.h"
+#include <list>
 
 namespace Olagarro
 {
@@ -32,101 +37,551 @@ namespace Olagarro
 namespace Concurrency
 {
 
+template<typename InputIterator, typename Functor>
+class ConcurrentForSliceJob;
+
 /**
- * @brief Job used by concurrentFor
+ * @brief How concurrentReductorFor() accumulates elements:
+ *
+ * - SliceAccumulators: every slice works on its own copy of the functor. Copies are merged pairwise as slices finish.
+ * - ThreadAccumulators: every thread executing slices works on one copy of the functor for all of them, so the functor is copied once per thread
+ * instead of once per slice. Those copies are merged pairwise once all slices are done. Worth it when the functor is expensive to copy or merge
+ * (histograms, sets) and the partitioner creates many slices. A copy is used by one slice at a time: a thread which executes a slice while
+ * another one of its slices is not done (a functor waiting for a future executes pending jobs meanwhile) gets another copy for it.
+ *
+ * In both cases copies are merged as a tree: two copies merged once are merged with another pair merged once, and so on. Different pairs are
+ * merged concurrently, so the longest chain of merges grows with log2 of the number of copies. The order in which copies are merged is not
+ * specified.
+ */
+enum Accumulation
+{
+	SliceAccumulators,
+	ThreadAccumulators
+};
+
+//! Used by concurrentReductorFor() to merge two functors
+template<typename Functor>
+void mergeFunctors(Functor& functor, const Functor& other)
+{
+	functor.merge(other);
+}
+
+/**
+ * @brief Owns all ConcurrentForSliceJob objects of a concurrentFor and keeps track of how many of them are still running. For concurrentReductorFor()
+ * it also merges slices' functors
  */
 template<typename InputIterator, typename Functor>
-class ConcurrentForSliceJob : public Job
+class ConcurrentForSlices
 {
 public:
-	ConcurrentForSliceJob(int baseIndex, InputIterator begin, InputIterator end, Functor functor) :
-		mBaseIndex(baseIndex),
-		mBegin(begin),
-		mEnd(end),
+	typedef ConcurrentForSliceJob<InputIterator, Functor> JobType;
+	typedef void (*MergeFunction)(Functor&, const Functor&);
+
+	/**
+	 * @param merge Function which merges two functors, or null if functors don't have to be merged (concurrentFor())
+	 */
+	ConcurrentForSlices(const Functor& functor, const Partitioner& partitioner, MergeFunction merge = 0,
+						Accumulation accumulation = SliceAccumulators) :
 		mFunctor(functor),
-		mJobDone(false)
+		mPartitioner(partitioner),
+		mMerge(merge),
+		mAccumulation(accumulation),
+		mRunningSliceNumber(0),
+		mCursor(0),
+		mIncomplete(0)
+	{
+		for(unsigned i = 0; i < PendingRankNumber; ++ i)
+		{
+			mPendingFunctors[i] = 0;
+		}
+	}
+
+	const Partitioner& partitioner() const
+	{
+		return mPartitioner;
+	}
+
+	/**
+	 * @brief createSlice Creates a slice job for [begin, end) range, it must be executed or enqueued by the caller
+	 */
+	Shared<Job, AtomicMTPolicy> createSlice(int baseIndex, InputIterator begin, InputIterator end, unsigned splitDepth)
+	{
+		Shared<Job, AtomicMTPolicy> job(new JobType(*this, baseIndex, begin, end, splitDepth));
+
+		tthread::lock_guard<tthread::mutex> guard(mMutex);
+
+		mSlices.push_back(job);
+		++ mRunningSliceNumber;
+
+		return job;
+	}
+
+	/**
+	 * @brief nextBatch Takes the next batch of up to batchSize elements of [0, rangeEnd) for Dynamic partitioning, shared by all slices
+	 * @return Index of its first element, rangeEnd if there is nothing left to do. batchEnd is set to the index after its last element
+	 */
+	int nextBatch(int batchSize, int rangeEnd, int& batchEnd)
+	{
+		int batchBegin = mCursor.load(MemoryOrderRelaxed);
+
+		// Never moved beyond rangeEnd: a fetchAdd() per slice once the range is done could overflow with big ranges and grain sizes
+		do
+		{
+			if(batchBegin >= rangeEnd)
+			{
+				return rangeEnd;
+			}
+
+			batchEnd = rangeEnd - batchBegin > batchSize? batchBegin + batchSize : rangeEnd;
+		}
+		while(!mCursor.compareExchange(batchBegin, batchEnd, MemoryOrderRelaxed));
+
+		return batchBegin;
+	}
+
+	/**
+	 * @brief sliceFunctor Functor a slice has to use: a copy constructed in slice's storage, or the calling thread's one with ThreadAccumulators
+	 */
+	Functor& sliceFunctor(ResultStorage<Functor>& storage)
 	{
+		if(ThreadAccumulators == mAccumulation)
+		{
+			return threadAccumulator();
+		}
+
+		storage.construct(mFunctor);
+
+		return storage.get();
 	}
 
-	~ConcurrentForSliceJob()
+	/**
+	 * @brief sliceDone Tells a slice is done. functor is the one it used, null if it did not execute. With SliceAccumulators it is merged with the
+	 * rest of slices' functors
+	 */
+	void sliceDone(Functor* functor)
 	{
-		if(!mJobDone)
+		if(0 != mMerge && 0 != functor && SliceAccumulators == mAccumulation)
 		{
-			result();
+			try
+			{
+				mergePending(functor);
+			}
+			catch(...)
+			{
+				sliceFailed();
+			}
+		}
+
+		tthread::lock_guard<tthread::mutex> guard(mMutex);
+
+		if(0 != functor && ThreadAccumulators == mAccumulation)
+		{
+			releaseThreadAccumulator(functor);
+		}
+
+		if(0 == -- mRunningSliceNumber)
+		{
+			mCondVariable.notify_all();
 		}
 	}
 
-	Functor result()
+	/**
+	 * @brief mergePending Merges functor into a tree, like adding one to a binary counter: there is a pending slot per rank (tree level of
+	 * the functor), a functor finding its rank's slot taken merges with the functor there and goes on with the next rank, otherwise it stays pending.
+	 * Merges are done outside the lock, so pairs of the same or different ranks are merged in parallel
+	 */
+	void mergePending(Functor* functor)
 	{
+		for(unsigned rank = 0; ; ++ rank)
+		{
+			Functor* other = 0;
+
+			{
+				tthread::lock_guard<tthread::mutex> guard(mMutex);
+
+				if(0 == mPendingFunctors[rank])
+				{
+					mPendingFunctors[rank] = functor;
+					return;
+				}
+
+				other = mPendingFunctors[rank];
+				mPendingFunctors[rank] = 0;
+			}
+
+			(*mMerge)(*functor, *other);
+		}
+	}
+
+	/**
+	 * @brief reduce Merges all functors into one and returns it, or null if no slice was executed. Only valid once all slices are done. With
+	 * ThreadAccumulators threads' functors are merged concurrently by the ThreadPool
+	 */
+	Functor* reduce();
+
+	//! Keeps the exception being handled, which made a slice stop. Must be called from a catch block
+	void sliceFailed()
+	{
+		ExceptionHolder exception;
+		exception.capture();
+
 		tthread::lock_guard<tthread::mutex> guard(mMutex);
 
-		if(mJobDone)
+		mExceptions.push_back(exception);
+	}
+
+	/**
+	 * @brief failure An AggregateException with the exceptions of every failed slice, or an empty holder if none failed. Only valid once all
+	 * slices are done
+	 */
+	ExceptionHolder failure() const
+	{
+		ExceptionHolder failure;
+
+		if(!mExceptions.empty())
 		{
-			return mFunctor;
+			try
+			{
+				throw AggregateException(mExceptions);
+			}
+			catch(...)
+			{
+				failure.capture();
+			}
 		}
 
-		mCondVariable.wait(mMutex);
+		return failure;
+	}
 
-		return mFunctor;
+	//! Tells some elements were not processed: a slice was cancelled before starting or stopped because of a cancellation
+	void sliceStopped()
+	{
+		mIncomplete.store(1, MemoryOrderRelaxed);
 	}
 
-	std::string name() const
+	//! True if any slice stopped before processing its elements. Only valid once all slices are done
+	bool isIncomplete() const
 	{
-		return "ConcurrentForSliceJob";
+		return 0 != mIncomplete.load(MemoryOrderRelaxed);
+	}
+
+	bool isDone() const
+	{
+		tthread::lock_guard<tthread::mutex> guard(mMutex);
+
+		return 0 == mRunningSliceNumber;
+	}
+
+	/**
+	 * @brief wait Blocks until all slices are done, executing pending jobs meanwhile if calling thread is a JobThread
+	 */
+	void wait() const
+	{
+		while(!isDone() && ThreadPool::executePendingJob())
+		{
+		}
+
+		tthread::lock_guard<tthread::mutex> guard(mMutex);
+
+		while(0 != mRunningSliceNumber)
+		{
+			mCondVariable.wait(mMutex);
+		}
 	}
 
 private:
-	void executeJob()
+	/**
+	 * @brief threadAccumulator Calling thread's functor for ThreadAccumulators, created the first time the thread executes a slice. It is not
+	 * shared with a slice of the same thread still running: a slice executed while another one waits would use a functor in the middle of a call
+	 */
+	Functor& threadAccumulator()
 	{
+		const tthread::thread::id ThisThread = tthread::this_thread::get_id();
+
 		tthread::lock_guard<tthread::mutex> guard(mMutex);
 
-		int index = mBaseIndex;
-		for(InputIterator it = mBegin; it != mEnd; ++ it, ++ index)
+		for(typename ThreadAccumulatorList::iterator it = mThreadAccumulators.begin(); it != mThreadAccumulators.end(); ++ it)
 		{
-			mFunctor(index, *it);
+			if(ThisThread == it->thread && !it->inUse)
+			{
+				it->inUse = true;
+				return it->functor;
+			}
 		}
 
-		mJobDone = true;
+		mThreadAccumulators.push_back(ThreadAccumulator(ThisThread, mFunctor));
 
-		mCondVariable.notify_all();
+		return mThreadAccumulators.back().functor;
 	}
 
+	//! Lets another slice of the same thread use functor. mMutex must be locked
+	void releaseThreadAccumulator(Functor* functor)
+	{
+		for(typename ThreadAccumulatorList::iterator it = mThreadAccumulators.begin(); it != mThreadAccumulators.end(); ++ it)
+		{
+			if(&it->functor == functor)
+			{
+				it->inUse = false;
+				return;
+			}
+		}
+	}
+
+	struct ThreadAccumulator
+	{
+		ThreadAccumulator(tthread::thread::id thread, const Functor& functor) :
+			thread(thread),
+			inUse(true),
+			functor(functor)
+		{
+		}
+
+		tthread::thread::id thread;
+		bool inUse;
+		Functor functor;
+	};
+
+	Functor mFunctor;
+	Partitioner mPartitioner;
+	MergeFunction mMerge;
+	Accumulation mAccumulation;
+
 	mutable tthread::mutex mMutex;
 	mutable tthread::condition_variable mCondVariable;
+	std::vector< Shared<Job, AtomicMTPolicy> > mSlices;
+	std::vector<ExceptionHolder> mExceptions;
+	// A list, so accumulators don't move while other threads use them
+	typedef std::list<ThreadAccumulator> ThreadAccumulatorList;
+	ThreadAccumulatorList mThreadAccumulators;
+	// Reaching rank N takes 2^N functors, so there are never more ranks than bits in the number of slices
+	enum { PendingRankNumber = sizeof(int) * 8 };
+
+	Functor* mPendingFunctors[PendingRankNumber];
+	int mRunningSliceNumber;
+	Atomic<int> mCursor;
+	Atomic<int> mIncomplete;
+};
+
+/**
+ * @brief Job used by concurrentFor: it executes functor for a slice of the range
+ */
+template<typename InputIterator, typename Functor>
+class ConcurrentForSliceJob : public Job
+{
+public:
+	ConcurrentForSliceJob(ConcurrentForSlices<InputIterator, Functor>& slices, int baseIndex, InputIterator begin, InputIterator end,
+						  unsigned splitDepth) :
+		mSlices(slices),
+		mBaseIndex(baseIndex),
+		mBegin(begin),
+		mEnd(end),
+		mSplitDepth(splitDepth),
+		mCreatorThread(tthread::this_thread::get_id())
+	{
+	}
+
+	std::string name() const
+	{
+		return "ConcurrentForSliceJob";
+	}
+
+private:
+	void executeJob()
+	{
+		split();
+
+		Functor* functor = 0;
+
+		// An exception stops this slice only, it is thrown later by the concurrentFor's future
+		try
+		{
+			// Not copied before, so slices waiting in queues don't keep a copy and slices using ThreadAccumulators never need one
+			functor = &mSlices.sliceFunctor(mFunctor);
+
+			const bool Completed = Partitioner::Dynamic == mSlices.partitioner().type()? executeBatches(*functor) :
+																						   executeRange(*functor, mBaseIndex, mBegin, mEnd);
+
+			if(!Completed)
+			{
+				mSlices.sliceStopped();
+			}
+		}
+		catch(...)
+		{
+			mSlices.sliceFailed();
+		}
+
+		// Last thing to do: after that call mSlices can be destroyed at any time
+		mSlices.sliceDone(functor);
+	}
+
+	// Slices cancelled before starting only have to tell they are done, and that their elements were not processed
+	void cancelJob()
+	{
+		mSlices.sliceStopped();
+		mSlices.sliceDone(0);
+	}
+
+	// Returns false if it stopped because of a cancellation
+	bool executeRange(Functor& functor, int baseIndex, InputIterator begin, InputIterator end)
+	{
+		OLAGARRO_TRACE_RANGE_SCOPE("concurrentFor range", baseIndex, end - begin);
+
+		int index = baseIndex;
+		for(InputIterator it = begin; it != end; ++ it, ++ index)
+		{
+			// Checking every CancellationCheckInterval elements keeps the cost negligible even for very cheap functors
+			if(0 == (index - baseIndex) % CancellationCheckInterval && isCancellationRequested())
+			{
+				return false;
+			}
+
+			functor(index, *it);
+		}
+
+		return true;
+	}
+
+	// Dynamic partitioning: every slice spans the whole range and takes batches of grain size elements from the shared cursor until there are no
+	// more, so slices which get cheap elements just take more batches. Returns false if it stopped because of a cancellation
+	bool executeBatches(Functor& functor)
+	{
+		const int TotalRange = static_cast<int>(mEnd - mBegin);
+		// Grain sizes beyond the range (or beyond int) take the whole range at once
+		const int BatchSize = static_cast<int>(std::min(mSlices.partitioner().grainSize(), static_cast<unsigned>(TotalRange)));
+
+		for(;;)
+		{
+			int batchEnd = TotalRange;
+			const int BatchBegin = mSlices.nextBatch(BatchSize, TotalRange, batchEnd);
+
+			if(BatchBegin >= TotalRange)
+			{
+				return true;
+			}
+
+			if(!executeRange(functor, mBaseIndex + BatchBegin, mBegin + BatchBegin, mBegin + batchEnd))
+			{
+				return false;
+			}
+		}
+	}
+
+	enum { CancellationCheckInterval = 256 };
+
+	// Adaptive partitioning: gives the second half of our range to a new slice job while we are allowed to. Being stolen means there are idle
+	// JobThreads so we are allowed to split further
+	void split()
+	{
+		const Partitioner& partitioner = mSlices.partitioner();
 
+		if(Partitioner::Adaptive != partitioner.type())
+		{
+			return;
+		}
+
+		if(tthread::this_thread::get_id() != mCreatorThread)
+		{
+			mSplitDepth += partitioner.stealSplitDepth();
+		}
+
+		ThreadPool& pool = ThreadPool::current();
+
+		while(0 < mSplitDepth && partitioner.grainSize() < static_cast<unsigned>(mEnd - mBegin) / 2)
+		{
+			-- mSplitDepth;
+
+			const int Half = static_cast<int>(mEnd - mBegin) / 2;
+
+			pool.enqueueJob(mSlices.createSlice(mBaseIndex + Half, mBegin + Half, mEnd, mSplitDepth));
+
+			mEnd = mBegin + Half;
+		}
+	}
+
+	ConcurrentForSlices<InputIterator, Functor>& mSlices;
 	int mBaseIndex;
 	InputIterator mBegin;
 	InputIterator mEnd;
-	Functor mFunctor;
-	bool mJobDone;
+	ResultStorage<Functor> mFunctor;
+	unsigned mSplitDepth;
+	tthread::thread::id mCreatorThread;
 };
 
-// An utility function: creates the ConcurrentForSliceJobs needed by concurrentFor
+// An utility function: creates and launches the ConcurrentForSliceJobs needed by concurrentFor. Calling thread executes the first one and then waits
+// for the rest of them.
+// If the pool spans several NUMA nodes, the range is divided in contiguous parts, one per node in order, and every slice is bound to its part's
+// node. In that case calling thread does not execute any slice as it may be in any node.
+// Where the memory actually is is never asked: move_pages() would tell the node of the page holding each slice's first element, but iterators
+// do not always give an address. The mapping only depends on the range size and the pool's node number instead, so slices run next to their
+// memory only if it was first touched by a node bound concurrentFor over a range of the same size in a pool with as many nodes. Memory first
+// touched by a serial loop, by Dynamic partitioning or by a range of another size is where those left it, and the binding does not help then.
+// With Dynamic partitioning every slice spans the whole range and takes batches from it as it goes, so slices are never bound to nodes
 template<typename InputIterator, typename Functor>
-std::vector< Shared<Job, MutexMTPolicy> > createJobs(InputIterator begin, InputIterator end, Functor functor)
+void executeSlices(ConcurrentForSlices<InputIterator, Functor>& slices, InputIterator begin, InputIterator end)
 {
-	typedef ConcurrentForSliceJob<InputIterator, Functor> JobType;
-	std::vector< Shared<Job, MutexMTPolicy> > jobs(HardwareThreadNumber);
-
+	const Partitioner& partitioner = slices.partitioner();
 	const unsigned TotalRange = end - begin;
-	unsigned currentRange = TotalRange;
-	const int ChunkSize = TotalRange / HardwareThreadNumber;
 
-	for(std::size_t i = 0; i < jobs.size(); ++ i)
+	ThreadPool& pool = ThreadPool::current();
+
+	const bool Dynamic = Partitioner::Dynamic == partitioner.type();
+	const bool FixedGrain = Partitioner::FixedGrain == partitioner.type() && !partitioner.isSerial(TotalRange);
+	const unsigned NodeNumber = pool.nodeNumber();
+	const bool NodeBound = !Dynamic && 1 < NodeNumber && !partitioner.isSerial(TotalRange);
+
+	unsigned sliceNumber = partitioner.isSerial(TotalRange)? 1 : partitioner.initialSliceNumber(TotalRange, pool.threadNumber());
+
+	// FixedGrain slices keep their size: binding them to nodes does not add slices
+	if(NodeBound && !FixedGrain)
+	{
+		sliceNumber = std::min(TotalRange, std::max(sliceNumber, NodeNumber));
+	}
+
+	const unsigned SplitDepth = partitioner.initialSplitDepth(pool.threadNumber());
+	Shared<Job, AtomicMTPolicy> firstSlice;
+
+	for(unsigned i = 0; i < sliceNumber; ++ i)
 	{
-		unsigned currentChunk = HardwareThreadNumber - 1 == i? ChunkSize + TotalRange % ChunkSize : ChunkSize;
+		// FixedGrain slices are exactly grain size elements but the last one. Otherwise balanced split: slice sizes differ by one element at most
+		unsigned sliceBegin = 0;
+		unsigned sliceEnd = TotalRange;
 
-		unsigned currentIndex = i * ChunkSize;
+		if(FixedGrain)
+		{
+			sliceBegin = static_cast<unsigned>(std::min<unsigned long long>(TotalRange, static_cast<unsigned long long>(partitioner.grainSize()) * i));
+			sliceEnd = static_cast<unsigned>(std::min<unsigned long long>(TotalRange, static_cast<unsigned long long>(partitioner.grainSize()) * (i + 1)));
+		}
+		else if(!Dynamic)
+		{
+			sliceBegin = static_cast<unsigned>(static_cast<unsigned long long>(TotalRange) * i / sliceNumber);
+			sliceEnd = static_cast<unsigned>(static_cast<unsigned long long>(TotalRange) * (i + 1) / sliceNumber);
+		}
 
-		Shared<Job, MutexMTPolicy> job(new JobType(currentIndex, begin + currentIndex, begin + currentIndex + currentChunk, functor));
+		Shared<Job, AtomicMTPolicy> job = slices.createSlice(sliceBegin, begin + sliceBegin, begin + sliceEnd, SplitDepth);
 
-		jobs[i] = job;
+		if(NodeBound)
+		{
+			pool.enqueueJob(job, static_cast<unsigned>(static_cast<unsigned long long>(sliceBegin) * NodeNumber / TotalRange));
+		}
+		else if(0 == i)
+		{
+			firstSlice = job;
+		}
+		else
+		{
+			pool.enqueueJob(job);
+		}
+	}
 
-		currentRange -= ChunkSize;
+	if(!firstSlice.isNull())
+	{
+		firstSlice->execute();
 	}
 
-	return jobs;
+	slices.wait();
 }
+
 /**
  * @brief Job that groups all ConcurrentForSliceJob objects
  */
@@ -134,11 +589,11 @@ template<typename InputIterator, typename Functor>
 class ConcurrentForJob : public CallerJob<void>
 {
 public:
-	ConcurrentForJob(InputIterator begin, InputIterator end, Functor functor) :
-		CallerJob<void>(0),
+	ConcurrentForJob(InputIterator begin, InputIterator end, Functor functor, const Partitioner& partitioner) :
+		CallerJob<void>(),
 		mBegin(begin),
 		mEnd(end),
-		mFunctor(functor)
+		mSlices(functor, partitioner)
 	{
 	}
 
@@ -153,45 +608,229 @@ public:
 	}
 
 private:
-
-	typedef ConcurrentForSliceJob<InputIterator, Functor> JobType;
-
 	void executeJob()
 	{
-		std::vector< Shared<Job, MutexMTPolicy> > jobs = createJobs(mBegin, mEnd, mFunctor);
+		executeSlices(mSlices, mBegin, mEnd);
 
-		// Launch jobs except last one
-		ThreadPool& pool = ThreadPool::instance();
+		const ExceptionHolder Failure = mSlices.failure();
 
-		for(std::size_t i = 0; i < jobs.size() - 1; ++ i)
+		// A failure is never hidden by a cancellation, like in whenAll(). Cancelled only if some elements were skipped: a cancellation after the
+		// last slice finished leaves a complete loop
+		if(!Failure.empty())
 		{
-			pool.enqueueJob(jobs[i]);
+			setFailed(Failure);
 		}
+		else if(mSlices.isIncomplete())
+		{
+			setCancelled();
+		}
+		else
+		{
+			setResultCalculated();
+		}
+	}
 
-		// Now execute last job in our own thread
-		jobs.back()->execute();
+	InputIterator mBegin;
+	InputIterator mEnd;
+	ConcurrentForSlices<InputIterator, Functor> mSlices;
+};
 
-		// Wait for them all (except last one as it has finished its job when we reach that point)
-		for(std::size_t i = 0; i < jobs.size() - 1; ++ i)
+/**
+ * @brief Functor used by ForwardConcurrentForJob: calls user's functor for the elements of a chunk of a forward range, given by its split points
+ */
+template<typename ForwardIterator, typename Functor>
+class ForwardChunkFunctor
+{
+public:
+	ForwardChunkFunctor(const std::vector<ForwardIterator>& splitPoints, std::size_t chunkSize, ForwardIterator end, const Functor& functor) :
+		mSplitPoints(&splitPoints),
+		mChunkSize(chunkSize),
+		mEnd(end),
+		mFunctor(functor)
+	{
+	}
+
+	void operator () (int, unsigned chunk)
+	{
+		const ForwardIterator End = chunk + 1 < mSplitPoints->size()? (*mSplitPoints)[chunk + 1] : mEnd;
+
+		int index = static_cast<int>(chunk * mChunkSize);
+		for(ForwardIterator it = (*mSplitPoints)[chunk]; it != End; ++ it, ++ index)
 		{
-			JobType* job = static_cast<JobType*>(jobs[i].get());
-			job->result();
+			mFunctor(index, *it);
 		}
+	}
 
-		jobs.clear();
+private:
+	const std::vector<ForwardIterator>* mSplitPoints;
+	std::size_t mChunkSize;
+	ForwardIterator mEnd;
+	Functor mFunctor;
+};
 
-		tthread::lock_guard<tthread::mutex> guard(mMutex);
+/**
+ * @brief Job used by concurrentFor() for ranges without random access (std::list, std::map...). It walks the range once, keeping an iterator every
+ * chunk of elements, and then runs a concurrentFor over the chunks. Chunks are never smaller than partitioner's grain size and they are doubled
+ * during the walk whenever there are too many of them, so only a few iterators per JobThread are kept whatever the range size is
+ */
+template<typename ForwardIterator, typename Functor>
+class ForwardConcurrentForJob : public CallerJob<void>
+{
+public:
+	ForwardConcurrentForJob(ForwardIterator begin, ForwardIterator end, Functor functor, const Partitioner& partitioner) :
+		CallerJob<void>(),
+		mBegin(begin),
+		mEnd(end),
+		mFunctor(functor),
+		mPartitioner(partitioner)
+	{
+	}
 
-		mResultCalculated = true;
+	std::string name() const
+	{
+		return "ForwardConcurrentForJob";
+	}
 
-		mCondVariable.notify_all();
+private:
+	void executeJob()
+	{
+		typedef ForwardChunkFunctor<ForwardIterator, Functor> ChunkFunctor;
+
+		try
+		{
+			const std::size_t MaximumChunkNumber = static_cast<std::size_t>(ThreadPool::current().threadNumber()) * ChunksPerThread;
+
+			std::vector<ForwardIterator> splitPoints;
+			std::size_t chunkSize = mPartitioner.grainSize();
+			std::size_t elementNumber = 0;
+
+			for(ForwardIterator it = mBegin; it != mEnd; ++ it, ++ elementNumber)
+			{
+				if(0 != elementNumber % chunkSize)
+				{
+					continue;
+				}
+
+				if(2 * MaximumChunkNumber == splitPoints.size())
+				{
+					// Too many chunks: keeping every other split point doubles chunk size
+					for(std::size_t i = 0; 2 * i < splitPoints.size(); ++ i)
+					{
+						splitPoints[i] = splitPoints[2 * i];
+					}
+
+					splitPoints.erase(splitPoints.begin() + (splitPoints.size() + 1) / 2, splitPoints.end());
+					chunkSize *= 2;
+
+					if(0 != elementNumber % chunkSize)
+					{
+						continue;
+					}
+				}
+
+				splitPoints.push_back(it);
+			}
+
+			Shared<Job, AtomicMTPolicy> job(new ConcurrentForJob<CountingIterator, ChunkFunctor>(CountingIterator(0),
+																								 CountingIterator(splitPoints.size()),
+																								 ChunkFunctor(splitPoints, chunkSize, mEnd, mFunctor),
+																								 Partitioner(mPartitioner.type(), 1)));
+			job->execute();
+
+			// Throws chunks' exceptions
+			static_cast<CallerJob<void>*>(job.get())->result();
+		}
+		catch(const JobCancelled&)
+		{
+			setCancelled();
+			return;
+		}
+		catch(...)
+		{
+			setFailed();
+			return;
+		}
+
+		setResultCalculated();
 	}
 
-	InputIterator mBegin;
-	InputIterator mEnd;
+	enum { ChunksPerThread = 8 };
+
+	ForwardIterator mBegin;
+	ForwardIterator mEnd;
 	Functor mFunctor;
+	Partitioner mPartitioner;
+};
+
+//! Used by ConcurrentForSlices::reduce() to merge threads' functors from several jobs
+template<typename InputIterator, typename Functor>
+struct MergePendingFunctor
+{
+	explicit MergePendingFunctor(ConcurrentForSlices<InputIterator, Functor>& slices) :
+		slices(&slices)
+	{
+	}
+
+	void operator()(int, Functor* functor)
+	{
+		slices->mergePending(functor);
+	}
+
+	ConcurrentForSlices<InputIterator, Functor>* slices;
 };
 
+template<typename InputIterator, typename Functor>
+Functor* ConcurrentForSlices<InputIterator, Functor>::reduce()
+{
+	if(ThreadAccumulators == mAccumulation && 1 < mThreadAccumulators.size())
+	{
+		std::vector<Functor*> functors;
+
+		for(typename ThreadAccumulatorList::iterator it = mThreadAccumulators.begin(); it != mThreadAccumulators.end(); ++ it)
+		{
+			functors.push_back(&it->functor);
+		}
+
+		typedef typename std::vector<Functor*>::iterator Iterator;
+		typedef MergePendingFunctor<InputIterator, Functor> MergeFunctor;
+
+		Shared<Job, AtomicMTPolicy> job(new ConcurrentForJob<Iterator, MergeFunctor>(functors.begin(), functors.end(), MergeFunctor(*this),
+																					fixedGrainPartitioner(1)));
+		job->execute();
+
+		// Throws if any merge threw
+		static_cast<CallerJob<void>*>(job.get())->result();
+	}
+	else if(ThreadAccumulators == mAccumulation && 1 == mThreadAccumulators.size())
+	{
+		return &mThreadAccumulators.front().functor;
+	}
+
+	// Every slice is done, what is left is at most one functor per rank
+	tthread::lock_guard<tthread::mutex> guard(mMutex);
+
+	Functor* reduced = 0;
+
+	for(unsigned i = 0; i < PendingRankNumber; ++ i)
+	{
+		if(0 == mPendingFunctors[i])
+		{
+			continue;
+		}
+
+		if(0 == reduced)
+		{
+			reduced = mPendingFunctors[i];
+		}
+		else
+		{
+			(*mMerge)(*reduced, *mPendingFunctors[i]);
+		}
+	}
+
+	return reduced;
+}
+
 /**
  * @brief Job that groups all ConcurrentForSliceJob objects for concurrentReductorFor function
  */
@@ -199,11 +838,12 @@ template<typename InputIterator, typename Functor>
 class ConcurrentReductorForJob : public CallerJob<Functor>
 {
 public:
-	ConcurrentReductorForJob(InputIterator begin, InputIterator end, Functor functor) :
-		CallerJob<Functor>(0),
+	ConcurrentReductorForJob(InputIterator begin, InputIterator end, Functor functor, const Partitioner& partitioner, Accumulation accumulation) :
+		CallerJob<Functor>(),
 		mBegin(begin),
 		mEnd(end),
-		mFunctor(functor)
+		mFunctor(functor),
+		mSlices(functor, partitioner, &mergeFunctors<Functor>, accumulation)
 	{
 	}
 
@@ -219,43 +859,48 @@ public:
 protected:
 	void executeJob()
 	{
-		mJobs = createJobs(mBegin, mEnd, mFunctor);
+		executeSlices(mSlices, mBegin, mEnd);
 
-		// Launch jobs except last one
-		ThreadPool& pool = ThreadPool::instance();
+		// Using "this->" as otherwise compiler cannot see mResult and such members. Same as ConcurrentForJob, failures first and cancelled only if
+		// some elements were skipped
+		const ExceptionHolder Failure = mSlices.failure();
 
-		for(std::size_t i = 0; i < mJobs.size() - 1; ++ i)
+		if(!Failure.empty())
 		{
-			pool.enqueueJob(mJobs[i]);
+			this->setFailed(Failure);
+			return;
 		}
 
-		// Now execute last job in our own thread
-		JobType* job = static_cast<JobType*>(mJobs.back().get());
-		job->execute();
-		mFunctor.merge(job->result());
-
-		// Wait for them all (except last one as it has finished its job when we reach that point)
-		for(std::size_t i = 0; i < mJobs.size() - 1; ++ i)
+		if(mSlices.isIncomplete())
 		{
-			JobType* job = static_cast<JobType*>(mJobs[i].get());
-			mFunctor.merge(job->result());
+			this->setCancelled();
+			return;
 		}
 
-		// Using "this->" as otherwise compiler cannot see mMutex and such variables
-		tthread::lock_guard<tthread::mutex> guard(this->mMutex);
+		try
+		{
+			const Functor* Reduced = mSlices.reduce();
 
-		this->mResult = mFunctor;
-		this->mResultCalculated = true;
+			if(0 != Reduced)
+			{
+				mFunctor.merge(*Reduced);
+			}
 
-		this->mCondVariable.notify_all();
-	}
+			this->mResult.construct(mFunctor);
+		}
+		catch(...)
+		{
+			this->setFailed();
+			return;
+		}
 
-	typedef ConcurrentForSliceJob<InputIterator, Functor> JobType;
-	std::vector< Shared<Job, MutexMTPolicy> > mJobs;
+		this->setResultCalculated();
+	}
 
 	InputIterator mBegin;
 	InputIterator mEnd;
 	Functor mFunctor;
+	ConcurrentForSlices<InputIterator, Functor> mSlices;
 };
 
 }
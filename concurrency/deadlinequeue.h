@@ -0,0 +1,145 @@
+/*
+Copyright (c) 2014 Inaki Griego
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+		1. The origin of this software must not be misrepresented; you must not
+		claim that you wrote the original software. If you use this software
+		in a product, an acknowledgment in the product documentation would be
+		appreciated but is not required.
+
+		2. Altered source versions must be plainly marked as such, and must not be
+		misrepresented as being the original software.
+
+		3. This notice may not be removed or altered from any source
+		distribution.
+*/
+
+
+#ifndef DEADLINEQUEUE_H
+#define DEADLINEQUEUE_H
+
+#include <vector>
+#include <algorithm>
+#include "tinythread/fast_mutex.h"
+#include "atomic.h"
+
+namespace Olagarro
+{
+
+namespace Concurrency
+{
+
+/**
+ * @brief Queue which gives its elements back in deadline order, earliest first. Elements with the same deadline come out in insertion order.
+ *
+ * Elements with deadline are expected to be few, so a binary heap protected by a spin lock is enough. An atomic counter allows checking if it is
+ * empty without taking the lock, which is what the ThreadPool does most of the time.
+ */
+template<typename T, typename TimePoint>
+class DeadlineQueue
+{
+public:
+	DeadlineQueue() :
+		mSize(0),
+		mSequence(0)
+	{
+	}
+
+	void push(const T& element, TimePoint deadline)
+	{
+		tthread::lock_guard<tthread::fast_mutex> guard(mMutex);
+
+		Entry entry;
+		entry.element = element;
+		entry.deadline = deadline;
+		entry.sequence = mSequence ++;
+
+		mEntries.push_back(entry);
+		std::push_heap(mEntries.begin(), mEntries.end(), Later());
+
+		mSize.fetchAdd(1, MemoryOrderRelease);
+	}
+
+	/**
+	 * @brief pop Takes the element with the earliest deadline
+	 * @return false if queue was empty
+	 */
+	bool pop(T& element)
+	{
+		if(empty())
+		{
+			return false;
+		}
+
+		tthread::lock_guard<tthread::fast_mutex> guard(mMutex);
+
+		if(mEntries.empty())
+		{
+			return false;
+		}
+
+		std::pop_heap(mEntries.begin(), mEntries.end(), Later());
+		element = mEntries.back().element;
+		mEntries.pop_back();
+
+		mSize.fetchSub(1, MemoryOrderRelease);
+
+		return true;
+	}
+
+	bool empty() const
+	{
+		return 0 == mSize.load(MemoryOrderAcquire);
+	}
+
+	void clear()
+	{
+		tthread::lock_guard<tthread::fast_mutex> guard(mMutex);
+
+		mEntries.clear();
+		mSize.store(0);
+	}
+
+private:
+	struct Entry
+	{
+		T element;
+		TimePoint deadline;
+		unsigned long long sequence;
+	};
+
+	// std heaps keep the greatest element on top, so the "greatest" entry is the one with the earliest deadline
+	struct Later
+	{
+		bool operator()(const Entry& first, const Entry& second) const
+		{
+			if(first.deadline != second.deadline)
+			{
+				return second.deadline < first.deadline;
+			}
+
+			return second.sequence < first.sequence;
+		}
+	};
+
+	DeadlineQueue(const DeadlineQueue&);
+	DeadlineQueue& operator = (const DeadlineQueue&);
+
+	mutable tthread::fast_mutex mMutex;
+	std::vector<Entry> mEntries;
+	Atomic<int> mSize;
+	unsigned long long mSequence;
+};
+
+}
+
+}
+
+#endif // DEADLINEQUEUE_H
@@ -27,7 +27,14 @@ freely, subject to the following restrictions:
 #include "tinythread/tinythread.h"
 #include "job.h"
 #include "../common/shared.h"
-#include "mutexmtpolicy.h"
+#include "atomicmtpolicy.h"
+#include "atomic.h"
+#include "clock.h"
+#include <vector>
+
+#if defined(_TTHREAD_CPP11_)
+	#include <chrono>
+#endif
 
 namespace Olagarro
 {
@@ -85,6 +92,23 @@ namespace Concurrency
 	* Same as with launchJob() function, Future works with concurrentFor() and concurrentReductorFor() functions. First one only returns Future<void>
 	* (just to wait for it) but second function returns Future<OperationResultType> object.
 	*
+	* Frame loops and latency critical threads can poll a Future with isReady() or bound how long they wait with waitFor() and waitUntil(), which
+	* return false if the value is not ready in time.
+	*
+	* Instead of blocking on result() a stage can be chained to the value with then(), and whenAll() / whenAny() give a Future which is ready when all
+	* or any of a group of futures are. Nothing blocks between stages, every continuation is enqueued into the ThreadPool when its input is ready:
+	*
+	* \code
+	* float scale(Future<float> value) { return value.result() * 2.0f; } // value is ready here, result() returns immediately
+	*
+	* Future<float> scaled = Olagarro::launchJob(veryHeavyOperation).then(scale);
+	*
+	* Future< std::vector< Future<float> > > all = whenAll(heavyOpValues);
+	* \endcode
+	*
+	* An exception thrown by the operation does not escape the JobThread: it is kept and thrown by result(), resultReference() and take(). Slices of
+	* concurrentFor() and concurrentReductorFor() which throw are gathered in one AggregateException.
+	*
 */
 template<typename T>
 class Future
@@ -94,7 +118,7 @@ public:
 	{
 	}
 
-	Future(Shared<Job, MutexMTPolicy> job) :
+	Future(Shared<Job, AtomicMTPolicy> job) :
 		mJob(job)
 	{
 	}
@@ -109,10 +133,295 @@ public:
 		return job->result();
 	}
 
+	/**
+	 * @brief Returns a constant reference to operation's result or blocks until it is calculated. Nothing is copied, the reference is valid while
+	 * any Future of this operation lives
+	 */
+	typename ResultReference<T>::Type resultReference() const
+	{
+		const CallerJob<T>* job = static_cast<const CallerJob<T>*>(mJob.get());
+		return job->resultReference();
+	}
+
+	/**
+	 * @brief Moves operation's result out (with C++11 compilers, older ones copy it) or blocks until it is calculated. This is the way to get move
+	 * only results, and big ones without copying them. Result is taken once: later calls of take(), result() or resultReference() from this or
+	 * any other Future of the operation get a moved from object
+	 */
+	T take()
+	{
+		CallerJob<T>* job = static_cast<CallerJob<T>*>(mJob.get());
+		return job->takeResult();
+	}
+
+	/**
+	 * @brief isCancelled Tells if the operation was cancelled (see CancellationToken) before being done. Cancelled futures are ready, but
+	 * result() and such throw JobCancelled. A queued job is only found cancelled when a JobThread takes it, until then this returns false
+	 */
+	bool isCancelled() const
+	{
+		return callerJob()->isCancelled();
+	}
+
+	/**
+	 * @brief isFailed Tells if the operation threw an exception. Failed futures are ready, but result() and such throw that exception (an
+	 * AggregateException for concurrentFor() and concurrentReductorFor(), see ExceptionHolder for C++03 compilers)
+	 */
+	bool isFailed() const
+	{
+		return callerJob()->isFailed();
+	}
+
+	/**
+	 * @brief isReady Tells, without blocking, if the value is already calculated, that is, if result() would return immediately
+	 */
+	bool isReady() const
+	{
+		return callerJob()->isResultCalculated();
+	}
+
+	/**
+	 * @brief waitFor Blocks until the value is calculated or time has passed, whatever happens first
+	 * @param time Maximum time to wait, for example tthread::chrono::milliseconds(2)
+	 * @return true if the value is ready
+	 */
+	template<typename Rep, typename Period>
+	bool waitFor(const tthread::chrono::duration<Rep, Period>& time) const
+	{
+		return waitUntil(Clock::now() + Clock::toDuration(time));
+	}
+
+	/**
+	 * @brief waitUntil Blocks until the value is calculated or deadline is reached, whatever happens first
+	 * @param deadline Point of time given by Clock::now()
+	 * @return true if the value is ready
+	 */
+	bool waitUntil(Clock::TimePoint deadline) const
+	{
+		return callerJob()->waitForResultUntil(deadline);
+	}
+
+#if defined(_TTHREAD_CPP11_)
+	//! Same as waitFor() with a std::chrono duration
+	template<typename Rep, typename Period>
+	bool waitFor(const std::chrono::duration<Rep, Period>& time) const
+	{
+		return waitUntil(Clock::now() + std::chrono::duration_cast<std::chrono::nanoseconds>(time).count());
+	}
+
+	//! Same as waitUntil() with a std::chrono time point of any clock
+	template<typename ClockType, typename DurationType>
+	bool waitUntil(const std::chrono::time_point<ClockType, DurationType>& deadline) const
+	{
+		return waitFor(deadline - ClockType::now());
+	}
+#endif
+
+#if defined(_TTHREAD_CPP11_)
+	/**
+	 * @brief then Schedules function to be called in the ThreadPool, with this Future as parameter, once its value is ready
+	 * @param function Any callable entity taking a Future<T> (by value or const reference)
+	 * @return Future of function's result
+	 */
+	template<typename Function>
+	Future< Detail::InvokeResult<Function, Future<T> > > then(Function&& function) const
+	{
+		typedef Detail::InvokeResult<Function, Future<T> > ReturnType;
+		typedef VariadicCaller<ReturnType, typename std::decay<Function>::type, Future<T> > ContinuationCaller;
+
+		Shared<Job, AtomicMTPolicy> job(new CallerJob<ReturnType>(ContinuationCaller(std::forward<Function>(function), *this)));
+		addContinuation(job);
+
+		return Future<ReturnType>(job);
+	}
+#else
+	/**
+	 * @brief then Schedules function to be called in the ThreadPool, with this Future as parameter, once its value is ready
+	 * @return Future of function's result
+	 */
+	template<typename ReturnType>
+	Future<ReturnType> then(ReturnType (*function)(Future<T>)) const
+	{
+		Shared<Job, AtomicMTPolicy> job(new CallerJob<ReturnType>(CopyFunction1ParamCaller<ReturnType, Future<T> >(function, *this)));
+		addContinuation(job);
+
+		return Future<ReturnType>(job);
+	}
+#endif
+
+	/**
+	 * @brief addContinuation Enqueues job into the ThreadPool once this Future's value is ready (right now if it already is). Building block for
+	 * then(), whenAll() and whenAny(). A default constructed Future has no operation to wait for, so job is enqueued right now too
+	 */
+	void addContinuation(Shared<Job, AtomicMTPolicy> job) const
+	{
+		if(!mJob.get())
+		{
+			ThreadPool::current().enqueueJob(job);
+			return;
+		}
+
+		callerJob()->addContinuation(job);
+	}
+
 private:
-	Shared<Job, MutexMTPolicy> mJob;
+	const CallerJobBase* callerJob() const
+	{
+		return static_cast<const CallerJobBase*>(mJob.get());
+	}
+
+	Shared<Job, AtomicMTPolicy> mJob;
 };
 
+/**
+ * @brief Continuation added to every Future given to whenAll() or whenAny(): tells its composite job which of them is ready
+ */
+template<typename CompositeJob>
+class ReadyNotifierJob : public Job
+{
+public:
+	ReadyNotifierJob(Shared<Job, AtomicMTPolicy> compositeJob, std::size_t index) :
+		mCompositeJob(compositeJob),
+		mIndex(index)
+	{
+	}
+
+	std::string name() const
+	{
+		return "ReadyNotifierJob";
+	}
+
+private:
+	void executeJob()
+	{
+		static_cast<CompositeJob*>(mCompositeJob.get())->futureReady(mIndex);
+	}
+
+	Shared<Job, AtomicMTPolicy> mCompositeJob;
+	std::size_t mIndex;
+};
+
+/**
+ * @brief Job behind whenAll(): it is never enqueued, the last ReadyNotifierJob to run completes it. whenAll() itself holds one more pending count
+ * until every notifier is added, so an empty group or already ready futures complete it too.
+ *
+ * While it waits there is a reference cycle: this job holds the futures, their jobs hold their continuations, the ReadyNotifierJobs, and these
+ * hold this job. Every operation releases its continuations once it is done (or cancelled, or failed), which breaks the cycle, so it only
+ * leaks if one of the futures belongs to a job which is never executed
+ */
+template<typename T>
+class WhenAllJob : public CallerJob< std::vector< Future<T> > >
+{
+public:
+	explicit WhenAllJob(const std::vector< Future<T> >& futures) :
+		mFutures(futures),
+		mPendingFutureNumber(futures.size() + 1)
+	{
+	}
+
+	std::string name() const
+	{
+		return "WhenAllJob";
+	}
+
+	void futureReady(std::size_t)
+	{
+		if(1 == mPendingFutureNumber.fetchSub(1, MemoryOrderAcquireRelease))
+		{
+			this->mResult.construct(mFutures);
+			this->setResultCalculated();
+		}
+	}
+
+private:
+	void executeJob()
+	{
+	}
+
+	std::vector< Future<T> > mFutures;
+	Atomic<std::size_t> mPendingFutureNumber;
+};
+
+/**
+ * @brief Job behind whenAny(): it is never enqueued, the first ReadyNotifierJob to run completes it
+ */
+class WhenAnyJob : public CallerJob<std::size_t>
+{
+public:
+	WhenAnyJob() :
+		mReady(0)
+	{
+	}
+
+	std::string name() const
+	{
+		return "WhenAnyJob";
+	}
+
+	void futureReady(std::size_t index)
+	{
+		int expected = 0;
+
+		if(mReady.compareExchange(expected, 1, MemoryOrderAcquireRelease))
+		{
+			mResult.construct(index);
+			setResultCalculated();
+		}
+	}
+
+private:
+	void executeJob()
+	{
+	}
+
+	Atomic<int> mReady;
+};
+
+/**
+ * @brief whenAll Returns a Future which becomes ready once every one of futures is. No thread waits for them meanwhile. Default constructed
+ * futures count as ready
+ * @return Future holding a copy of futures, all of them ready
+ */
+template<typename T>
+Future< std::vector< Future<T> > > whenAll(const std::vector< Future<T> >& futures)
+{
+	WhenAllJob<T>* compositeJob = new WhenAllJob<T>(futures);
+	Shared<Job, AtomicMTPolicy> job(compositeJob);
+
+	for(std::size_t i = 0; i < futures.size(); ++ i)
+	{
+		futures[i].addContinuation(Shared<Job, AtomicMTPolicy>(new ReadyNotifierJob< WhenAllJob<T> >(job, i)));
+	}
+
+	compositeJob->futureReady(futures.size());
+
+	return Future< std::vector< Future<T> > >(job);
+}
+
+/**
+ * @brief whenAny Returns a Future which becomes ready as soon as any of futures is. No thread waits for them meanwhile. Default constructed
+ * futures count as ready
+ * @return Future holding the index of the first ready future, or futures.size() if futures is empty
+ */
+template<typename T>
+Future<std::size_t> whenAny(const std::vector< Future<T> >& futures)
+{
+	WhenAnyJob* compositeJob = new WhenAnyJob();
+	Shared<Job, AtomicMTPolicy> job(compositeJob);
+
+	if(futures.empty())
+	{
+		compositeJob->futureReady(0);
+	}
+
+	for(std::size_t i = 0; i < futures.size(); ++ i)
+	{
+		futures[i].addContinuation(Shared<Job, AtomicMTPolicy>(new ReadyNotifierJob<WhenAnyJob>(job, i)));
+	}
+
+	return Future<std::size_t>(job);
+}
+
 }
 
 }
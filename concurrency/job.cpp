@@ -0,0 +1,16 @@
+#include "job.h"
+
+namespace Olagarro
+{
+
+namespace Concurrency
+{
+
+const Clock::TimePoint Job::NoDeadline;
+
+thread_local JobPriority Job::sCurrentPriority = NormalPriority;
+thread_local Clock::TimePoint Job::sCurrentDeadline = Job::NoDeadline;
+
+}
+
+}
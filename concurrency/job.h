@@ -26,8 +26,17 @@ freely, subject to the following restrictions:
 
 #include "caller.h"
 #include "threadpool.h"
+#include "joballocator.h"
+#include "clock.h"
+#include "jobpriority.h"
+#include "cancellation.h"
+#include "jobexception.h"
+#include "trace.h"
 #include <memory>
-#include "mutexmtpolicy.h"
+#include <new>
+#include <vector>
+#include <typeinfo>
+#include "atomicmtpolicy.h"
 
 #include <iostream>
 #include <sstream>
@@ -40,116 +49,600 @@ namespace Concurrency
 
 /**
  * @brief Interface for handling jobs or tasks by concurrency module. It encapsulates operations using the Command design pattern
+ *
+ * Jobs keep their own atomic reference count, so Shared<Job, AtomicMTPolicy> handles don't allocate anything and copying them is lock free
+ *
+ * Every job has a priority and optionally a deadline, taken from the innermost PriorityScope of the thread which creates it, and a
+ * CancellationToken, taken from the innermost CancellationToken::Scope. Jobs created by a running job inherit all of them, so all the slices of a
+ * concurrentFor launched with some priority get it too:
+ *
+ * \code
+ * {
+ *   Job::PriorityScope scope(HighPriority, Clock::now() + 2000000); // Must be done in 2 ms
+ *   Future<Frame> frame = launchJob(renderFrame);
+ * }
+ * \endcode
  */
-class Job
+class Job : public ReferenceCounted<AtomicMTPolicy>
 {
 public:
-	Job() {}
+	//! Deadline of jobs without deadline
+	static const Clock::TimePoint NoDeadline = 0;
+
+	/**
+	 * @brief Sets the priority and deadline of the jobs created by calling thread while the object lives. Scopes can be nested
+	 */
+	class PriorityScope
+	{
+	public:
+		explicit PriorityScope(JobPriority priority, Clock::TimePoint deadline = NoDeadline) :
+			mPreviousPriority(sCurrentPriority),
+			mPreviousDeadline(sCurrentDeadline)
+		{
+			sCurrentPriority = priority;
+			sCurrentDeadline = deadline;
+		}
+
+		~PriorityScope()
+		{
+			sCurrentPriority = mPreviousPriority;
+			sCurrentDeadline = mPreviousDeadline;
+		}
+
+	private:
+		PriorityScope(const PriorityScope&);
+		PriorityScope& operator = (const PriorityScope&);
+
+		JobPriority mPreviousPriority;
+		Clock::TimePoint mPreviousDeadline;
+	};
+
+	Job() :
+		mPriority(sCurrentPriority),
+		mDeadline(sCurrentDeadline),
+		mCancellationToken(CancellationToken::current()),
+		mEnqueueTime(0)
+	{
+	}
+
 	virtual ~Job() {}
 	virtual std::string name() const = 0;
 
+	/**
+	 * @brief typeName Job type ThreadPool telemetry counts the job as (see ThreadPool::telemetry()). Jobs returning the same pointer share
+	 * histograms, so it must be a string with static storage. By default it is the name of the job's dynamic type, which for jobs created by
+	 * launchJob() and concurrentFor() includes the type of the functor they call
+	 */
+	virtual const char* typeName() const
+	{
+		return typeid(*this).name();
+	}
+
+	JobPriority priority() const
+	{
+		return mPriority;
+	}
+
+	Clock::TimePoint deadline() const
+	{
+		return mDeadline;
+	}
+
+	const CancellationToken& cancellationToken() const
+	{
+		return mCancellationToken;
+	}
+
+	//! When the job was enqueued in a ThreadPool, 0 if it has not been
+	Clock::TimePoint enqueueTime() const
+	{
+		return mEnqueueTime;
+	}
+
+	void setEnqueueTime(Clock::TimePoint time)
+	{
+		mEnqueueTime = time;
+	}
+
+	bool isCancellationRequested() const
+	{
+		return mCancellationToken.isCancelled();
+	}
+
+	// Jobs are created and destroyed all the time, they use JobAllocator's per thread free lists instead of the system allocator
+	static void* operator new(std::size_t size)
+	{
+		return JobAllocator::allocate(size);
+	}
+
+	static void operator delete(void* memory, std::size_t size)
+	{
+		JobAllocator::deallocate(memory, size);
+	}
+
 	void execute()
 	{
-		executeJob();
+		// Jobs created meanwhile inherit our priority, deadline and cancellation token
+		PriorityScope priorityScope(mPriority, mDeadline);
+		CancellationToken::Scope cancellationScope(mCancellationToken);
+		OLAGARRO_TRACE_JOB_SCOPE(*this);
+
+		if(mCancellationToken.isCancelled())
+		{
+			cancelJob();
+		}
+		else
+		{
+			executeJob();
+		}
+	}
+
+	/**
+	 * @brief abandon Called instead of execute() for a job which will never be executed, like the ones still enqueued when their ThreadPool is
+	 * destroyed. It is handled like a job cancelled before starting, so whoever waits for it is woken
+	 */
+	void abandon()
+	{
+		PriorityScope priorityScope(mPriority, mDeadline);
+		CancellationToken::Scope cancellationScope(mCancellationToken);
+
+		cancelJob();
 	}
 
 private:
 	virtual void executeJob() = 0;
+
+	/**
+	 * @brief cancelJob Called instead of executeJob() when the job is cancelled before starting. By default jobs can't be cancelled and it just
+	 * executes them
+	 */
+	virtual void cancelJob()
+	{
+		executeJob();
+	}
+
+	static thread_local JobPriority sCurrentPriority;
+	static thread_local Clock::TimePoint sCurrentDeadline;
+
+	JobPriority mPriority;
+	Clock::TimePoint mDeadline;
+	CancellationToken mCancellationToken;
+	Clock::TimePoint mEnqueueTime;
 };
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 
+/**
+ * @brief Completion state shared by every CallerJob: a flag telling if the job has been executed and the jobs which have to run after it
+ * (continuations). Waiting and continuation handling don't depend on the job's return type so they live here
+ */
+class CallerJobBase : public Job
+{
+public:
+	CallerJobBase() :
+		mResultCalculated(false),
+		mCancelled(false)
+	{
+	}
+
+	bool isResultCalculated() const
+	{
+		tthread::lock_guard<tthread::mutex> guard(mMutex);
+
+		return mResultCalculated;
+	}
+
+	//! True if the job was cancelled before being done, so there is no result
+	bool isCancelled() const
+	{
+		tthread::lock_guard<tthread::mutex> guard(mMutex);
+
+		return mCancelled;
+	}
+
+	//! True if the job threw an exception instead of returning a result
+	bool isFailed() const
+	{
+		tthread::lock_guard<tthread::mutex> guard(mMutex);
+
+		return mResultCalculated && !mException.empty();
+	}
+
+	/**
+	 * @brief addContinuation Enqueues continuation as soon as this job is executed. If it has already been executed continuation is enqueued right
+	 * now. Either way it goes to the ThreadPool current when addContinuation() is called, not to the one of the thread which executes this job
+	 */
+	void addContinuation(Shared<Job, AtomicMTPolicy> continuation) const
+	{
+		ThreadPool& pool = ThreadPool::current();
+
+		{
+			tthread::lock_guard<tthread::mutex> guard(mMutex);
+
+			if(!mResultCalculated)
+			{
+				mContinuations.push_back(Continuation(continuation, pool));
+				return;
+			}
+		}
+
+		pool.enqueueJob(continuation);
+	}
+
+	/**
+	 * @brief waitForResultUntil Blocks until job is executed or deadline is reached, whatever happens first. Unlike waitForResult() it does not
+	 * execute other jobs meanwhile, as any of them could take longer than the time left
+	 * @return true if job has been executed
+	 */
+	bool waitForResultUntil(Clock::TimePoint deadline) const
+	{
+		tthread::lock_guard<tthread::mutex> guard(mMutex);
+
+		while(!mResultCalculated)
+		{
+			const Clock::TimePoint now = Clock::now();
+
+			if(now >= deadline)
+			{
+				return false;
+			}
+
+			// Rounded up, so it does not wake up just before deadline and spin
+			mCondVariable.timed_wait(mMutex, (deadline - now + 999) / 1000);
+		}
+
+		return true;
+	}
+
+protected:
+	/**
+	 * @brief waitForResult Blocks until job is executed. If calling thread is a JobThread it executes other pending jobs meanwhile, so a job waiting
+	 * for another one does not keep a JobThread blocked (and nested jobs cannot deadlock the ThreadPool)
+	 */
+	void waitForResult() const
+	{
+		while(!isResultCalculated() && ThreadPool::executePendingJob())
+		{
+		}
+
+		tthread::lock_guard<tthread::mutex> guard(mMutex);
+
+		while(!mResultCalculated)
+		{
+			mCondVariable.wait(mMutex);
+		}
+	}
+
+	/**
+	 * @brief waitForValidResult Same as waitForResult(), throwing JobCancelled if job was cancelled or the job's exception if it threw one
+	 */
+	void waitForValidResult() const
+	{
+		waitForResult();
+
+		if(mCancelled)
+		{
+			throw JobCancelled();
+		}
+
+		if(!mException.empty())
+		{
+			mException.rethrow();
+		}
+	}
+
+	/**
+	 * @brief setCancelled Finishes the job without result: waiters are woken up and continuations enqueued as if it had been executed
+	 */
+	void setCancelled()
+	{
+		{
+			tthread::lock_guard<tthread::mutex> guard(mMutex);
+
+			mCancelled = true;
+		}
+
+		setResultCalculated();
+	}
+
+	/**
+	 * @brief setFailed Finishes the job with the exception being handled instead of a result, so it must be called from a catch block. Waiters
+	 * get it thrown from result()
+	 */
+	void setFailed()
+	{
+		{
+			tthread::lock_guard<tthread::mutex> guard(mMutex);
+
+			mException.capture();
+		}
+
+		setResultCalculated();
+	}
+
+	//! Same as setFailed() with an exception caught before
+	void setFailed(const ExceptionHolder& exception)
+	{
+		{
+			tthread::lock_guard<tthread::mutex> guard(mMutex);
+
+			mException = exception;
+		}
+
+		setResultCalculated();
+	}
+
+	/**
+	 * @brief setResultCalculated Marks job as executed, wakes up its waiters and enqueues its continuations. Derived jobs must store their result
+	 * before calling it
+	 */
+	void setResultCalculated()
+	{
+		std::vector<Continuation> continuations;
+
+		{
+			tthread::lock_guard<tthread::mutex> guard(mMutex);
+
+			mResultCalculated = true;
+			continuations.swap(mContinuations);
+
+			mCondVariable.notify_all();
+		}
+
+		// Enqueued outside the lock: a continuation may be executed (and query this job) before enqueueJob() returns
+		for(std::size_t i = 0; i < continuations.size(); ++ i)
+		{
+			continuations[i].pool->enqueueJob(continuations[i].job);
+		}
+	}
+
+	// A continuation and the ThreadPool it was added from
+	struct Continuation
+	{
+		Continuation(Shared<Job, AtomicMTPolicy> continuationJob, ThreadPool& continuationPool) :
+			job(continuationJob),
+			pool(&continuationPool)
+		{
+		}
+
+		Shared<Job, AtomicMTPolicy> job;
+		ThreadPool* pool;
+	};
+
+	bool mResultCalculated;
+	bool mCancelled;
+	ExceptionHolder mException;
+	mutable tthread::mutex mMutex;
+	mutable tthread::condition_variable mCondVariable;
+	mutable std::vector<Continuation> mContinuations;
+
+private:
+	void cancelJob()
+	{
+		setCancelled();
+	}
+};
+
+/**
+ * @brief Storage for a job's result. The result is constructed in place once calculated, so result types don't need a default constructor and
+ * move only types can be stored (C++11)
+ */
+template<typename T>
+class ResultStorage
+{
+public:
+	ResultStorage() :
+		mConstructed(false)
+	{
+	}
+
+	~ResultStorage()
+	{
+		if(mConstructed)
+		{
+			get().~T();
+		}
+	}
+
+#if defined(_TTHREAD_CPP11_)
+	template<typename Value>
+	void construct(Value&& value)
+	{
+		new(mStorage.buffer) T(std::forward<Value>(value));
+		mConstructed = true;
+	}
+#else
+	void construct(const T& value)
+	{
+		new(mStorage.buffer) T(value);
+		mConstructed = true;
+	}
+#endif
+
+	T& get()
+	{
+		return *reinterpret_cast<T*>(mStorage.buffer);
+	}
+
+	const T& get() const
+	{
+		return *reinterpret_cast<const T*>(mStorage.buffer);
+	}
+
+private:
+	ResultStorage(const ResultStorage&);
+	ResultStorage& operator = (const ResultStorage&);
+
+	bool mConstructed;
+
+#if defined(_TTHREAD_CPP11_)
+	union
+	{
+		typename std::aligned_storage<sizeof(T), alignof(T)>::type buffer[1];
+	} mStorage;
+#else
+	union
+	{
+		char buffer[sizeof(T)];
+		double alignDouble;
+		long double alignLongDouble;
+		long long alignLongLong;
+		void* alignPointer;
+	} mStorage;
+#endif
+};
+
+//! Type of a constant reference to a job's result: void for void jobs
+template<typename T>
+struct ResultReference
+{
+	typedef const T& Type;
+};
+
+template<>
+struct ResultReference<void>
+{
+	typedef void Type;
+};
+
 /**
  * @brief The general case of a Job which contains a call to some callable entity (free function, functor or member function)
  */
 template<typename ReturnType>
-class CallerJob : public Job
+class CallerJob : public CallerJobBase
 {
 public:
-	CallerJob(Caller<ReturnType>* caller) :
-		mCaller(caller),
-		mResultCalculated(false)
+	//! Used by derived jobs which don't call any Caller
+	CallerJob()
 	{
 	}
 
+#if defined(_TTHREAD_CPP11_)
+	template<typename CallerType>
+	explicit CallerJob(CallerType&& caller) :
+		mCaller(std::forward<CallerType>(caller))
+	{
+	}
+#else
+	template<typename CallerType>
+	explicit CallerJob(const CallerType& caller) :
+		mCaller(caller)
+	{
+	}
+#endif
+
 	~CallerJob()
 	{
 		if(!mResultCalculated)
 		{
-			result();
+			waitForResult();
 		}
 	}
 
+	//! Returns a copy of the result, blocking until it is calculated. Throws JobCancelled if the job was cancelled and the job's exception if it threw
 	ReturnType result() const
 	{
-		tthread::lock_guard<tthread::mutex> guard(mMutex);
+		return resultReference();
+	}
 
-		if(mResultCalculated)
-		{
-			return mResult;
-		}
+	//! Returns the result itself, blocking until it is calculated. The reference is valid while the job lives
+	const ReturnType& resultReference() const
+	{
+		// Once waitForResult() has seen mResultCalculated under the lock the result is visible and is not modified anymore, no need to lock
+		waitForValidResult();
 
-		mCondVariable.wait(mMutex);
+		return mResult.get();
+	}
 
-		return mResult;
+	/**
+	 * @brief takeResult Moves the result out of the job (copies it with C++03 compilers), blocking until it is calculated. Later calls get
+	 * a moved from object
+	 */
+	ReturnType takeResult()
+	{
+		waitForValidResult();
+
+#if defined(_TTHREAD_CPP11_)
+		return std::move(mResult.get());
+#else
+		return mResult.get();
+#endif
 	}
 
 	 std::string name() const
 	 {
 		 std::stringstream text;
-		 text << "CallerJob " << reinterpret_cast<int>(&mCondVariable);
+		 text << "CallerJob " << static_cast<const void*>(&mCondVariable);
 		 return text.str();
 	 }
 
 protected:
 	void executeJob()
 	{
-		tthread::lock_guard<tthread::mutex> guard(mMutex);
-
-		mResult = mCaller->performCall();
-
-		mResultCalculated = true;
+		// No need to lock while calling: nobody reads mResult until mResultCalculated is set
+		try
+		{
+			mResult.construct(mCaller.performCall());
+		}
+		catch(...)
+		{
+			setFailed();
+			return;
+		}
 
-		mCondVariable.notify_all();
+		setResultCalculated();
 	}
 
-	std::auto_ptr< Caller<ReturnType> > mCaller;
-	ReturnType mResult;
-	bool mResultCalculated;
-	mutable tthread::mutex mMutex;
-	mutable tthread::condition_variable mCondVariable;
+	CallerStorage<ReturnType> mCaller;
+	ResultStorage<ReturnType> mResult;
 };
 
 // void return type specialisation
 template<>
-class CallerJob<void> : public Job
+class CallerJob<void> : public CallerJobBase
 {
 public:
-	CallerJob(Caller<void>* caller) :
-		mCaller(caller),
-		mResultCalculated(false)
+	//! Used by derived jobs which don't call any Caller
+	CallerJob()
 	{
 	}
 
+#if defined(_TTHREAD_CPP11_)
+	template<typename CallerType>
+	explicit CallerJob(CallerType&& caller) :
+		mCaller(std::forward<CallerType>(caller))
+	{
+	}
+#else
+	template<typename CallerType>
+	explicit CallerJob(const CallerType& caller) :
+		mCaller(caller)
+	{
+	}
+#endif
+
 	~CallerJob()
 	{
 		if(!mResultCalculated)
 		{
-			result();
+			waitForResult();
 		}
 	}
 
 	virtual void result() const
 	{
-		tthread::lock_guard<tthread::mutex> guard(mMutex);
+		waitForValidResult();
+	}
 
-		if(mResultCalculated)
-		{
-			return;
-		}
+	void resultReference() const
+	{
+		waitForValidResult();
+	}
 
-		mCondVariable.wait(mMutex);
+	void takeResult()
+	{
+		waitForValidResult();
 	}
 
 	std::string name() const
@@ -160,19 +653,20 @@ public:
 protected:
 	void executeJob()
 	{
-		mCaller->performCall();
-
-		tthread::lock_guard<tthread::mutex> guard(mMutex);
-
-		mResultCalculated = true;
+		try
+		{
+			mCaller.performCall();
+		}
+		catch(...)
+		{
+			setFailed();
+			return;
+		}
 
-		mCondVariable.notify_all();
+		setResultCalculated();
 	}
 
-	std::auto_ptr< Caller<void> > mCaller;
-	bool mResultCalculated;
-	mutable tthread::mutex mMutex;
-	mutable tthread::condition_variable mCondVariable;
+	CallerStorage<void> mCaller;
 };
 
 }
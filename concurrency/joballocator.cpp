@@ -0,0 +1,210 @@
+#include "joballocator.h"
+#include "threadexithook.h"
+#include "tinythread/tinythread.h"
+
+#include <new>
+#include <vector>
+
+namespace Olagarro
+{
+
+namespace Concurrency
+{
+
+namespace
+{
+
+const std::size_t SizeClassNumber = 5;
+const std::size_t SmallestSizeClass = 64;
+const int MaxCachedBlocks = 256;
+const int BatchSize = MaxCachedBlocks / 2;
+
+struct FreeBlock
+{
+	FreeBlock* next;
+};
+
+// Jobs are usually created by one thread and destroyed by another one, so blocks would pile up in some threads' free lists while others
+// allocate new ones. Threads with too many free blocks move a batch of them to the depot and threads without free blocks take a batch from it
+class Depot
+{
+public:
+	~Depot()
+	{
+		for(std::size_t i = 0; i < SizeClassNumber; ++ i)
+		{
+			for(std::size_t j = 0; j < mBatches[i].size(); ++ j)
+			{
+				FreeBlock* block = mBatches[i][j];
+
+				while(block)
+				{
+					FreeBlock* next = block->next;
+					::operator delete(block);
+					block = next;
+				}
+			}
+		}
+	}
+
+	void push(std::size_t sizeClass, FreeBlock* batch)
+	{
+		tthread::lock_guard<tthread::mutex> guard(mMutex);
+
+		mBatches[sizeClass].push_back(batch);
+	}
+
+	FreeBlock* pop(std::size_t sizeClass)
+	{
+		tthread::lock_guard<tthread::mutex> guard(mMutex);
+
+		if(mBatches[sizeClass].empty())
+		{
+			return 0;
+		}
+
+		FreeBlock* batch = mBatches[sizeClass].back();
+		mBatches[sizeClass].pop_back();
+
+		return batch;
+	}
+
+private:
+	tthread::mutex mMutex;
+	std::vector<FreeBlock*> mBatches[SizeClassNumber];
+};
+
+Depot depot;
+
+// Thread local storage in C++ 2003 compilers only accepts plain types
+thread_local FreeBlock* freeLists[SizeClassNumber];
+thread_local int freeBlockNumbers[SizeClassNumber];
+thread_local bool threadExitWatched;
+
+// Returns the free blocks of every thread which cached some to the system when it finishes, not only those of JobThreads, which release them
+// themselves: threads which launch jobs and finish would leak them otherwise
+void OLAGARRO_THREAD_EXIT_CALLBACK releaseCacheAtThreadExit(void* /*value*/)
+{
+	threadExitWatched = false;
+	JobAllocator::releaseThreadCache();
+}
+
+ThreadExitHook threadExitHook(&releaseCacheAtThreadExit);
+
+void watchThreadExit()
+{
+	if(!threadExitWatched)
+	{
+		threadExitHook.watchCallingThread(&threadExitHook);
+		threadExitWatched = true;
+	}
+}
+
+// Returns SizeClassNumber if size is too big to be cached
+std::size_t sizeClass(std::size_t size)
+{
+	std::size_t sizeClass = 0;
+	std::size_t classSize = SmallestSizeClass;
+
+	while(classSize < size && sizeClass < SizeClassNumber)
+	{
+		classSize <<= 1;
+		++ sizeClass;
+	}
+
+	return sizeClass;
+}
+
+}
+
+void* JobAllocator::allocate(std::size_t size)
+{
+	const std::size_t Class = sizeClass(size);
+
+	if(SizeClassNumber == Class)
+	{
+		return ::operator new(size);
+	}
+
+	if(!freeLists[Class])
+	{
+		freeLists[Class] = depot.pop(Class);
+		freeBlockNumbers[Class] = freeLists[Class]? BatchSize : 0;
+
+		if(freeLists[Class])
+		{
+			watchThreadExit();
+		}
+	}
+
+	FreeBlock* block = freeLists[Class];
+
+	if(block)
+	{
+		freeLists[Class] = block->next;
+		-- freeBlockNumbers[Class];
+		return block;
+	}
+
+	return ::operator new(SmallestSizeClass << Class);
+}
+
+void JobAllocator::deallocate(void* memory, std::size_t size)
+{
+	const std::size_t Class = sizeClass(size);
+
+	if(!memory)
+	{
+		return;
+	}
+
+	if(SizeClassNumber == Class)
+	{
+		::operator delete(memory);
+		return;
+	}
+
+	watchThreadExit();
+
+	FreeBlock* block = static_cast<FreeBlock*>(memory);
+	block->next = freeLists[Class];
+	freeLists[Class] = block;
+	++ freeBlockNumbers[Class];
+
+	if(MaxCachedBlocks < freeBlockNumbers[Class])
+	{
+		// Give the first BatchSize blocks to the depot
+		FreeBlock* last = freeLists[Class];
+
+		for(int i = 1; i < BatchSize; ++ i)
+		{
+			last = last->next;
+		}
+
+		FreeBlock* batch = freeLists[Class];
+		freeLists[Class] = last->next;
+		last->next = 0;
+		freeBlockNumbers[Class] -= BatchSize;
+
+		depot.push(Class, batch);
+	}
+}
+
+void JobAllocator::releaseThreadCache()
+{
+	for(std::size_t i = 0; i < SizeClassNumber; ++ i)
+	{
+		while(freeLists[i])
+		{
+			FreeBlock* block = freeLists[i];
+			freeLists[i] = block->next;
+			::operator delete(block);
+		}
+
+		freeBlockNumbers[i] = 0;
+	}
+}
+
+}
+
+}
@@ -0,0 +1,61 @@
+/*
+Copyright (c) 2014 Inaki Griego
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+		1. The origin of this software must not be misrepresented; you must not
+		claim that you wrote the original software. If you use this software
+		in a product, an acknowledgment in the product documentation would be
+		appreciated but is not required.
+
+		2. Altered source versions must be plainly marked as such, and must not be
+		misrepresented as being the original software.
+
+		3. This notice may not be removed or altered from any source
+		distribution.
+*/
+
+
+#ifndef JOBALLOCATOR_H
+#define JOBALLOCATOR_H
+
+#include <cstddef>
+
+namespace Olagarro
+{
+
+namespace Concurrency
+{
+
+/**
+ * @brief Memory allocator for Job objects.
+ *
+ * Every thread keeps a free list of recently released blocks for each size class (64, 128, 256, 512 and 1024 bytes), so once a program reaches its
+ * steady state launching a job does not reach the system allocator. Blocks released by a thread go to its own free lists, which are bounded: once
+ * full, a batch of blocks is moved to a shared depot where threads with empty free lists take them from (jobs are often created by one thread and
+ * destroyed by another one). Free lists are returned to the system when their threads finish. Bigger objects are always allocated by the system.
+ */
+class JobAllocator
+{
+public:
+	static void* allocate(std::size_t size);
+	static void deallocate(void* memory, std::size_t size);
+
+	/**
+	 * @brief releaseThreadCache Returns calling thread's free blocks to the system. Every thread which cached blocks does it when it finishes,
+	 * JobThreads call it before finishing too
+	 */
+	static void releaseThreadCache();
+};
+
+}
+
+}
+
+#endif // JOBALLOCATOR_H
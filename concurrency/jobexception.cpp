@@ -0,0 +1,110 @@
+#include "jobexception.h"
+#include "cancellation.h"
+
+#include <sstream>
+
+namespace Olagarro
+{
+
+namespace Concurrency
+{
+
+void ExceptionHolder::capture()
+{
+#if defined(_TTHREAD_CPP11_)
+	mException = std::current_exception();
+#else
+	try
+	{
+		throw;
+	}
+	catch(const AggregateException& exception)
+	{
+		mThrower.reset(new ExceptionThrower<AggregateException>(exception));
+	}
+	catch(const JobCancelled& exception)
+	{
+		mThrower.reset(new ExceptionThrower<JobCancelled>(exception));
+	}
+	catch(const JobFailed& exception)
+	{
+		mThrower.reset(new ExceptionThrower<JobFailed>(exception));
+	}
+	catch(const std::exception& exception)
+	{
+		mThrower.reset(new ExceptionThrower<JobFailed>(JobFailed(exception.what())));
+	}
+	catch(...)
+	{
+		mThrower.reset(new ExceptionThrower<JobFailed>(JobFailed("Unknown exception")));
+	}
+#endif
+}
+
+void ExceptionHolder::rethrow() const
+{
+#if defined(_TTHREAD_CPP11_)
+	std::rethrow_exception(mException);
+#else
+	mThrower->raise();
+#endif
+}
+
+bool ExceptionHolder::empty() const
+{
+#if defined(_TTHREAD_CPP11_)
+	return !mException;
+#else
+	return mThrower.isNull();
+#endif
+}
+
+std::string ExceptionHolder::message() const
+{
+	try
+	{
+		rethrow();
+	}
+	catch(const std::exception& exception)
+	{
+		return exception.what();
+	}
+	catch(...)
+	{
+	}
+
+	return "Unknown exception";
+}
+
+AggregateException::AggregateException(const std::vector<ExceptionHolder>& exceptions) :
+	std::runtime_error(buildMessage(exceptions)),
+	mExceptions(exceptions)
+{
+}
+
+std::size_t AggregateException::exceptionNumber() const
+{
+	return mExceptions.size();
+}
+
+void AggregateException::rethrow(std::size_t index) const
+{
+	mExceptions[index].rethrow();
+}
+
+std::string AggregateException::buildMessage(const std::vector<ExceptionHolder>& exceptions)
+{
+	std::stringstream message;
+	message << exceptions.size() << " slice(s) failed";
+
+	if(!exceptions.empty())
+	{
+		message << ", first one: " << exceptions.front().message();
+	}
+
+	return message.str();
+}
+
+}
+
+}
@@ -0,0 +1,132 @@
+/*
+Copyright (c) 2014 Inaki Griego
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+		1. The origin of this software must not be misrepresented; you must not
+		claim that you wrote the original software. If you use this software
+		in a product, an acknowledgment in the product documentation would be
+		appreciated but is not required.
+
+		2. Altered source versions must be plainly marked as such, and must not be
+		misrepresented as being the original software.
+
+		3. This notice may not be removed or altered from any source
+		distribution.
+*/
+
+
+#ifndef JOBEXCEPTION_H
+#define JOBEXCEPTION_H
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "atomicmtpolicy.h"
+#include "../common/shared.h"
+
+#if defined(_TTHREAD_CPP11_)
+	#include <exception>
+#endif
+
+namespace Olagarro
+{
+
+namespace Concurrency
+{
+
+/**
+ * @brief Keeps an exception thrown by a job so it can be thrown again by the thread which reads the job's result.
+ *
+ * With C++11 compilers it is an std::exception_ptr and the very same exception is thrown again. C++03 has no way to copy an arbitrary exception,
+ * so concurrency module's own exceptions are copied and any other one is thrown again as a JobFailed with the same what() message.
+ */
+class ExceptionHolder
+{
+public:
+	//! Takes the exception being handled, so it must be called from a catch block
+	void capture();
+
+	//! Throws the held exception. Must not be empty
+	void rethrow() const;
+
+	bool empty() const;
+
+	//! what() message of the held exception
+	std::string message() const;
+
+private:
+#if defined(_TTHREAD_CPP11_)
+	std::exception_ptr mException;
+#else
+	struct Thrower : public ReferenceCounted<AtomicMTPolicy>
+	{
+		virtual ~Thrower() {}
+		virtual void raise() const = 0;
+	};
+
+	template<typename Exception>
+	struct ExceptionThrower : public Thrower
+	{
+		explicit ExceptionThrower(const Exception& exception) :
+			exception(exception)
+		{
+		}
+
+		void raise() const
+		{
+			throw exception;
+		}
+
+		Exception exception;
+	};
+
+	Shared<Thrower, AtomicMTPolicy> mThrower;
+#endif
+};
+
+/**
+ * @brief Thrown instead of exceptions which can't be copied (any exception not derived from std::exception, or any exception at all with C++03
+ * compilers but the ones of concurrency module)
+ */
+class JobFailed : public std::runtime_error
+{
+public:
+	explicit JobFailed(const std::string& message) :
+		std::runtime_error(message)
+	{
+	}
+};
+
+/**
+ * @brief Thrown by futures of concurrentFor() and concurrentReductorFor() when any of their slices threw an exception. A slice stops at the element
+ * which throws, the rest of slices go on, so it holds one exception per failed slice
+ */
+class AggregateException : public std::runtime_error
+{
+public:
+	explicit AggregateException(const std::vector<ExceptionHolder>& exceptions);
+	~AggregateException() throw() {}
+
+	std::size_t exceptionNumber() const;
+
+	//! Throws exception number index
+	void rethrow(std::size_t index) const;
+
+private:
+	static std::string buildMessage(const std::vector<ExceptionHolder>& exceptions);
+
+	std::vector<ExceptionHolder> mExceptions;
+};
+
+}
+
+}
+
+#endif // JOBEXCEPTION_H
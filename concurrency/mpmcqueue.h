@@ -0,0 +1,238 @@
+/*
+Copyright (c) 2014 Inaki Griego
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+		1. The origin of this software must not be misrepresented; you must not
+		claim that you wrote the original software. If you use this software
+		in a product, an acknowledgment in the product documentation would be
+		appreciated but is not required.
+
+		2. Altered source versions must be plainly marked as such, and must not be
+		misrepresented as being the original software.
+
+		3. This notice may not be removed or altered from any source
+		distribution.
+*/
+
+
+#ifndef MPMCQUEUE_H
+#define MPMCQUEUE_H
+
+#include <cstddef>
+#include <queue>
+#include "atomic.h"
+#include "tinythread/tinythread.h"
+
+namespace Olagarro
+{
+
+namespace Concurrency
+{
+
+/**
+ * @brief Multi-producer/multi-consumer FIFO queue.
+ *
+ * Elements are stored in a bounded lock-free ring buffer (Dmitry Vyukov's algorithm: every cell has a sequence number telling producers and
+ * consumers whether it is free or holds an element, so they only compete for a position counter with a compare and swap). When the ring is full
+ * elements go to a mutex protected overflow queue. While there are elements in the overflow queue new elements go there too, so the ring drains
+ * first and elements keep their FIFO order.
+ */
+template<typename T>
+class MPMCQueue
+{
+public:
+	/**
+	 * @brief MPMCQueue
+	 * @param capacity Ring buffer's capacity, rounded up to a power of two
+	 */
+	explicit MPMCQueue(std::size_t capacity = 4096) :
+		mEnqueuePosition(0),
+		mDequeuePosition(0),
+		mOverflowNumber(0)
+	{
+		std::size_t size = 2;
+
+		while(size < capacity)
+		{
+			size <<= 1;
+		}
+
+		mMask = size - 1;
+		mCells = new Cell[size];
+
+		for(std::size_t i = 0; i < size; ++ i)
+		{
+			mCells[i].sequence.store(i, MemoryOrderRelaxed);
+		}
+	}
+
+	~MPMCQueue()
+	{
+		delete [] mCells;
+	}
+
+	void push(const T& element)
+	{
+		if(0 == mOverflowNumber.load(MemoryOrderAcquire) && pushToRing(element))
+		{
+			return;
+		}
+
+		tthread::lock_guard<tthread::mutex> guard(mOverflowMutex);
+
+		mOverflow.push(element);
+		mOverflowNumber.fetchAdd(1);
+	}
+
+	/**
+	 * @brief pop Takes the oldest element
+	 * @return false if queue was empty
+	 */
+	bool pop(T& element)
+	{
+		if(popFromRing(element))
+		{
+			return true;
+		}
+
+		if(0 == mOverflowNumber.load(MemoryOrderAcquire))
+		{
+			return false;
+		}
+
+		tthread::lock_guard<tthread::mutex> guard(mOverflowMutex);
+
+		if(mOverflow.empty())
+		{
+			return false;
+		}
+
+		element = mOverflow.front();
+		mOverflow.pop();
+		mOverflowNumber.fetchSub(1);
+
+		return true;
+	}
+
+	/**
+	 * @brief empty As any other query on a concurrent container, result can be outdated as soon as it is returned
+	 */
+	bool empty() const
+	{
+		return mEnqueuePosition.load() == mDequeuePosition.load() && 0 == mOverflowNumber.load();
+	}
+
+	std::size_t capacity() const
+	{
+		return mMask + 1;
+	}
+
+private:
+	struct Cell
+	{
+		Atomic<std::size_t> sequence;
+		T element;
+	};
+
+	bool pushToRing(const T& element)
+	{
+		std::size_t position = mEnqueuePosition.load(MemoryOrderRelaxed);
+		Cell* cell;
+
+		while(true)
+		{
+			cell = &mCells[position & mMask];
+
+			const std::size_t Sequence = cell->sequence.load(MemoryOrderAcquire);
+			const std::ptrdiff_t Difference = static_cast<std::ptrdiff_t>(Sequence) - static_cast<std::ptrdiff_t>(position);
+
+			if(0 == Difference)
+			{
+				if(mEnqueuePosition.compareExchange(position, position + 1, MemoryOrderRelaxed))
+				{
+					break;
+				}
+			}
+			else if(0 > Difference)
+			{
+				return false; // Full
+			}
+			else
+			{
+				position = mEnqueuePosition.load(MemoryOrderRelaxed);
+			}
+		}
+
+		cell->element = element;
+		cell->sequence.store(position + 1, MemoryOrderRelease);
+
+		return true;
+	}
+
+	bool popFromRing(T& element)
+	{
+		std::size_t position = mDequeuePosition.load(MemoryOrderRelaxed);
+		Cell* cell;
+
+		while(true)
+		{
+			cell = &mCells[position & mMask];
+
+			const std::size_t Sequence = cell->sequence.load(MemoryOrderAcquire);
+			const std::ptrdiff_t Difference = static_cast<std::ptrdiff_t>(Sequence) - static_cast<std::ptrdiff_t>(position + 1);
+
+			if(0 == Difference)
+			{
+				if(mDequeuePosition.compareExchange(position, position + 1, MemoryOrderRelaxed))
+				{
+					break;
+				}
+			}
+			else if(0 > Difference)
+			{
+				return false; // Empty
+			}
+			else
+			{
+				position = mDequeuePosition.load(MemoryOrderRelaxed);
+			}
+		}
+
+		element = cell->element;
+		cell->element = T(); // Don't keep anything alive from a free cell
+		cell->sequence.store(position + mMask + 1, MemoryOrderRelease);
+
+		return true;
+	}
+
+	MPMCQueue(const MPMCQueue&);
+	MPMCQueue& operator = (const MPMCQueue&);
+
+	// Producers' and consumers' counters are kept in different cache lines
+	enum { CacheLineSize = 64 };
+
+	Cell* mCells;
+	std::size_t mMask;
+	char mPadding0[CacheLineSize];
+	Atomic<std::size_t> mEnqueuePosition;
+	char mPadding1[CacheLineSize];
+	Atomic<std::size_t> mDequeuePosition;
+	char mPadding2[CacheLineSize];
+
+	tthread::mutex mOverflowMutex;
+	std::queue<T> mOverflow;
+	Atomic<int> mOverflowNumber;
+};
+
+}
+
+}
+
+#endif // MPMCQUEUE_H
@@ -0,0 +1,143 @@
+#include "numatopology.h"
+#include "tinythread/tinythread.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+namespace Olagarro
+{
+
+namespace Concurrency
+{
+
+namespace
+{
+
+bool readLine(const std::string& fileName, std::string& line)
+{
+	std::ifstream file(fileName.c_str());
+
+	return file && std::getline(file, line);
+}
+
+}
+
+NumaTopology::NumaTopology(const std::vector<Node>& nodes) :
+	mNodes(nodes)
+{
+	if(mNodes.empty())
+	{
+		Node node;
+		node.id = 0;
+
+		for(unsigned i = 0; i < std::max(1u, tthread::thread::hardware_concurrency()); ++ i)
+		{
+			node.cpus.push_back(i);
+		}
+
+		mNodes.push_back(node);
+	}
+}
+
+const NumaTopology& NumaTopology::system()
+{
+#if defined(__linux__)
+	static const NumaTopology topology = fromSysfs("/sys/devices/system/node");
+#else
+	static const NumaTopology topology;
+#endif
+
+	return topology;
+}
+
+NumaTopology NumaTopology::fromSysfs(const std::string& nodeDirectory)
+{
+	std::vector<Node> nodes;
+	std::string line;
+
+	if(!readLine(nodeDirectory + "/online", line))
+	{
+		return NumaTopology();
+	}
+
+	const std::vector<unsigned> nodeIds = parseCpuList(line);
+
+	for(std::size_t i = 0; i < nodeIds.size(); ++ i)
+	{
+		std::stringstream fileName;
+		fileName << nodeDirectory << "/node" << nodeIds[i] << "/cpulist";
+
+		Node node;
+		node.id = nodeIds[i];
+
+		if(readLine(fileName.str(), line))
+		{
+			node.cpus = parseCpuList(line);
+		}
+
+		if(!node.cpus.empty())
+		{
+			nodes.push_back(node);
+		}
+	}
+
+	return NumaTopology(nodes);
+}
+
+std::vector<unsigned> NumaTopology::parseCpuList(const std::string& text)
+{
+	std::vector<unsigned> cpus;
+	std::stringstream stream(text);
+	std::string range;
+
+	while(std::getline(stream, range, ','))
+	{
+		unsigned first = 0;
+		unsigned last = 0;
+		char dash = 0;
+
+		std::stringstream rangeStream(range);
+
+		if(!(rangeStream >> first))
+		{
+			continue;
+		}
+
+		last = (rangeStream >> dash >> last && '-' == dash)? last : first;
+
+		for(unsigned cpu = first; cpu <= last; ++ cpu)
+		{
+			cpus.push_back(cpu);
+		}
+	}
+
+	return cpus;
+}
+
+std::size_t NumaTopology::nodeNumber() const
+{
+	return mNodes.size();
+}
+
+const NumaTopology::Node& NumaTopology::node(std::size_t index) const
+{
+	return mNodes[index];
+}
+
+std::size_t NumaTopology::nodeOfCpu(unsigned cpu) const
+{
+	for(std::size_t i = 0; i < mNodes.size(); ++ i)
+	{
+		if(std::find(mNodes[i].cpus.begin(), mNodes[i].cpus.end(), cpu) != mNodes[i].cpus.end())
+		{
+			return i;
+		}
+	}
+
+	return 0;
+}
+
+}
+
+}
@@ -0,0 +1,90 @@
+/*
+Copyright (c) 2014 Inaki Griego
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+		1. The origin of this software must not be misrepresented; you must not
+		claim that you wrote the original software. If you use this software
+		in a product, an acknowledgment in the product documentation would be
+		appreciated but is not required.
+
+		2. Altered source versions must be plainly marked as such, and must not be
+		misrepresented as being the original software.
+
+		3. This notice may not be removed or altered from any source
+		distribution.
+*/
+
+
+#ifndef NUMATOPOLOGY_H
+#define NUMATOPOLOGY_H
+
+#include <string>
+#include <vector>
+
+namespace Olagarro
+{
+
+namespace Concurrency
+{
+
+/**
+ * @brief NUMA nodes of the machine and the CPUs each one contains.
+ *
+ * ThreadPool uses it to group its JobThreads per node, so jobs bound to a node (see ThreadPool::enqueueJob()) run close to their memory. In Linux it
+ * is read from sysfs, any other system is seen as a single node with all the hardware threads.
+ */
+class NumaTopology
+{
+public:
+	struct Node
+	{
+		//! Node number given by the system
+		unsigned id;
+		std::vector<unsigned> cpus;
+	};
+
+	/**
+	 * @brief NumaTopology Builds a topology with the given nodes. Without nodes there is a single one with every hardware thread
+	 */
+	explicit NumaTopology(const std::vector<Node>& nodes = std::vector<Node>());
+
+	/**
+	 * @brief system This machine's topology, read once from /sys/devices/system/node
+	 */
+	static const NumaTopology& system();
+
+	/**
+	 * @brief fromSysfs Reads the topology from a sysfs node directory: the online nodes and their cpulist files. Nodes without CPUs (memory only
+	 * ones) are skipped as no thread can run there
+	 */
+	static NumaTopology fromSysfs(const std::string& nodeDirectory);
+
+	/**
+	 * @brief parseCpuList Parses a sysfs list, like "0-3,8,10-11"
+	 */
+	static std::vector<unsigned> parseCpuList(const std::string& text);
+
+	std::size_t nodeNumber() const;
+	const Node& node(std::size_t index) const;
+
+	/**
+	 * @brief nodeOfCpu Index (not id) of the node containing cpu, 0 if no node contains it
+	 */
+	std::size_t nodeOfCpu(unsigned cpu) const;
+
+private:
+	std::vector<Node> mNodes;
+};
+
+}
+
+}
+
+#endif // NUMATOPOLOGY_H
@@ -0,0 +1,673 @@
+/*
+Copyright (c) 2014 Inaki Griego
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+		1. The origin of this software must not be misrepresented; you must not
+		claim that you wrote the original software. If you use this software
+		in a product, an acknowledgment in the product documentation would be
+		appreciated but is not required.
+
+		2. Altered source versions must be plainly marked as such, and must not be
+		misrepresented as being the original software.
+
+		3. This notice may not be removed or altered from any source
+		distribution.
+*/
+
+
+#ifndef PARALLELALGORITHMS_H
+#define PARALLELALGORITHMS_H
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <vector>
+#include "concurrentfor.h"
+#include "future.h"
+
+namespace Olagarro
+{
+
+namespace Concurrency
+{
+
+/**
+ * @brief executeConcurrentFor Same as concurrentFor() but the calling thread executes the ConcurrentForJob itself and returns once it is done,
+ * throwing its exception if any. Used by the parallel algorithms, which block until they are done like their std counterparts
+ */
+template<typename InputIterator, typename Functor>
+void executeConcurrentFor(InputIterator begin, InputIterator end, const Functor& functor, const Partitioner& partitioner)
+{
+	Shared<Job, AtomicMTPolicy> job(new ConcurrentForJob<InputIterator, Functor>(begin, end, functor, partitioner));
+
+	job->execute();
+
+	Future<void>(job).result();
+}
+
+/**
+ * @brief Divides a range in contiguous and ordered blocks, for the parallel algorithms which combine partial results in order (reduce, scan,
+ * copyIf and sort). Blocks are not smaller than partitioner's grain size and there are a few of them per JobThread, so the partitioner can still
+ * balance them
+ */
+class Blocks
+{
+public:
+	Blocks(std::size_t elementNumber, const Partitioner& partitioner) :
+		mElementNumber(elementNumber),
+		mPartitioner(partitioner.type(), 1)
+	{
+		const std::size_t GrainNumber = (elementNumber + partitioner.grainSize() - 1) / partitioner.grainSize();
+		const std::size_t MaximumBlockNumber = static_cast<std::size_t>(ThreadPool::current().threadNumber()) * BlocksPerThread;
+
+		// Never more blocks than elements, so no block is empty
+		mBlockNumber = std::max<std::size_t>(1, std::min(GrainNumber, MaximumBlockNumber));
+	}
+
+	std::size_t number() const
+	{
+		return mBlockNumber;
+	}
+
+	//! Index of block's first element. begin(number()) is the element number
+	std::size_t begin(std::size_t block) const
+	{
+		return static_cast<std::size_t>(static_cast<unsigned long long>(mElementNumber) * block / mBlockNumber);
+	}
+
+	std::size_t end(std::size_t block) const
+	{
+		return begin(block + 1);
+	}
+
+	//! Calls functor(int block, unsigned&) for every block concurrently and returns once all of them are done
+	template<typename Functor>
+	void forEach(const Functor& functor) const
+	{
+		std::vector<unsigned> blocks(mBlockNumber, 0);
+
+		executeConcurrentFor(blocks.begin(), blocks.end(), functor, mPartitioner);
+	}
+
+private:
+	enum { BlocksPerThread = 4 };
+
+	std::size_t mElementNumber;
+	std::size_t mBlockNumber;
+	Partitioner mPartitioner;
+};
+
+template<typename OutputIterator, typename UnaryOperation>
+struct TransformFunctor
+{
+	TransformFunctor(OutputIterator output, UnaryOperation operation) :
+		output(output),
+		operation(operation)
+	{
+	}
+
+	template<typename Value>
+	void operator()(int index, Value& value)
+	{
+		output[index] = operation(value);
+	}
+
+	OutputIterator output;
+	UnaryOperation operation;
+};
+
+// Reduces every block to partials[block]. With skipFirst partials must already hold block's first element
+template<typename InputIterator, typename T, typename BinaryOperation>
+struct ReduceBlockFunctor
+{
+	ReduceBlockFunctor(InputIterator first, const Blocks& blocks, std::vector<T>& partials, bool skipFirst, BinaryOperation operation) :
+		first(first),
+		blocks(&blocks),
+		partials(&partials),
+		skipFirst(skipFirst),
+		operation(operation)
+	{
+	}
+
+	void operator()(int block, unsigned&)
+	{
+		T partial = (*partials)[block];
+
+		for(std::size_t i = blocks->begin(block) + (skipFirst? 1 : 0); i < blocks->end(block); ++ i)
+		{
+			partial = operation(partial, first[i]);
+		}
+
+		(*partials)[block] = partial;
+	}
+
+	InputIterator first;
+	const Blocks* blocks;
+	std::vector<T>* partials;
+	bool skipFirst;
+	BinaryOperation operation;
+};
+
+// Scans every block starting from offsets[block]. First block of an inclusive scan has no offset
+template<typename InputIterator, typename OutputIterator, typename T, typename BinaryOperation>
+struct ScanBlockFunctor
+{
+	ScanBlockFunctor(InputIterator first, OutputIterator output, const Blocks& blocks, const std::vector<T>& offsets, bool inclusive,
+					 BinaryOperation operation) :
+		first(first),
+		output(output),
+		blocks(&blocks),
+		offsets(&offsets),
+		inclusive(inclusive),
+		operation(operation)
+	{
+	}
+
+	void operator()(int block, unsigned&)
+	{
+		std::size_t i = blocks->begin(block);
+		const std::size_t End = blocks->end(block);
+
+		T accumulated = inclusive && 0 == block? T(first[i]) : (*offsets)[block];
+
+		if(inclusive)
+		{
+			if(0 != block)
+			{
+				accumulated = operation(accumulated, first[i]);
+			}
+
+			output[i] = accumulated;
+			++ i;
+		}
+
+		for(; i < End; ++ i)
+		{
+			// Read before writing, so scans can be done in place
+			const T Value = first[i];
+
+			if(inclusive)
+			{
+				accumulated = operation(accumulated, Value);
+				output[i] = accumulated;
+			}
+			else
+			{
+				output[i] = accumulated;
+				accumulated = operation(accumulated, Value);
+			}
+		}
+	}
+
+	InputIterator first;
+	OutputIterator output;
+	const Blocks* blocks;
+	const std::vector<T>* offsets;
+	bool inclusive;
+	BinaryOperation operation;
+};
+
+/**
+ * @brief Implementation of parallelInclusiveScan() and parallelExclusiveScan(): blocks are reduced concurrently, their sums are scanned by the
+ * calling thread and then blocks are scanned concurrently, every one starting from its offset
+ */
+template<typename InputIterator, typename OutputIterator, typename T, typename BinaryOperation>
+OutputIterator parallelScan(InputIterator first, InputIterator last, OutputIterator output, const T& init, bool inclusive, BinaryOperation operation,
+							const Partitioner& partitioner)
+{
+	const std::size_t ElementNumber = last - first;
+
+	if(0 == ElementNumber)
+	{
+		return output;
+	}
+
+	const Blocks BlockRanges(ElementNumber, partitioner);
+
+	std::vector<T> offsets(BlockRanges.number(), init);
+
+	if(1 < BlockRanges.number())
+	{
+		// Sums start with block's first element, so no identity is needed
+		std::vector<T> sums;
+		sums.reserve(BlockRanges.number());
+
+		for(std::size_t block = 0; block < BlockRanges.number(); ++ block)
+		{
+			sums.push_back(first[BlockRanges.begin(block)]);
+		}
+
+		BlockRanges.forEach(ReduceBlockFunctor<InputIterator, T, BinaryOperation>(first, BlockRanges, sums, true, operation));
+
+		T accumulated = inclusive? sums[0] : operation(init, sums[0]);
+
+		for(std::size_t block = 1; block < BlockRanges.number(); ++ block)
+		{
+			offsets[block] = accumulated;
+			accumulated = operation(accumulated, sums[block]);
+		}
+	}
+
+	BlockRanges.forEach(ScanBlockFunctor<InputIterator, OutputIterator, T, BinaryOperation>(first, output, BlockRanges, offsets, inclusive,
+																							 operation));
+
+	return output + ElementNumber;
+}
+
+template<typename InputIterator, typename Predicate>
+struct CountIfBlockFunctor
+{
+	CountIfBlockFunctor(InputIterator first, const Blocks& blocks, std::vector<unsigned char>& flags, std::vector<std::size_t>& counts,
+						Predicate predicate) :
+		first(first),
+		blocks(&blocks),
+		flags(&flags),
+		counts(&counts),
+		predicate(predicate)
+	{
+	}
+
+	void operator()(int block, unsigned&)
+	{
+		std::size_t count = 0;
+
+		for(std::size_t i = blocks->begin(block); i < blocks->end(block); ++ i)
+		{
+			const unsigned char Flag = predicate(first[i])? 1 : 0;
+
+			(*flags)[i] = Flag;
+			count += Flag;
+		}
+
+		(*counts)[block] = count;
+	}
+
+	InputIterator first;
+	const Blocks* blocks;
+	std::vector<unsigned char>* flags;
+	std::vector<std::size_t>* counts;
+	Predicate predicate;
+};
+
+template<typename InputIterator, typename OutputIterator>
+struct CopyFlaggedBlockFunctor
+{
+	CopyFlaggedBlockFunctor(InputIterator first, OutputIterator output, const Blocks& blocks, const std::vector<unsigned char>& flags,
+							const std::vector<std::size_t>& offsets) :
+		first(first),
+		output(output),
+		blocks(&blocks),
+		flags(&flags),
+		offsets(&offsets)
+	{
+	}
+
+	void operator()(int block, unsigned&)
+	{
+		std::size_t position = (*offsets)[block];
+
+		for(std::size_t i = blocks->begin(block); i < blocks->end(block); ++ i)
+		{
+			if((*flags)[i])
+			{
+				output[position] = first[i];
+				++ position;
+			}
+		}
+	}
+
+	InputIterator first;
+	OutputIterator output;
+	const Blocks* blocks;
+	const std::vector<unsigned char>* flags;
+	const std::vector<std::size_t>* offsets;
+};
+
+template<typename RandomIterator, typename Compare>
+struct SortBlockFunctor
+{
+	SortBlockFunctor(RandomIterator first, const Blocks& blocks, Compare compare) :
+		first(first),
+		blocks(&blocks),
+		compare(compare)
+	{
+	}
+
+	void operator()(int block, unsigned&)
+	{
+		std::sort(first + blocks->begin(block), first + blocks->end(block), compare);
+	}
+
+	RandomIterator first;
+	const Blocks* blocks;
+	Compare compare;
+};
+
+template<typename SourceIterator, typename DestinationIterator>
+struct CopyBlockFunctor
+{
+	CopyBlockFunctor(SourceIterator source, DestinationIterator destination, const Blocks& blocks) :
+		source(source),
+		destination(destination),
+		blocks(&blocks)
+	{
+	}
+
+	void operator()(int block, unsigned&)
+	{
+		std::copy(source + blocks->begin(block), source + blocks->end(block), destination + blocks->begin(block));
+	}
+
+	SourceIterator source;
+	DestinationIterator destination;
+	const Blocks* blocks;
+};
+
+//! A part of the merge of two adjacent sorted runs: [firstBegin, firstEnd) and [secondBegin, secondEnd) go to destination
+struct MergeTask
+{
+	std::size_t firstBegin;
+	std::size_t firstEnd;
+	std::size_t secondBegin;
+	std::size_t secondEnd;
+	std::size_t destination;
+};
+
+template<typename SourceIterator, typename DestinationIterator, typename Compare>
+struct MergeFunctor
+{
+	MergeFunctor(SourceIterator source, DestinationIterator destination, const std::vector<MergeTask>& tasks, Compare compare) :
+		source(source),
+		destination(destination),
+		tasks(&tasks),
+		compare(compare)
+	{
+	}
+
+	void operator()(int index, unsigned&)
+	{
+		const MergeTask& Task = (*tasks)[index];
+
+		std::merge(source + Task.firstBegin, source + Task.firstEnd, source + Task.secondBegin, source + Task.secondEnd, destination + Task.destination,
+				   compare);
+	}
+
+	SourceIterator source;
+	DestinationIterator destination;
+	const std::vector<MergeTask>* tasks;
+	Compare compare;
+};
+
+/**
+ * @brief mergeRound Merges pairs of adjacent sorted runs of width blocks from source into destination. Every pair is split in as many independent
+ * merges as blocks it spans: the first run is cut in equal parts and the second one where their first elements would be inserted, so the whole
+ * round runs concurrently even when only one pair is left
+ */
+template<typename SourceIterator, typename DestinationIterator, typename Compare>
+void mergeRound(SourceIterator source, DestinationIterator destination, const Blocks& blocks, std::size_t width, Compare compare)
+{
+	std::vector<MergeTask> tasks;
+
+	for(std::size_t pair = 0; pair * 2 * width < blocks.number(); ++ pair)
+	{
+		const std::size_t FirstBegin = blocks.begin(pair * 2 * width);
+		const std::size_t FirstEnd = blocks.begin(std::min(blocks.number(), (pair * 2 + 1) * width));
+		const std::size_t SecondEnd = blocks.begin(std::min(blocks.number(), (pair * 2 + 2) * width));
+		const std::size_t PartNumber = 2 * width;
+
+		std::size_t firstPart = FirstBegin;
+		std::size_t secondPart = FirstEnd;
+
+		for(std::size_t part = 1; part <= PartNumber; ++ part)
+		{
+			std::size_t firstSplit = FirstEnd;
+			std::size_t secondSplit = SecondEnd;
+
+			if(PartNumber != part)
+			{
+				firstSplit = FirstBegin + (FirstEnd - FirstBegin) * part / PartNumber;
+				secondSplit = std::lower_bound(source + FirstEnd, source + SecondEnd, source[firstSplit], compare) - source;
+			}
+
+			if(firstPart != firstSplit || secondPart != secondSplit)
+			{
+				MergeTask task = { firstPart, firstSplit, secondPart, secondSplit, firstPart + secondPart - FirstEnd };
+				tasks.push_back(task);
+			}
+
+			firstPart = firstSplit;
+			secondPart = secondSplit;
+		}
+	}
+
+	std::vector<unsigned> taskIndices(tasks.size(), 0);
+
+	executeConcurrentFor(taskIndices.begin(), taskIndices.end(), MergeFunctor<SourceIterator, DestinationIterator, Compare>(source, destination,
+																														   tasks, compare),
+						 Partitioner(Partitioner::Static, 1));
+}
+
+//! Parallel version of std::transform: output[i] = operation(first[i]) for every element of [first, last)
+/*!
+	\param first Range's start position iterator
+	\param last Range's end position iterator
+	\param output Random access iterator to the start of the destination range, which can be first itself
+	\param operation A function or functor taking an element and returning the value to store. It is called concurrently
+	\param partitioner How the range is divided in slices, see Partitioner
+	\return Iterator to the element after the last one written
+*/
+template<typename InputIterator, typename OutputIterator, typename UnaryOperation>
+OutputIterator parallelTransform(InputIterator first, InputIterator last, OutputIterator output, UnaryOperation operation,
+								 const Partitioner& partitioner = Partitioner())
+{
+	executeConcurrentFor(first, last, TransformFunctor<OutputIterator, UnaryOperation>(output, operation), partitioner);
+
+	return output + (last - first);
+}
+
+//! Parallel version of std::accumulate for associative operations
+/*!
+	Every block of the range is reduced starting from identity and partial results are combined in order, so operation has to be associative but
+	does not need to be commutative. Unlike concurrentReductorFor() no merge method is needed.
+	\code
+	const double total = parallelReduce(values.begin(), values.end(), 0.0, std::plus<double>());
+	\endcode
+	\param first Range's start position iterator
+	\param last Range's end position iterator
+	\param identity Identity value of operation (0 for sums, 1 for products...). It is returned for empty ranges
+	\param operation A function or functor taking two values and returning their combination
+	\param partitioner How the range is divided, see Partitioner. Its grain size is the minimum number of elements per block
+	\return The reduction of the whole range
+*/
+template<typename InputIterator, typename T, typename BinaryOperation>
+T parallelReduce(InputIterator first, InputIterator last, const T& identity, BinaryOperation operation, const Partitioner& partitioner = Partitioner())
+{
+	const std::size_t ElementNumber = last - first;
+
+	if(0 == ElementNumber)
+	{
+		return identity;
+	}
+
+	const Blocks BlockRanges(ElementNumber, partitioner);
+
+	std::vector<T> partials(BlockRanges.number(), identity);
+
+	BlockRanges.forEach(ReduceBlockFunctor<InputIterator, T, BinaryOperation>(first, BlockRanges, partials, false, operation));
+
+	T result = partials[0];
+
+	for(std::size_t i = 1; i < partials.size(); ++ i)
+	{
+		result = operation(result, partials[i]);
+	}
+
+	return result;
+}
+
+//! Same as previous parallelReduce() adding the elements
+template<typename InputIterator, typename T>
+T parallelReduce(InputIterator first, InputIterator last, const T& identity)
+{
+	return parallelReduce(first, last, identity, std::plus<T>());
+}
+
+//! Parallel inclusive prefix scan: output[i] = first[0] op first[1] op ... op first[i]
+/*!
+	\param first Range's start position iterator
+	\param last Range's end position iterator
+	\param output Random access iterator to the start of the destination range, which can be first itself
+	\param operation An associative function or functor taking two values and returning their combination
+	\param partitioner How the range is divided, see Partitioner. Its grain size is the minimum number of elements per block
+	\return Iterator to the element after the last one written
+*/
+template<typename InputIterator, typename OutputIterator, typename BinaryOperation>
+OutputIterator parallelInclusiveScan(InputIterator first, InputIterator last, OutputIterator output, BinaryOperation operation,
+									 const Partitioner& partitioner = Partitioner())
+{
+	typedef typename std::iterator_traits<InputIterator>::value_type ValueType;
+
+	if(first == last)
+	{
+		return output;
+	}
+
+	// Inclusive scans never use init, any value is fine
+	return parallelScan(first, last, output, ValueType(*first), true, operation, partitioner);
+}
+
+//! Parallel exclusive prefix scan: output[0] = init and output[i] = init op first[0] op ... op first[i - 1]
+/*!
+	\param first Range's start position iterator
+	\param last Range's end position iterator
+	\param output Random access iterator to the start of the destination range, which can be first itself
+	\param init First value of the output
+	\param operation An associative function or functor taking two values and returning their combination
+	\param partitioner How the range is divided, see Partitioner. Its grain size is the minimum number of elements per block
+	\return Iterator to the element after the last one written
+*/
+template<typename InputIterator, typename OutputIterator, typename T, typename BinaryOperation>
+OutputIterator parallelExclusiveScan(InputIterator first, InputIterator last, OutputIterator output, const T& init, BinaryOperation operation,
+									 const Partitioner& partitioner = Partitioner())
+{
+	return parallelScan(first, last, output, init, false, operation, partitioner);
+}
+
+//! Parallel version of std::copy_if: copies the elements of [first, last) for which predicate is true, keeping their order
+/*!
+	Every block counts and flags its elements, the calling thread calculates where every block starts writing and then blocks copy concurrently.
+	Predicate is called once per element.
+	\param first Range's start position iterator
+	\param last Range's end position iterator
+	\param output Random access iterator to the start of the destination range, big enough for all copied elements
+	\param predicate A function or functor taking an element and returning true if it has to be copied. It is called concurrently
+	\param partitioner How the range is divided, see Partitioner. Its grain size is the minimum number of elements per block
+	\return Iterator to the element after the last one written
+*/
+template<typename InputIterator, typename OutputIterator, typename Predicate>
+OutputIterator parallelCopyIf(InputIterator first, InputIterator last, OutputIterator output, Predicate predicate,
+							  const Partitioner& partitioner = Partitioner())
+{
+	const std::size_t ElementNumber = last - first;
+
+	if(0 == ElementNumber)
+	{
+		return output;
+	}
+
+	const Blocks BlockRanges(ElementNumber, partitioner);
+
+	std::vector<unsigned char> flags(ElementNumber);
+	std::vector<std::size_t> offsets(BlockRanges.number());
+
+	BlockRanges.forEach(CountIfBlockFunctor<InputIterator, Predicate>(first, BlockRanges, flags, offsets, predicate));
+
+	// Counts become offsets
+	std::size_t total = 0;
+
+	for(std::size_t block = 0; block < offsets.size(); ++ block)
+	{
+		const std::size_t Count = offsets[block];
+
+		offsets[block] = total;
+		total += Count;
+	}
+
+	BlockRanges.forEach(CopyFlaggedBlockFunctor<InputIterator, OutputIterator>(first, output, BlockRanges, flags, offsets));
+
+	return output + total;
+}
+
+//! Parallel version of std::sort
+/*!
+	Blocks are sorted concurrently with std::sort and then merged pairwise, every round of merges running concurrently too. It needs a temporary copy
+	of the range, so elements have to be copy constructible and assignable. As std::sort it is not stable.
+	\param first Range's start position iterator
+	\param last Range's end position iterator
+	\param compare Strict weak ordering used to sort, as in std::sort
+	\param partitioner How the range is divided, see Partitioner. Its grain size is the minimum number of elements per block
+*/
+template<typename RandomIterator, typename Compare>
+void parallelSort(RandomIterator first, RandomIterator last, Compare compare, const Partitioner& partitioner = Partitioner())
+{
+	typedef typename std::iterator_traits<RandomIterator>::value_type ValueType;
+	typedef typename std::vector<ValueType>::iterator BufferIterator;
+
+	const std::size_t ElementNumber = last - first;
+
+	if(2 > ElementNumber)
+	{
+		return;
+	}
+
+	const Blocks BlockRanges(ElementNumber, partitioner);
+
+	BlockRanges.forEach(SortBlockFunctor<RandomIterator, Compare>(first, BlockRanges, compare));
+
+	if(1 == BlockRanges.number())
+	{
+		return;
+	}
+
+	std::vector<ValueType> buffer(first, last);
+	bool sortedInBuffer = false;
+
+	for(std::size_t width = 1; width < BlockRanges.number(); width *= 2)
+	{
+		if(sortedInBuffer)
+		{
+			mergeRound(buffer.begin(), first, BlockRanges, width, compare);
+		}
+		else
+		{
+			mergeRound(first, buffer.begin(), BlockRanges, width, compare);
+		}
+
+		sortedInBuffer = !sortedInBuffer;
+	}
+
+	if(sortedInBuffer)
+	{
+		BlockRanges.forEach(CopyBlockFunctor<BufferIterator, RandomIterator>(buffer.begin(), first, BlockRanges));
+	}
+}
+
+//! Same as previous parallelSort() using operator <
+template<typename RandomIterator>
+void parallelSort(RandomIterator first, RandomIterator last)
+{
+	parallelSort(first, last, std::less<typename std::iterator_traits<RandomIterator>::value_type>());
+}
+
+}
+
+}
+
+#endif // PARALLELALGORITHMS_H
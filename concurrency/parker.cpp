@@ -0,0 +1,132 @@
+#include "parker.h"
+
+#if defined(__linux__)
+	#include <linux/futex.h>
+	#include <sys/syscall.h>
+	#include <unistd.h>
+#endif
+
+namespace Olagarro
+{
+
+namespace Concurrency
+{
+
+Parker::Parker(Clock::Duration spin) :
+	mState(Empty),
+	mSpin(spin)
+{
+}
+
+void Parker::park()
+{
+	if(tryConsume())
+	{
+		return;
+	}
+
+	const Clock::Duration Spin = mSpin.load(MemoryOrderRelaxed);
+
+	if(0 < Spin)
+	{
+		const Clock::TimePoint End = Clock::now() + Spin;
+
+		// Reading the clock costs more than a pause, so it is checked every few iterations
+		for(unsigned i = 1; ; ++ i)
+		{
+			cpuRelax();
+
+			if(Notified == mState.load(MemoryOrderRelaxed) && tryConsume())
+			{
+				return;
+			}
+
+			if(0 == i % 64 && Clock::now() >= End)
+			{
+				break;
+			}
+		}
+	}
+
+	// Empty -> Parked, or Notified -> Empty if a permit arrived meanwhile
+	if(Notified == mState.fetchSub(1, MemoryOrderAcquire))
+	{
+		return;
+	}
+
+	for(;;)
+	{
+		block();
+
+		int expected = Notified;
+		if(mState.compareExchange(expected, Empty, MemoryOrderAcquire))
+		{
+			return;
+		}
+
+		// Spurious wake up: state is still Parked
+	}
+}
+
+void Parker::unpark()
+{
+	if(Parked == mState.exchange(Notified, MemoryOrderRelease))
+	{
+		wake();
+	}
+}
+
+bool Parker::isNotified() const
+{
+	return Notified == mState.load(MemoryOrderAcquire);
+}
+
+void Parker::setSpin(Clock::Duration spin)
+{
+	mSpin.store(spin, MemoryOrderRelaxed);
+}
+
+bool Parker::tryConsume()
+{
+	int expected = Notified;
+	return mState.compareExchange(expected, Empty, MemoryOrderAcquire);
+}
+
+#if defined(__linux__)
+
+void Parker::block()
+{
+	// Returns immediately if state is not Parked anymore, so an unpark() done before blocking is not missed
+	syscall(SYS_futex, const_cast<int*>(mState.address()), FUTEX_WAIT_PRIVATE, static_cast<int>(Parked), 0, 0, 0);
+}
+
+void Parker::wake()
+{
+	syscall(SYS_futex, const_cast<int*>(mState.address()), FUTEX_WAKE_PRIVATE, 1, 0, 0, 0);
+}
+
+#else
+
+void Parker::block()
+{
+	tthread::lock_guard<tthread::mutex> guard(mMutex);
+
+	while(Parked == mState.load())
+	{
+		mCondVariable.wait(mMutex);
+	}
+}
+
+void Parker::wake()
+{
+	// Locking makes the notification impossible to happen between block()'s check and its wait
+	tthread::lock_guard<tthread::mutex> guard(mMutex);
+
+	mCondVariable.notify_one();
+}
+
+#endif
+
+}
+
+}
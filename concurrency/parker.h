@@ -0,0 +1,95 @@
+/*
+Copyright (c) 2014 Inaki Griego
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+		1. The origin of this software must not be misrepresented; you must not
+		claim that you wrote the original software. If you use this software
+		in a product, an acknowledgment in the product documentation would be
+		appreciated but is not required.
+
+		2. Altered source versions must be plainly marked as such, and must not be
+		misrepresented as being the original software.
+
+		3. This notice may not be removed or altered from any source
+		distribution.
+*/
+
+
+#ifndef PARKER_H
+#define PARKER_H
+
+#include "atomic.h"
+#include "clock.h"
+#include "tinythread/tinythread.h"
+
+//! Default time, in nanoseconds, a Parker spins before blocking in the kernel
+#if !defined(OLAGARRO_PARK_SPIN_NANOSECONDS)
+	#define OLAGARRO_PARK_SPIN_NANOSECONDS 20000
+#endif
+
+namespace Olagarro
+{
+
+namespace Concurrency
+{
+
+/**
+ * @brief Blocks a single thread until another one wakes it up, like a binary semaphore owned by the blocked thread.
+ *
+ * unpark() leaves a permit which the next park() call consumes, so a wake up sent before the thread blocks is not lost, and several unpark() calls
+ * before a park() count as one. park() first spins for a short time, as a wake up coming a few microseconds later is common between jobs, and then
+ * blocks on a futex in Linux (one atomic operation and one syscall on each side) or on a condition variable elsewhere.
+ */
+class Parker
+{
+public:
+	explicit Parker(Clock::Duration spin = OLAGARRO_PARK_SPIN_NANOSECONDS);
+
+	//! Blocks until there is a permit and consumes it. Memory operations done before the unpark() which gave the permit are visible afterwards
+	void park();
+
+	//! Gives a permit, waking up the parked thread if it is blocked
+	void unpark();
+
+	//! True if there is a permit park() would consume without blocking
+	bool isNotified() const;
+
+	//! How long park() spins before blocking, 0 to block immediately
+	void setSpin(Clock::Duration spin);
+
+private:
+	enum State
+	{
+		Parked = -1,
+		Empty = 0,
+		Notified = 1
+	};
+
+	Parker(const Parker&);
+	Parker& operator = (const Parker&);
+
+	bool tryConsume();
+	void block();
+	void wake();
+
+	Atomic<int> mState;
+	Atomic<long long> mSpin;
+
+#if !defined(__linux__)
+	tthread::mutex mMutex;
+	tthread::condition_variable mCondVariable;
+#endif
+};
+
+}
+
+}
+
+#endif // PARKER_H
@@ -0,0 +1,181 @@
+/*
+Copyright (c) 2014 Inaki Griego
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+		1. The origin of this software must not be misrepresented; you must not
+		claim that you wrote the original software. If you use this software
+		in a product, an acknowledgment in the product documentation would be
+		appreciated but is not required.
+
+		2. Altered source versions must be plainly marked as such, and must not be
+		misrepresented as being the original software.
+
+		3. This notice may not be removed or altered from any source
+		distribution.
+*/
+
+
+#ifndef PARTITIONER_H
+#define PARTITIONER_H
+
+#include <algorithm>
+#include "threadpool.h"
+
+namespace Olagarro
+{
+
+namespace Concurrency
+{
+
+/**
+ * @brief Tells concurrentFor() and concurrentReductorFor() how to divide their range in slices, each one executed by a different job.
+ *
+ * - Static: range is divided in as many equal slices as JobThreads the pool has, but never in slices smaller than the grain size. This is the default one and
+ * the cheapest when every element costs the same.
+ * - FixedGrain: range is divided in slices of exactly grain size elements (last one can be smaller). Useful when the right slice size is known.
+ * - Adaptive: range starts as a single slice which is recursively split in halves, a few times at start and again every time a slice gets stolen by
+ * an idle JobThread, but never below the grain size. It balances skewed workloads where some elements cost much more than others.
+ * - Dynamic: one slice per JobThread of the pool, all of them taking batches of grain size elements from a shared atomic cursor until the range is
+ * exhausted. Balances irregular workloads with a fixed number of jobs, at the cost of an atomic operation per batch.
+ *
+ * With any partitioner, ranges not bigger than the grain size are executed directly by the calling thread, without launching any job.
+ *
+ * \code
+ * // Elements are cheap: don't launch jobs with less than 4096 of them
+ * concurrentFor(v.begin(), v.end(), cheapFunctor, staticPartitioner(4096));
+ *
+ * // Some elements are much more expensive than others
+ * concurrentFor(v.begin(), v.end(), skewedFunctor, adaptivePartitioner(16));
+ *
+ * // Same, handing out batches of 64 elements
+ * concurrentFor(v.begin(), v.end(), skewedFunctor, dynamicPartitioner(64));
+ * \endcode
+ */
+class Partitioner
+{
+public:
+	enum Type
+	{
+		Static,
+		FixedGrain,
+		Adaptive,
+		Dynamic
+	};
+
+	Partitioner(Type type = Static, unsigned grainSize = 1) :
+		mType(type),
+		mGrainSize(std::max(1u, grainSize))
+	{
+	}
+
+	Type type() const
+	{
+		return mType;
+	}
+
+	unsigned grainSize() const
+	{
+		return mGrainSize;
+	}
+
+	/**
+	 * @brief isSerial Returns true if a range of elementNumber elements should be executed by the calling thread
+	 */
+	bool isSerial(unsigned elementNumber) const
+	{
+		return elementNumber <= mGrainSize;
+	}
+
+	/**
+	 * @brief initialSliceNumber Number of slices a range of elementNumber elements is divided in before launching any job
+	 * @param threadNumber JobThreads of the pool running the slices: Static and Dynamic slices are as many as them, more would just find no batch
+	 * left or wait for a JobThread
+	 */
+	unsigned initialSliceNumber(unsigned elementNumber, unsigned threadNumber = HardwareThreadNumber) const
+	{
+		// Whole grains fit in the range, so Static slices are never smaller than the grain; batches or fixed slices also count the last partial one
+		const unsigned WholeGrainNumber = elementNumber / mGrainSize;
+		const unsigned GrainNumber = WholeGrainNumber + (0 != elementNumber % mGrainSize? 1 : 0);
+
+		switch(mType)
+		{
+		case Static:
+			return std::max(1u, std::min(threadNumber, WholeGrainNumber));
+		case Dynamic:
+			return std::max(1u, std::min(threadNumber, GrainNumber));
+		case FixedGrain:
+			return std::max(1u, GrainNumber);
+		default:
+			return 1;
+		}
+	}
+
+	/**
+	 * @brief initialSplitDepth How many times an Adaptive slice can be halved: enough to get two slices per JobThread of the pool running them
+	 */
+	unsigned initialSplitDepth(unsigned threadNumber = HardwareThreadNumber) const
+	{
+		return Adaptive == mType? log2(threadNumber) + 1 : 0;
+	}
+
+	/**
+	 * @brief stealSplitDepth How many extra times an Adaptive slice can be halved once it has been stolen
+	 */
+	unsigned stealSplitDepth() const
+	{
+		return Adaptive == mType? 1 : 0;
+	}
+
+private:
+	static unsigned log2(unsigned value)
+	{
+		unsigned result = 0;
+
+		while(1u < (value >> result))
+		{
+			++ result;
+		}
+
+		return result;
+	}
+
+	Type mType;
+	unsigned mGrainSize;
+};
+
+//! Divides the range in one slice per hardware thread, with slices not smaller than minGrainSize elements
+inline Partitioner staticPartitioner(unsigned minGrainSize = 1)
+{
+	return Partitioner(Partitioner::Static, minGrainSize);
+}
+
+//! Divides the range in slices of grainSize elements
+inline Partitioner fixedGrainPartitioner(unsigned grainSize)
+{
+	return Partitioner(Partitioner::FixedGrain, grainSize);
+}
+
+//! Divides the range recursively on demand, with slices not smaller than minGrainSize elements
+inline Partitioner adaptivePartitioner(unsigned minGrainSize = 1)
+{
+	return Partitioner(Partitioner::Adaptive, minGrainSize);
+}
+
+//! Lets slices take batches of batchSize elements from the range as they go
+inline Partitioner dynamicPartitioner(unsigned batchSize = 1)
+{
+	return Partitioner(Partitioner::Dynamic, batchSize);
+}
+
+}
+
+}
+
+#endif // PARTITIONER_H
@@ -0,0 +1,621 @@
+/*
+Copyright (c) 2014 Inaki Griego
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+		1. The origin of this software must not be misrepresented; you must not
+		claim that you wrote the original software. If you use this software
+		in a product, an acknowledgment in the product documentation would be
+		appreciated but is not required.
+
+		2. Altered source versions must be plainly marked as such, and must not be
+		misrepresented as being the original software.
+
+		3. This notice may not be removed or altered from any source
+		distribution.
+*/
+
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cassert>
+#include "job.h"
+#include "future.h"
+#include "threadpool.h"
+#include "jobexception.h"
+#include "../common/shared.h"
+
+namespace Olagarro
+{
+
+namespace Concurrency
+{
+
+//! How a Pipeline stage processes tokens
+enum StageMode
+{
+	//! One token at a time, in the order the source produced them
+	SerialInOrderStage,
+	//! Any number of tokens at the same time, in any order
+	ParallelStage
+};
+
+/**
+ * @brief Pipeline's source stage: fills tokens until the stream ends
+ */
+template<typename Token>
+class PipelineSource
+{
+public:
+	virtual ~PipelineSource() {}
+
+	//! Returns false if the stream has ended, then token is not used
+	virtual bool produce(Token& token) = 0;
+};
+
+template<typename Token, typename Source>
+class PipelineSourceFunctor : public PipelineSource<Token>
+{
+public:
+	explicit PipelineSourceFunctor(const Source& source) :
+		mSource(source)
+	{
+	}
+
+	bool produce(Token& token)
+	{
+		return mSource(token);
+	}
+
+private:
+	Source mSource;
+};
+
+/**
+ * @brief A Pipeline stage after the source
+ */
+template<typename Token>
+class PipelineStage
+{
+public:
+	explicit PipelineStage(StageMode mode) :
+		mMode(mode)
+	{
+	}
+
+	virtual ~PipelineStage() {}
+
+	virtual void process(Token& token) = 0;
+
+	StageMode mode() const
+	{
+		return mMode;
+	}
+
+private:
+	StageMode mMode;
+};
+
+template<typename Token, typename Stage>
+class PipelineStageFunctor : public PipelineStage<Token>
+{
+public:
+	PipelineStageFunctor(StageMode mode, const Stage& stage) :
+		PipelineStage<Token>(mode),
+		mStage(stage)
+	{
+	}
+
+	void process(Token& token)
+	{
+		mStage(token);
+	}
+
+private:
+	Stage mStage;
+};
+
+/**
+ * @brief State of a running Pipeline, shared by its jobs.
+ *
+ * Tokens live in maxTokens slots, created once and reused, and the source only runs when a slot is free, so there are never more than maxTokens
+ * tokens in flight: that is the pipeline's backpressure. Every serial stage keeps the tokens which arrive before their turn in a queue ordered by
+ * sequence number, bounded by maxTokens too. A job carries its token through as many stages as it can; when its token has to wait in a serial
+ * stage's queue the job ends, and the job which finishes the previous token in that stage launches a job to resume it. A job whose token leaves the
+ * pipeline becomes the source if it is idle, so in steady state tokens are produced and consumed without enqueueing jobs.
+ */
+template<typename Token>
+class PipelineRun
+{
+public:
+	typedef std::vector< Shared<PipelineStage<Token>, AtomicMTPolicy> > StageList;
+
+	//! Slot index meaning "no token yet": the job has to produce one first
+	static const std::size_t NoSlot = ~static_cast<std::size_t>(0);
+
+	PipelineRun(const Shared<PipelineSource<Token>, AtomicMTPolicy>& source, const StageList& stages, std::size_t maxTokens) :
+		mSource(source),
+		mStages(stages),
+		mTokens(maxTokens),
+		mSequences(maxTokens, 0),
+		mSerialStages(stages.size()),
+		mNextSequence(0),
+		mSourceRunning(false),
+		mSourceDone(false),
+		mStopped(false),
+		mRunningJobNumber(0)
+	{
+		for(std::size_t i = 0; i < maxTokens; ++ i)
+		{
+			mFreeSlots.push_back(maxTokens - 1 - i);
+		}
+	}
+
+	/**
+	 * @brief executeJob Body of the pipeline's jobs: produces a token if slot is NoSlot and carries it through the stages from stage on
+	 * @param claimed The token already has its turn in stage, which is serial
+	 */
+	void executeJob(std::size_t slot, std::size_t stage, bool claimed)
+	{
+		if(NoSlot != slot || produce(slot))
+		{
+			// Every time our token leaves the pipeline we try to produce another one
+			while(process(slot, stage, claimed) && finish(slot) && produce(slot))
+			{
+				stage = 0;
+				claimed = false;
+			}
+		}
+
+		// Last thing to do: after that the pipeline can be destroyed at any time
+		jobDone();
+	}
+
+	//! Counts a job which is about to be launched
+	void addJob()
+	{
+		tthread::lock_guard<tthread::mutex> guard(mMutex);
+
+		++ mRunningJobNumber;
+	}
+
+	bool isDone() const
+	{
+		tthread::lock_guard<tthread::mutex> guard(mMutex);
+
+		return 0 == mRunningJobNumber;
+	}
+
+	/**
+	 * @brief wait Blocks until every job is done, executing pending jobs meanwhile if calling thread is a JobThread
+	 */
+	void wait() const
+	{
+		while(!isDone() && ThreadPool::executePendingJob())
+		{
+		}
+
+		tthread::lock_guard<tthread::mutex> guard(mMutex);
+
+		while(0 != mRunningJobNumber)
+		{
+			mCondVariable.wait(mMutex);
+		}
+	}
+
+	//! Exception thrown by the first stage which failed, if any. Only meaningful once the pipeline is done
+	const ExceptionHolder& failure() const
+	{
+		return mFailure;
+	}
+
+private:
+	struct SerialStage
+	{
+		SerialStage() :
+			busy(false),
+			nextSequence(0)
+		{
+		}
+
+		bool busy;
+		unsigned long long nextSequence;
+		// Tokens waiting for their turn: sequence number -> slot
+		std::map<unsigned long long, std::size_t> waiting;
+	};
+
+	// Returns false if there is no token to produce now (source busy, no free slot or stream ended)
+	bool produce(std::size_t& slot)
+	{
+		checkCancellation();
+
+		{
+			tthread::lock_guard<tthread::mutex> guard(mMutex);
+
+			if(mSourceRunning || mSourceDone || mStopped || mFreeSlots.empty())
+			{
+				return false;
+			}
+
+			mSourceRunning = true;
+			slot = mFreeSlots.back();
+			mFreeSlots.pop_back();
+		}
+
+		bool produced = false;
+
+		try
+		{
+			produced = mSource->produce(mTokens[slot]);
+		}
+		catch(...)
+		{
+			fail();
+		}
+
+		bool moreSlots = false;
+
+		{
+			tthread::lock_guard<tthread::mutex> guard(mMutex);
+
+			mSourceRunning = false;
+
+			if(!produced || mStopped)
+			{
+				mSourceDone = true;
+				mFreeSlots.push_back(slot);
+				return false;
+			}
+
+			// Only the source gives sequence numbers, so they have no gaps
+			mSequences[slot] = mNextSequence ++;
+
+			moreSlots = !mFreeSlots.empty();
+
+			if(moreSlots)
+			{
+				++ mRunningJobNumber;
+			}
+		}
+
+		// Another job produces the next token while we carry this one
+		if(moreSlots)
+		{
+			ThreadPool::current().enqueueJob(Shared<Job, AtomicMTPolicy>(newJob(NoSlot, 0, false)));
+		}
+
+		return true;
+	}
+
+	// Returns false if the token has been left waiting in a serial stage
+	bool process(std::size_t slot, std::size_t stage, bool claimed)
+	{
+		for(; stage < mStages.size(); ++ stage, claimed = false)
+		{
+			const bool Serial = SerialInOrderStage == mStages[stage]->mode();
+			SerialStage& serialStage = mSerialStages[stage];
+
+			if(Serial && !claimed)
+			{
+				tthread::lock_guard<tthread::mutex> guard(mMutex);
+
+				if(serialStage.busy || serialStage.nextSequence != mSequences[slot])
+				{
+					serialStage.waiting[mSequences[slot]] = slot;
+					return false;
+				}
+
+				serialStage.busy = true;
+			}
+
+			// Once stopped tokens still go through the stages, so serial ones see every sequence number, but they are not processed
+			if(!isStopped())
+			{
+				try
+				{
+					mStages[stage]->process(mTokens[slot]);
+				}
+				catch(...)
+				{
+					fail();
+				}
+			}
+
+			if(Serial)
+			{
+				releaseSerialStage(stage);
+			}
+		}
+
+		return true;
+	}
+
+	// Gives the turn in a serial stage to the next token, resuming it in a new job if it was waiting
+	void releaseSerialStage(std::size_t stage)
+	{
+		SerialStage& serialStage = mSerialStages[stage];
+		std::size_t successor = NoSlot;
+
+		{
+			tthread::lock_guard<tthread::mutex> guard(mMutex);
+
+			++ serialStage.nextSequence;
+
+			typename std::map<unsigned long long, std::size_t>::iterator next = serialStage.waiting.find(serialStage.nextSequence);
+
+			if(serialStage.waiting.end() == next)
+			{
+				serialStage.busy = false;
+				return;
+			}
+
+			successor = next->second;
+			serialStage.waiting.erase(next);
+			++ mRunningJobNumber;
+		}
+
+		ThreadPool::current().enqueueJob(Shared<Job, AtomicMTPolicy>(newJob(successor, stage, true)));
+	}
+
+	// Frees the slot of a token which left the pipeline. Always true, so it can be chained in executeJob()'s loop
+	bool finish(std::size_t slot)
+	{
+		tthread::lock_guard<tthread::mutex> guard(mMutex);
+
+		mFreeSlots.push_back(slot);
+
+		return true;
+	}
+
+	void jobDone()
+	{
+		tthread::lock_guard<tthread::mutex> guard(mMutex);
+
+		if(0 == -- mRunningJobNumber)
+		{
+			mCondVariable.notify_all();
+		}
+	}
+
+	// Called from a catch block: keeps the first exception and stops the pipeline
+	void fail()
+	{
+		tthread::lock_guard<tthread::mutex> guard(mMutex);
+
+		if(mFailure.empty())
+		{
+			mFailure.capture();
+		}
+
+		mStopped = true;
+	}
+
+	void stop()
+	{
+		tthread::lock_guard<tthread::mutex> guard(mMutex);
+
+		mStopped = true;
+	}
+
+	bool isStopped()
+	{
+		checkCancellation();
+
+		tthread::lock_guard<tthread::mutex> guard(mMutex);
+
+		return mStopped;
+	}
+
+	// Checked for every token and stage, as a job can keep producing and carrying tokens for the whole run. Jobs run with the pipeline's token
+	void checkCancellation()
+	{
+		if(CancellationToken::current().isCancelled())
+		{
+			stop();
+		}
+	}
+
+	Job* newJob(std::size_t slot, std::size_t stage, bool claimed);
+
+	Shared<PipelineSource<Token>, AtomicMTPolicy> mSource;
+	StageList mStages;
+	std::vector<Token> mTokens;
+	std::vector<unsigned long long> mSequences;
+	std::vector<SerialStage> mSerialStages;
+	std::vector<std::size_t> mFreeSlots;
+	unsigned long long mNextSequence;
+	bool mSourceRunning;
+	bool mSourceDone;
+	bool mStopped;
+	unsigned mRunningJobNumber;
+	ExceptionHolder mFailure;
+	mutable tthread::mutex mMutex;
+	mutable tthread::condition_variable mCondVariable;
+};
+
+template<typename Token>
+const std::size_t PipelineRun<Token>::NoSlot;
+
+/**
+ * @brief Job carrying a Pipeline token through its stages
+ */
+template<typename Token>
+class PipelineTokenJob : public Job
+{
+public:
+	PipelineTokenJob(PipelineRun<Token>& run, std::size_t slot, std::size_t stage, bool claimed) :
+		mRun(run),
+		mSlot(slot),
+		mStage(stage),
+		mClaimed(claimed)
+	{
+	}
+
+	std::string name() const
+	{
+		return "PipelineTokenJob";
+	}
+
+private:
+	// Cancelled jobs still run: their token has to go through the serial stages, and jobDone() has to be called
+	void executeJob()
+	{
+		mRun.executeJob(mSlot, mStage, mClaimed);
+	}
+
+	PipelineRun<Token>& mRun;
+	std::size_t mSlot;
+	std::size_t mStage;
+	bool mClaimed;
+};
+
+template<typename Token>
+Job* PipelineRun<Token>::newJob(std::size_t slot, std::size_t stage, bool claimed)
+{
+	return new PipelineTokenJob<Token>(*this, slot, stage, claimed);
+}
+
+/**
+ * @brief Job running a whole Pipeline: it produces and carries the first token itself and waits for the rest
+ */
+template<typename Token>
+class PipelineJob : public CallerJob<void>
+{
+public:
+	PipelineJob(const Shared<PipelineSource<Token>, AtomicMTPolicy>& source, const typename PipelineRun<Token>::StageList& stages,
+				std::size_t maxTokens) :
+		CallerJob<void>(),
+		mRun(source, stages, maxTokens)
+	{
+	}
+
+	std::string name() const
+	{
+		return "PipelineJob";
+	}
+
+private:
+	void executeJob()
+	{
+		mRun.addJob();
+
+		Shared<Job, AtomicMTPolicy> first(new PipelineTokenJob<Token>(mRun, PipelineRun<Token>::NoSlot, 0, false));
+		first->execute();
+
+		mRun.wait();
+
+		if(isCancellationRequested())
+		{
+			setCancelled();
+		}
+		else if(!mRun.failure().empty())
+		{
+			setFailed(mRun.failure());
+		}
+		else
+		{
+			setResultCalculated();
+		}
+	}
+
+	void cancelJob()
+	{
+		setCancelled();
+	}
+
+	PipelineRun<Token> mRun;
+};
+
+/**
+ * @brief Streams tokens through a chain of stages, like TBB's parallel_pipeline. A source stage fills tokens until the stream ends and every
+ * following stage processes them either serially, in the order the source produced them, or in parallel:
+ *
+ * \code
+ * struct Chunk { std::vector<char> data; std::size_t size; };
+ *
+ * Future<void> done = Pipeline<Chunk>().source(ReadChunk(input))       // bool operator()(Chunk&), false at the end of input
+ *                                      .stage(ParallelStage, Compress())   // void operator()(Chunk&)
+ *                                      .stage(SerialInOrderStage, WriteChunk(output))
+ *                                      .run(16);
+ * done.result();
+ * \endcode
+ *
+ * At most maxTokens tokens are in flight: when all of them are taken the source waits for one to leave the pipeline, so a slow stage slows down
+ * the source instead of letting tokens pile up (backpressure). Tokens are default constructed once per slot and reused, so buffers inside them keep
+ * their capacity from one use to the next: stages should overwrite everything they read later.
+ *
+ * Stages are copied into the pipeline. The source and serial stages are never called concurrently, so they can keep state (an output file, a
+ * counter...). Parallel stages are called concurrently on the same object.
+ *
+ * The pipeline runs in ThreadPool::current(). If a stage throws, no more tokens are produced, tokens in flight skip the remaining stages and the
+ * future throws the exception. Cancelling the CancellationToken the pipeline was run with stops it the same way.
+ */
+template<typename Token>
+class Pipeline
+{
+public:
+	//! Sets the source stage: a functor with bool operator()(Token&) which returns false when the stream ends
+	template<typename Source>
+	Pipeline& source(const Source& source)
+	{
+		mSource = Shared<PipelineSource<Token>, AtomicMTPolicy>(new PipelineSourceFunctor<Token, Source>(source));
+
+		return *this;
+	}
+
+	//! Appends a stage: a functor with void operator()(Token&)
+	template<typename Stage>
+	Pipeline& stage(StageMode mode, const Stage& stage)
+	{
+		mStages.push_back(Shared<PipelineStage<Token>, AtomicMTPolicy>(new PipelineStageFunctor<Token, Stage>(mode, stage)));
+
+		return *this;
+	}
+
+	// Functions would be deduced as function types by the templates above, which can't be stored
+	Pipeline& source(bool (*function)(Token&))
+	{
+		return source<bool (*)(Token&)>(function);
+	}
+
+	Pipeline& stage(StageMode mode, void (*function)(Token&))
+	{
+		return stage<void (*)(Token&)>(mode, function);
+	}
+
+	/**
+	 * @brief run Launches the pipeline. It must have a source. A Pipeline can be run several times, but runs share the stage objects, so serial
+	 * stages would be called concurrently by overlapping runs
+	 * @param maxTokens Tokens in flight, at least one. Around a couple per JobThread is usually enough to keep them busy
+	 */
+	Future<void> run(std::size_t maxTokens)
+	{
+		assert(!mSource.isNull() && "Pipeline::run(): the pipeline has no source");
+
+		Shared<Job, AtomicMTPolicy> job(new PipelineJob<Token>(mSource, mStages, std::max<std::size_t>(1, maxTokens)));
+
+		ThreadPool::current().enqueueJob(job);
+
+		return Future<void>(job);
+	}
+
+private:
+	Shared<PipelineSource<Token>, AtomicMTPolicy> mSource;
+	typename PipelineRun<Token>::StageList mStages;
+};
+
+}
+
+}
+
+#endif // PIPELINE_H
@@ -0,0 +1,382 @@
+#include "telemetry.h"
+#include "threadpool.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <cstdlib>
+
+#if defined(__GNUC__)
+	#include <cxxabi.h>
+#endif
+
+namespace Olagarro
+{
+
+namespace Concurrency
+{
+
+namespace
+{
+
+// GCC and Clang's typeid names are mangled, MSVC ones are readable already
+std::string demangle(const char* name)
+{
+#if defined(__GNUC__)
+	int status = 0;
+	char* demangled = abi::__cxa_demangle(name, 0, 0, &status);
+
+	if(demangled)
+	{
+		const std::string result(demangled);
+		std::free(demangled);
+		return result;
+	}
+#endif
+
+	return name;
+}
+
+double microseconds(Clock::Duration duration)
+{
+	return duration / 1000.0;
+}
+
+}
+
+LatencyHistogram::LatencyHistogram() :
+	total(0),
+	maximum(0)
+{
+	std::fill(buckets, buckets + BucketNumber, 0ull);
+}
+
+unsigned LatencyHistogram::bucketOf(Clock::Duration duration)
+{
+	unsigned bits = FirstBucketBits;
+
+	while(bits < FirstBucketBits + BucketNumber && 0 != (static_cast<unsigned long long>(std::max(0ll, duration)) >> bits))
+	{
+		++ bits;
+	}
+
+	return std::min<unsigned>(bits - FirstBucketBits, BucketNumber - 1);
+}
+
+Clock::Duration LatencyHistogram::bucketLimit(unsigned bucket)
+{
+	if(BucketNumber - 1 <= bucket)
+	{
+		return static_cast<Clock::Duration>(~0ull >> 1);
+	}
+
+	return (1ll << (FirstBucketBits + bucket)) - 1;
+}
+
+void LatencyHistogram::add(const LatencyHistogram& other)
+{
+	for(unsigned i = 0; i < BucketNumber; ++ i)
+	{
+		buckets[i] += other.buckets[i];
+	}
+
+	total += other.total;
+	maximum = std::max(maximum, other.maximum);
+}
+
+unsigned long long LatencyHistogram::count() const
+{
+	unsigned long long result = 0;
+
+	for(unsigned i = 0; i < BucketNumber; ++ i)
+	{
+		result += buckets[i];
+	}
+
+	return result;
+}
+
+Clock::Duration LatencyHistogram::mean() const
+{
+	const unsigned long long Count = count();
+
+	return 0 == Count? 0 : static_cast<Clock::Duration>(total / Count);
+}
+
+Clock::Duration LatencyHistogram::percentile(double fraction) const
+{
+	const unsigned long long Count = count();
+	const unsigned long long Target = std::max(1ull, static_cast<unsigned long long>(fraction * Count + 0.5));
+	unsigned long long accumulated = 0;
+
+	for(unsigned i = 0; i < BucketNumber; ++ i)
+	{
+		accumulated += buckets[i];
+
+		if(accumulated >= Target)
+		{
+			return std::min(bucketLimit(i), maximum);
+		}
+	}
+
+	return maximum;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+
+JobThreadTelemetry::JobThreadTelemetry() :
+	executedJobs(0),
+	wakeUps(0),
+	busyTime(0),
+	idleTime(0)
+{
+}
+
+double JobThreadTelemetry::utilization() const
+{
+	const Clock::Duration Time = busyTime + idleTime;
+
+	return 0 == Time? 0.0 : static_cast<double>(busyTime) / Time;
+}
+
+ThreadPoolTelemetry::ThreadPoolTelemetry() :
+	time(0),
+	uptime(0),
+	enqueuedJobs(0),
+	startedJobs(0),
+	pendingJobs(0)
+{
+}
+
+void ThreadPoolTelemetry::dump(std::ostream& stream) const
+{
+	const std::ios_base::fmtflags Flags = stream.flags();
+	const std::streamsize Precision = stream.precision();
+
+	stream << std::fixed << std::setprecision(1);
+	stream << "ThreadPool telemetry, uptime " << uptime / 1000000000.0 << " s: " << enqueuedJobs << " jobs enqueued, " << startedJobs
+		   << " started, " << pendingJobs << " pending\n";
+
+	stream << std::setw(10) << "JobThread" << std::setw(12) << "jobs" << std::setw(10) << "wake ups" << std::setw(12) << "busy (ms)"
+		   << std::setw(12) << "idle (ms)" << std::setw(13) << "utilization" << "\n";
+
+	for(std::size_t i = 0; i < jobThreads.size(); ++ i)
+	{
+		const JobThreadTelemetry& thread = jobThreads[i];
+
+		stream << std::setw(10) << i << std::setw(12) << thread.executedJobs << std::setw(10) << thread.wakeUps
+			   << std::setw(12) << thread.busyTime / 1000000.0 << std::setw(12) << thread.idleTime / 1000000.0
+			   << std::setw(12) << thread.utilization() * 100.0 << "%\n";
+	}
+
+	stream << std::setw(10) << "jobs" << std::setw(30) << "queue p50 / p99 / max (us)" << std::setw(36) << "execution p50 / p99 / max (us)"
+		   << std::setw(12) << "total (ms)" << "   type\n";
+
+	for(std::size_t i = 0; i < jobTypes.size(); ++ i)
+	{
+		const LatencyHistogram& queue = jobTypes[i].queueTime;
+		const LatencyHistogram& execution = jobTypes[i].executionTime;
+
+		stream << std::setw(10) << execution.count()
+			   << std::setw(12) << microseconds(queue.percentile(0.5)) << std::setw(9) << microseconds(queue.percentile(0.99))
+			   << std::setw(9) << microseconds(queue.maximum)
+			   << std::setw(18) << microseconds(execution.percentile(0.5)) << std::setw(9) << microseconds(execution.percentile(0.99))
+			   << std::setw(9) << microseconds(execution.maximum)
+			   << std::setw(12) << execution.total / 1000000.0 << "   " << jobTypes[i].name << "\n";
+	}
+
+	stream.flags(Flags);
+	stream.precision(Precision);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+
+void TelemetryRecorder::Histogram::add(Clock::Duration duration)
+{
+	increase(buckets[LatencyHistogram::bucketOf(duration)], 1);
+	increase(total, static_cast<unsigned long long>(std::max(0ll, duration)));
+
+	if(duration > maximum.load(MemoryOrderRelaxed))
+	{
+		maximum.store(duration, MemoryOrderRelaxed);
+	}
+}
+
+void TelemetryRecorder::Histogram::collect(LatencyHistogram& histogram) const
+{
+	for(unsigned i = 0; i < LatencyHistogram::BucketNumber; ++ i)
+	{
+		histogram.buckets[i] += buckets[i].load(MemoryOrderRelaxed);
+	}
+
+	histogram.total += total.load(MemoryOrderRelaxed);
+	histogram.maximum = std::max(histogram.maximum, static_cast<Clock::Duration>(maximum.load(MemoryOrderRelaxed)));
+}
+
+TelemetryRecorder::TelemetryRecorder() :
+	mEnqueuedJobs(0),
+	mStartedJobs(0),
+	mWakeUps(0),
+	mBusyTime(0),
+	mLastJobType(0)
+{
+}
+
+void TelemetryRecorder::countEnqueue()
+{
+	increase(mEnqueuedJobs, 1);
+}
+
+void TelemetryRecorder::countStart()
+{
+	increase(mStartedJobs, 1);
+}
+
+void TelemetryRecorder::countWakeUp()
+{
+	increase(mWakeUps, 1);
+}
+
+void TelemetryRecorder::addBusyTime(Clock::Duration time)
+{
+	increase(mBusyTime, static_cast<unsigned long long>(std::max(0ll, time)));
+}
+
+void TelemetryRecorder::recordJob(const char* typeName, Clock::Duration queueTime, Clock::Duration executionTime)
+{
+	JobTypeRecord& record = jobTypeRecord(typeName);
+
+	record.queueTime.add(queueTime);
+	record.executionTime.add(executionTime);
+}
+
+void TelemetryRecorder::collect(ThreadPoolTelemetry& telemetry, JobThreadTelemetry& thread, std::map<std::string, JobTypeTelemetry>& jobTypes) const
+{
+	telemetry.enqueuedJobs += mEnqueuedJobs.load(MemoryOrderRelaxed);
+	telemetry.startedJobs += mStartedJobs.load(MemoryOrderRelaxed);
+
+	thread.executedJobs = mStartedJobs.load(MemoryOrderRelaxed);
+	thread.wakeUps = mWakeUps.load(MemoryOrderRelaxed);
+	thread.busyTime = static_cast<Clock::Duration>(mBusyTime.load(MemoryOrderRelaxed));
+	thread.idleTime = std::max(0ll, telemetry.uptime - thread.busyTime);
+
+	for(unsigned i = 0; i < JobTypeCapacity; ++ i)
+	{
+		const char* typeName = mJobTypes[i].typeName.load(MemoryOrderAcquire);
+
+		if(!typeName)
+		{
+			continue;
+		}
+
+		const std::string Name = JobTypeCapacity - 1 == i? std::string(typeName) : demangle(typeName);
+		JobTypeTelemetry& jobType = jobTypes[Name];
+
+		jobType.name = Name;
+		mJobTypes[i].queueTime.collect(jobType.queueTime);
+		mJobTypes[i].executionTime.collect(jobType.executionTime);
+	}
+}
+
+void TelemetryRecorder::increase(Atomic<unsigned long long>& counter, unsigned long long value)
+{
+	counter.store(counter.load(MemoryOrderRelaxed) + value, MemoryOrderRelaxed);
+}
+
+TelemetryRecorder::JobTypeRecord& TelemetryRecorder::jobTypeRecord(const char* typeName)
+{
+	if(mLastJobType && typeName == mLastJobType->typeName.load(MemoryOrderRelaxed))
+	{
+		return *mLastJobType;
+	}
+
+	// Linear probing over every entry but the last one, which is kept for the types which do not fit
+	const std::size_t Hash = reinterpret_cast<std::size_t>(typeName) >> 3;
+
+	for(unsigned i = 0; i < JobTypeCapacity - 1; ++ i)
+	{
+		JobTypeRecord& record = mJobTypes[(Hash + i) % (JobTypeCapacity - 1)];
+		const char* recordTypeName = record.typeName.load(MemoryOrderRelaxed);
+
+		if(!recordTypeName)
+		{
+			record.typeName.store(typeName, MemoryOrderRelease);
+		}
+
+		if(!recordTypeName || typeName == recordTypeName)
+		{
+			mLastJobType = &record;
+			return record;
+		}
+	}
+
+	mLastJobType = &mJobTypes[JobTypeCapacity - 1];
+
+	if(!mLastJobType->typeName.load(MemoryOrderRelaxed))
+	{
+		mLastJobType->typeName.store("Other jobs", MemoryOrderRelease);
+	}
+
+	return *mLastJobType;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+
+TelemetryDumper::TelemetryDumper(ThreadPool& pool, std::ostream& stream, Clock::Duration period) :
+	mPool(pool),
+	mStream(stream),
+	mPeriod(std::max(1ll, period)),
+	mFinish(false),
+	mThread(dumpLoop, this)
+{
+}
+
+TelemetryDumper::~TelemetryDumper()
+{
+	{
+		tthread::lock_guard<tthread::mutex> guard(mMutex);
+
+		mFinish = true;
+		mCondVariable.notify_all();
+	}
+
+	mThread.join();
+}
+
+void TelemetryDumper::dumpLoop(void* param)
+{
+	TelemetryDumper& dumper = *static_cast<TelemetryDumper*>(param);
+	Clock::TimePoint next = Clock::now() + dumper.mPeriod;
+
+	tthread::lock_guard<tthread::mutex> guard(dumper.mMutex);
+
+	while(true)
+	{
+		for(Clock::TimePoint now = Clock::now(); !dumper.mFinish && now < next; now = Clock::now())
+		{
+			dumper.mCondVariable.timed_wait(dumper.mMutex, (next - now) / 1000 + 1);
+		}
+
+		if(dumper.mFinish)
+		{
+			break;
+		}
+
+		dumper.mPool.telemetry().dump(dumper.mStream);
+		dumper.mStream.flush();
+
+		next += dumper.mPeriod;
+	}
+}
+
+}
+
+}
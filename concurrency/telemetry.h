@@ -0,0 +1,224 @@
+/*
+Copyright (c) 2014 Inaki Griego
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+		1. The origin of this software must not be misrepresented; you must not
+		claim that you wrote the original software. If you use this software
+		in a product, an acknowledgment in the product documentation would be
+		appreciated but is not required.
+
+		2. Altered source versions must be plainly marked as such, and must not be
+		misrepresented as being the original software.
+
+		3. This notice may not be removed or altered from any source
+		distribution.
+*/
+
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <ostream>
+#include "atomic.h"
+#include "clock.h"
+#include "tinythread/tinythread.h"
+
+namespace Olagarro
+{
+
+namespace Concurrency
+{
+
+class ThreadPool;
+
+/**
+ * @brief Histogram of durations with logarithmic buckets: bucket 0 counts durations shorter than 2^FirstBucketBits nanoseconds (128 ns), bucket i
+ * the ones from 2^(FirstBucketBits + i - 1) to 2^(FirstBucketBits + i) nanoseconds and the last one also every longer duration. Percentiles are
+ * therefore approximate, within a factor 2
+ */
+struct LatencyHistogram
+{
+	enum
+	{
+		BucketNumber = 32,
+		FirstBucketBits = 7
+	};
+
+	LatencyHistogram();
+
+	static unsigned bucketOf(Clock::Duration duration);
+
+	//! Longest duration counted in bucket, in nanoseconds
+	static Clock::Duration bucketLimit(unsigned bucket);
+
+	void add(const LatencyHistogram& other);
+
+	unsigned long long count() const;
+	Clock::Duration mean() const;
+
+	/**
+	 * @brief percentile Approximate duration under which the given fraction of the durations are: 0.5 for the median, 0.99 for the 99th
+	 * percentile... It is the limit of the bucket where that fraction is reached, but never more than maximum
+	 */
+	Clock::Duration percentile(double fraction) const;
+
+	unsigned long long buckets[BucketNumber];
+	//! Sum of all the durations, in nanoseconds
+	unsigned long long total;
+	Clock::Duration maximum;
+};
+
+//! Queue and execution times of the jobs of a type (see Job::typeName())
+struct JobTypeTelemetry
+{
+	std::string name;
+	//! From enqueueing a job to a JobThread starting it
+	LatencyHistogram queueTime;
+	LatencyHistogram executionTime;
+};
+
+struct JobThreadTelemetry
+{
+	JobThreadTelemetry();
+
+	//! Fraction of the time the JobThread has been executing jobs
+	double utilization() const;
+
+	unsigned long long executedJobs;
+	//! Times the JobThread has been woken up after running out of work
+	unsigned long long wakeUps;
+	//! Time executing jobs, in nanoseconds
+	Clock::Duration busyTime;
+	//! Time searching for jobs or parked, in nanoseconds
+	Clock::Duration idleTime;
+};
+
+/**
+ * @brief Snapshot of a ThreadPool's counters, taken by ThreadPool::telemetry(). Counters are read one by one while JobThreads keep updating them,
+ * so they can be slightly inconsistent with each other (a job can be counted as executed before its execution time is)
+ */
+struct ThreadPoolTelemetry
+{
+	ThreadPoolTelemetry();
+
+	//! Writes the snapshot as a human readable text table
+	void dump(std::ostream& stream) const;
+
+	//! When the snapshot was taken
+	Clock::TimePoint time;
+	//! Time since the pool was created, in nanoseconds
+	Clock::Duration uptime;
+	unsigned long long enqueuedJobs;
+	//! Jobs started by the JobThreads, finished or not
+	unsigned long long startedJobs;
+	//! Jobs waiting in the queues: enqueued but not started yet
+	unsigned long long pendingJobs;
+	std::vector<JobThreadTelemetry> jobThreads;
+	//! Sorted by total execution time, longest first
+	std::vector<JobTypeTelemetry> jobTypes;
+};
+
+/**
+ * @brief Telemetry counters of a JobThread. Only its JobThread updates them, so instead of read-modify-write operations it uses relaxed loads and
+ * stores, which cost the same as plain ones, and any thread can read them at any moment.
+ *
+ * Histograms are kept per job type in a small open addressing table indexed by Job::typeName() pointers. When it is full, jobs of new types are
+ * counted together in its last entry.
+ */
+class TelemetryRecorder
+{
+public:
+	enum { JobTypeCapacity = 64 };
+
+	TelemetryRecorder();
+
+	void countEnqueue();
+	void countStart();
+	void countWakeUp();
+	void addBusyTime(Clock::Duration time);
+	void recordJob(const char* typeName, Clock::Duration queueTime, Clock::Duration executionTime);
+
+	/**
+	 * @brief collect Adds recorder's counters to the ones of a snapshot
+	 * @param jobTypes Job type histograms, by demangled type name
+	 */
+	void collect(ThreadPoolTelemetry& telemetry, JobThreadTelemetry& thread, std::map<std::string, JobTypeTelemetry>& jobTypes) const;
+
+private:
+	struct Histogram
+	{
+		void add(Clock::Duration duration);
+		void collect(LatencyHistogram& histogram) const;
+
+		Atomic<unsigned long long> buckets[LatencyHistogram::BucketNumber];
+		Atomic<unsigned long long> total;
+		Atomic<long long> maximum;
+	};
+
+	struct JobTypeRecord
+	{
+		// 0 while the entry is free. Written last when an entry is taken, so readers never see a type with somebody else's counts
+		Atomic<const char*> typeName;
+		Histogram queueTime;
+		Histogram executionTime;
+	};
+
+	TelemetryRecorder(const TelemetryRecorder&);
+	TelemetryRecorder& operator = (const TelemetryRecorder&);
+
+	static void increase(Atomic<unsigned long long>& counter, unsigned long long value);
+
+	JobTypeRecord& jobTypeRecord(const char* typeName);
+
+	Atomic<unsigned long long> mEnqueuedJobs;
+	Atomic<unsigned long long> mStartedJobs;
+	Atomic<unsigned long long> mWakeUps;
+	Atomic<unsigned long long> mBusyTime;
+	JobTypeRecord mJobTypes[JobTypeCapacity];
+	// Most jobs are of the same type as the previous one
+	JobTypeRecord* mLastJobType;
+};
+
+/**
+ * @brief Writes the telemetry of a pool to a stream every period, from a thread of its own, while the object lives:
+ *
+ * \code
+ * TelemetryDumper dumper(ThreadPool::instance(), std::clog, 10000000000ll); // Every 10 seconds
+ * \endcode
+ */
+class TelemetryDumper
+{
+public:
+	TelemetryDumper(ThreadPool& pool, std::ostream& stream, Clock::Duration period);
+	~TelemetryDumper();
+
+private:
+	TelemetryDumper(const TelemetryDumper&);
+	TelemetryDumper& operator = (const TelemetryDumper&);
+
+	static void dumpLoop(void* param);
+
+	ThreadPool& mPool;
+	std::ostream& mStream;
+	Clock::Duration mPeriod;
+	tthread::mutex mMutex;
+	tthread::condition_variable mCondVariable;
+	bool mFinish;
+	tthread::thread mThread;
+};
+
+}
+
+}
+
+#endif // TELEMETRY_H
@@ -27,6 +27,7 @@ freely, subject to the following restrictions:
 #include <string>
 #include "tinythread/tinythread.h"
 #include "../common/shared.h"
+#include "atomic.h"
 
 #include <iostream>
 
@@ -46,7 +47,7 @@ class Thread
 public:
 	Thread(const std::string& name) :
 		mName(name),
-		mRunning(false)
+		mRunning(0)
 	{
 	}
 
@@ -76,9 +77,9 @@ public:
 #endif
 	}
 
-	bool isRunning()
+	bool isRunning() const
 	{
-		return mRunning;
+		return 0 != mRunning.load(MemoryOrderAcquire);
 	}
 
 	void join()
@@ -102,16 +103,16 @@ private:
 	{
 		Thread<HostClass>* instance = reinterpret_cast<Thread<HostClass>*>(param);
 
-		instance->mRunning = true;
+		instance->mRunning.store(1, MemoryOrderRelease);
 
 		instance->run();
 
-		instance->mRunning = false;
+		instance->mRunning.store(0, MemoryOrderRelease);
 	}
 
 	Shared<tthread::thread> mTThread;
 	std::string mName;
-	bool mRunning;
+	Atomic<int> mRunning;
 };
 
 }
@@ -0,0 +1,37 @@
+#include "threadexithook.h"
+
+namespace Olagarro
+{
+
+namespace Concurrency
+{
+
+ThreadExitHook::ThreadExitHook(Callback callback)
+{
+#if defined(_TTHREAD_WIN32_)
+	mIndex = FlsAlloc(callback);
+	mCreated = FLS_OUT_OF_INDEXES != mIndex;
+#else
+	mCreated = 0 == pthread_key_create(&mKey, callback);
+#endif
+}
+
+void ThreadExitHook::watchCallingThread(void* value)
+{
+	// Hooks used by other static initializers, before their constructor runs, find mCreated zero initialized
+	if(!mCreated)
+	{
+		return;
+	}
+
+	// The callback is only called for threads with a non null value
+#if defined(_TTHREAD_WIN32_)
+	FlsSetValue(mIndex, value);
+#else
+	pthread_setspecific(mKey, value);
+#endif
+}
+
+}
+
+}
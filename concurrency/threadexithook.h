@@ -0,0 +1,80 @@
+/*
+Copyright (c) 2014 Inaki Griego
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+		1. The origin of this software must not be misrepresented; you must not
+		claim that you wrote the original software. If you use this software
+		in a product, an acknowledgment in the product documentation would be
+		appreciated but is not required.
+
+		2. Altered source versions must be plainly marked as such, and must not be
+		misrepresented as being the original software.
+
+		3. This notice may not be removed or altered from any source
+		distribution.
+*/
+
+
+
+#ifndef THREADEXITHOOK_H
+#define THREADEXITHOOK_H
+
+#include "tinythread/tinythread.h"
+
+//! Calling convention of ThreadExitHook callbacks, Windows calls them as fiber local storage callbacks
+#if defined(_TTHREAD_WIN32_)
+	#define OLAGARRO_THREAD_EXIT_CALLBACK WINAPI
+#else
+	#define OLAGARRO_THREAD_EXIT_CALLBACK
+#endif
+
+namespace Olagarro
+{
+
+namespace Concurrency
+{
+
+/**
+ * @brief Calls a function when a thread which asked for it finishes: a pthread key destructor, or a fiber local storage callback on Windows. Thread
+ * local storage of C++ 2003 compilers only accepts plain types, so there is no thread local object whose destructor could do it.
+ *
+ * Hooks are meant to be static objects which are never destroyed before the threads they watch. Threads which are still running when the process
+ * exits are not notified.
+ */
+class ThreadExitHook
+{
+public:
+	typedef void (OLAGARRO_THREAD_EXIT_CALLBACK *Callback)(void* value);
+
+	explicit ThreadExitHook(Callback callback);
+
+	/**
+	 * @brief watchCallingThread Makes callback be called with value once calling thread finishes. A later call replaces value, a null value stops
+	 * watching the thread
+	 */
+	void watchCallingThread(void* value);
+
+private:
+	ThreadExitHook(const ThreadExitHook&);
+	ThreadExitHook& operator = (const ThreadExitHook&);
+
+#if defined(_TTHREAD_WIN32_)
+	DWORD mIndex;
+#else
+	pthread_key_t mKey;
+#endif
+	bool mCreated;
+};
+
+}
+
+}
+
+#endif // THREADEXITHOOK_H
@@ -1,8 +1,19 @@
 #include "threadpool.h"
 #include "job.h"
+#include "joballocator.h"
 
+#include <algorithm>
 #include <iostream>
 #include <typeinfo>
+#include <map>
+#include <sstream>
+
+#if defined(_TTHREAD_WIN32_)
+	#include <windows.h>
+#elif defined(__linux__)
+	#include <pthread.h>
+	#include <sched.h>
+#endif
 
 extern tthread::mutex logMutex;
 
@@ -12,20 +23,135 @@ namespace Olagarro
 namespace Concurrency
 {
 
-static const int HardwareThreadMultFactor = 2;
+namespace
+{
+
+// Only Linux and Windows are supported, elsewhere threads are left to the system scheduler
+void pinCurrentThread(const std::vector<unsigned>& cpus)
+{
+#if defined(_TTHREAD_WIN32_)
+	DWORD_PTR mask = 0;
+
+	for(std::size_t i = 0; i < cpus.size(); ++ i)
+	{
+		if(cpus[i] < sizeof(DWORD_PTR) * 8)
+		{
+			mask |= DWORD_PTR(1) << cpus[i];
+		}
+	}
+
+	if(0 != mask)
+	{
+		SetThreadAffinityMask(GetCurrentThread(), mask);
+	}
+#elif defined(__linux__)
+	cpu_set_t cpuSet;
+	CPU_ZERO(&cpuSet);
+
+	for(std::size_t i = 0; i < cpus.size(); ++ i)
+	{
+		if(cpus[i] < CPU_SETSIZE)
+		{
+			CPU_SET(cpus[i], &cpuSet);
+		}
+	}
 
-const unsigned HardwareThreadNumber = tthread::thread::hardware_concurrency();
+	pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet);
+#else
+	(void)cpus;
+#endif
+}
+
+bool longerExecution(const JobTypeTelemetry& first, const JobTypeTelemetry& second)
+{
+	return first.executionTime.total > second.executionTime.total;
+}
+
+}
+
+const unsigned HardwareThreadNumber = std::max(1u, tthread::thread::hardware_concurrency());
+
+thread_local ThreadPool::JobThread* ThreadPool::sCurrentJobThread = 0;
+thread_local ThreadPool* ThreadPool::sScopePool = 0;
+
+ThreadPool::Scope::Scope(ThreadPool& pool) :
+	mPreviousPool(sScopePool)
+{
+	sScopePool = &pool;
+}
+
+ThreadPool::Scope::~Scope()
+{
+	sScopePool = mPreviousPool;
+}
 
 ThreadPool& ThreadPool::instance()
 {
 	static ThreadPool threadPool;
 
-	if(!threadPool.isRunning())
+	return threadPool;
+}
+
+ThreadPool& ThreadPool::current()
+{
+	if(sScopePool)
 	{
-		threadPool.launch();
+		return *sScopePool;
 	}
 
-	return threadPool;
+	if(sCurrentJobThread)
+	{
+		return sCurrentJobThread->pool();
+	}
+
+	return instance();
+}
+
+unsigned ThreadPool::threadNumber() const
+{
+	return static_cast<unsigned>(mJobThreads.size());
+}
+
+unsigned ThreadPool::nodeNumber() const
+{
+	return std::max<unsigned>(1u, static_cast<unsigned>(mNodeJobs.size() / JobPriorityNumber));
+}
+
+void ThreadPool::setParkSpin(Clock::Duration spin)
+{
+	for(std::size_t i = 0; i < mJobThreads.size(); ++ i)
+	{
+		mJobThreads[i]->setParkSpin(spin);
+		mJobThreads[i]->setSearchSpin(spin);
+	}
+}
+
+ThreadPoolTelemetry ThreadPool::telemetry() const
+{
+	ThreadPoolTelemetry result;
+	std::map<std::string, JobTypeTelemetry> jobTypes;
+
+	result.time = Clock::now();
+	result.uptime = static_cast<Clock::Duration>(result.time - mCreationTime);
+	result.enqueuedJobs = mExternalEnqueuedJobs.load(MemoryOrderRelaxed);
+	result.jobThreads.resize(mJobThreads.size());
+
+	for(std::size_t i = 0; i < mJobThreads.size(); ++ i)
+	{
+		mJobThreads[i]->telemetry().collect(result, result.jobThreads[i], jobTypes);
+	}
+
+	// Counters are not read at once, a job enqueued after reading its enqueuer's counter could be already started
+	result.pendingJobs = result.enqueuedJobs > result.startedJobs? result.enqueuedJobs - result.startedJobs : 0;
+
+	for(std::map<std::string, JobTypeTelemetry>::const_iterator i = jobTypes.begin(); i != jobTypes.end(); ++ i)
+	{
+		result.jobTypes.push_back(i->second);
+	}
+
+	std::sort(result.jobTypes.begin(), result.jobTypes.end(), longerExecution);
+
+	return result;
 }
 
 ThreadPool::~ThreadPool()
@@ -35,50 +161,367 @@ ThreadPool::~ThreadPool()
 		mJobThreads[i]->finish();
 	}
 
-	while(0 < mPendingJobs.size())
+	// Jobs left are abandoned instead of just released, otherwise their futures would never be ready. Continuations of abandoned jobs can be
+	// enqueued here meanwhile, so it goes on until every queue is empty
+	Shared<Job, AtomicMTPolicy> job;
+	bool abandoned = true;
+
+	while(abandoned)
 	{
-		mPendingJobs.pop();
-	}
+		abandoned = false;
 
-	finish();
+		for(std::size_t i = 0; i < mJobThreads.size(); ++ i)
+		{
+			while(mJobThreads[i]->localJobs().pop(job))
+			{
+				job->abandon();
+				abandoned = true;
+			}
+		}
+
+		for(unsigned i = 0; i < JobPriorityNumber; ++ i)
+		{
+			while(mPendingJobs[i].pop(job))
+			{
+				job->abandon();
+				abandoned = true;
+			}
+		}
+
+		while(mDeadlineJobs.pop(job))
+		{
+			job->abandon();
+			abandoned = true;
+		}
+
+		for(std::size_t i = 0; i < mNodeJobs.size(); ++ i)
+		{
+			while(mNodeJobs[i]->pop(job))
+			{
+				job->abandon();
+				abandoned = true;
+			}
+		}
+	}
 }
 
-ThreadPool::ThreadPool() :
-	BlockingThread<ThreadPool>("ThreadPool")
+ThreadPool::ThreadPool(unsigned threadNumber, const std::vector<unsigned>& cpus, const NumaTopology& topology) :
+	mIdleThreadNumber(0),
+	mSearchingThreadNumber(0),
+	mCreationTime(Clock::now()),
+	mExternalEnqueuedJobs(0)
 {
-	for(unsigned i = 0; i < HardwareThreadNumber * HardwareThreadMultFactor; ++ i)
+	// HardwareThreadNumber could be still 0 if a pool is created during static initialization
+	threadNumber = std::max(1u, threadNumber);
+	mMaxSearchingThreadNumber = std::max(1, static_cast<int>(threadNumber / 2));
+
+	// Topology node of every JobThread and the CPUs it is pinned to
+	std::vector<std::size_t> topologyNodes(threadNumber, 0);
+	std::vector< std::vector<unsigned> > threadCpus(threadNumber);
+
+	for(unsigned i = 0; i < threadNumber; ++ i)
 	{
-		Shared<JobThread> jobThread(new JobThread());
-		jobThread->launch();
+		if(!cpus.empty())
+		{
+			threadCpus[i].push_back(cpus[i % cpus.size()]);
+			topologyNodes[i] = topology.nodeOfCpu(threadCpus[i].back());
+		}
+		else if(1 < topology.nodeNumber())
+		{
+			topologyNodes[i] = static_cast<std::size_t>(static_cast<unsigned long long>(i) * topology.nodeNumber() / threadNumber);
+			threadCpus[i] = topology.node(topologyNodes[i]).cpus;
+		}
+	}
+
+	// Pool nodes are the topology nodes with some JobThread, numbered in order
+	std::vector<std::size_t> usedTopologyNodes(topologyNodes);
+	std::sort(usedTopologyNodes.begin(), usedTopologyNodes.end());
+	usedTopologyNodes.erase(std::unique(usedTopologyNodes.begin(), usedTopologyNodes.end()), usedTopologyNodes.end());
+
+	for(unsigned i = 0; i < threadNumber; ++ i)
+	{
+		const unsigned node = static_cast<unsigned>(std::lower_bound(usedTopologyNodes.begin(), usedTopologyNodes.end(), topologyNodes[i]) -
+													usedTopologyNodes.begin());
+
+		Shared<JobThread> jobThread(new JobThread(*this, i, threadCpus[i], node));
 		mJobThreads.push_back(jobThread);
 	}
+
+	if(1 < usedTopologyNodes.size())
+	{
+		for(std::size_t i = 0; i < usedTopologyNodes.size() * JobPriorityNumber; ++ i)
+		{
+			mNodeJobs.push_back(Shared<JobQueue>(new JobQueue()));
+		}
+	}
+
+	// Steal from own node's JobThreads first, then from the rest, starting after own index in both cases to spread thieves
+	for(std::size_t i = 0; i < mJobThreads.size(); ++ i)
+	{
+		std::vector<std::size_t> stealOrder;
+
+		for(int sameNode = 1; sameNode >= 0; -- sameNode)
+		{
+			for(std::size_t j = 1; j < mJobThreads.size(); ++ j)
+			{
+				const std::size_t victim = (i + j) % mJobThreads.size();
+
+				if((mJobThreads[victim]->node() == mJobThreads[i]->node()) == (1 == sameNode))
+				{
+					stealOrder.push_back(victim);
+				}
+			}
+		}
+
+		mJobThreads[i]->setStealOrder(stealOrder);
+	}
+
+	mIdleThreadNumber.store(static_cast<int>(mJobThreads.size()));
+
+	// Threads are launched once mJobThreads is complete as they look into other threads' queues
+	for(std::size_t i = 0; i < mJobThreads.size(); ++ i)
+	{
+		mJobThreads[i]->launch();
+	}
+}
+
+void ThreadPool::enqueueJob(Shared<Job, AtomicMTPolicy> job)
+{
+	JobThread* currentThread = sCurrentJobThread;
+
+	OLAGARRO_TRACE_SCOPE("Enqueue");
+	OLAGARRO_TRACE_ENQUEUE(*job);
+	countEnqueue(*job);
+
+	if(Job::NoDeadline != job->deadline())
+	{
+		mDeadlineJobs.push(job, job->deadline());
+	}
+	else if(currentThread && &currentThread->pool() == this && NormalPriority == job->priority())
+	{
+		// Enqueued from a running job: keep it local, idle threads will steal it if needed. Jobs with deadline or other priorities go to their
+		// queues, otherwise they would be executed after other JobThreads' deadlines and high priority jobs or before pending normal priority ones
+		currentThread->localJobs().push(job);
+	}
+	else
+	{
+		mPendingJobs[job->priority()].push(job);
+	}
+
+	wakeIdleThread(currentThread? currentThread->node() : 0);
+}
+
+void ThreadPool::enqueueJob(Shared<Job, AtomicMTPolicy> job, unsigned node)
+{
+	JobThread* currentThread = sCurrentJobThread;
+
+	// Meeting deadlines is more important than memory locality
+	if(mNodeJobs.empty() || Job::NoDeadline != job->deadline() ||
+	   (currentThread && &currentThread->pool() == this && currentThread->node() == node && NormalPriority == job->priority()))
+	{
+		enqueueJob(job);
+		return;
+	}
+
+	node %= nodeNumber();
+
+	OLAGARRO_TRACE_SCOPE("Enqueue");
+	OLAGARRO_TRACE_ENQUEUE(*job);
+	countEnqueue(*job);
+	mNodeJobs[node * JobPriorityNumber + job->priority()]->push(job);
+
+	wakeIdleThread(node);
+}
+
+bool ThreadPool::executePendingJob()
+{
+	JobThread* currentThread = sCurrentJobThread;
+
+	if(!currentThread)
+	{
+		return false;
+	}
+
+	Shared<Job, AtomicMTPolicy> job;
+
+	if(!currentThread->pool().findJob(*currentThread, job))
+	{
+		return false;
+	}
+
+	currentThread->execute(*job);
+
+	return true;
 }
 
-void ThreadPool::performJob()
+bool ThreadPool::findJob(JobThread& thread, Shared<Job, AtomicMTPolicy>& job)
 {
-	std::size_t i = 0;
+	if(!takeJob(thread, job))
+	{
+		return false;
+	}
 
-	tthread::lock_guard<tthread::mutex> guard(mJobQueueMutex);
+	OLAGARRO_TRACE_DEQUEUE(*job);
 
-	while(0 < mPendingJobs.size() && i < mJobThreads.size())
+	return true;
+}
+
+bool ThreadPool::takeJob(JobThread& thread, Shared<Job, AtomicMTPolicy>& job)
+{
+	// Starvation protection: lowest priorities go first from time to time, so they progress even under a constant stream of more urgent jobs
+	if(0 == thread.countSearch() % StarvationInterval)
 	{
-		if(!mJobThreads[i]->isWorking())
+		for(unsigned i = JobPriorityNumber; 0 < i; -- i)
 		{
-			mJobThreads[i]->setJob(mPendingJobs.front());
-			mPendingJobs.pop();
+			if(popQueuedJob(thread, i - 1, job))
+			{
+				return true;
+			}
 		}
+	}
 
-		++ i;
+	if(mDeadlineJobs.pop(job) || popQueuedJob(thread, HighPriority, job))
+	{
+		return true;
 	}
+
+	if(thread.localJobs().pop(job))
+	{
+		return true;
+	}
+
+	if(popQueuedJob(thread, NormalPriority, job))
+	{
+		return true;
+	}
+
+	const std::vector<std::size_t>& stealOrder = thread.stealOrder();
+
+	for(std::size_t i = 0; i < stealOrder.size(); ++ i)
+	{
+		if(mJobThreads[stealOrder[i]]->localJobs().steal(job))
+		{
+			return true;
+		}
+	}
+
+	if(popQueuedJob(thread, BackgroundPriority, job))
+	{
+		return true;
+	}
+
+	// Remote nodes' jobs are the last resort: better to run them far from their memory than to keep a JobThread idle
+	for(unsigned i = 1; i < nodeNumber(); ++ i)
+	{
+		const unsigned node = (thread.node() + i) % nodeNumber();
+
+		for(unsigned priority = 0; priority < JobPriorityNumber; ++ priority)
+		{
+			if(mNodeJobs[node * JobPriorityNumber + priority]->pop(job))
+			{
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+bool ThreadPool::popQueuedJob(JobThread& thread, unsigned priority, Shared<Job, AtomicMTPolicy>& job)
+{
+	if(!mNodeJobs.empty() && mNodeJobs[thread.node() * JobPriorityNumber + priority]->pop(job))
+	{
+		return true;
+	}
+
+	return mPendingJobs[priority].pop(job);
 }
 
-void ThreadPool::enqueueJob(Shared<Job, MutexMTPolicy> job)
+bool ThreadPool::hasPendingJobs()
 {
-	tthread::lock_guard<tthread::mutex> guard(mJobQueueMutex);
+	if(!mDeadlineJobs.empty())
+	{
+		return true;
+	}
 
-	mPendingJobs.push(job);
+	for(unsigned i = 0; i < JobPriorityNumber; ++ i)
+	{
+		if(!mPendingJobs[i].empty())
+		{
+			return true;
+		}
+	}
 
-	resumeJob();
+	for(std::size_t i = 0; i < mNodeJobs.size(); ++ i)
+	{
+		if(!mNodeJobs[i]->empty())
+		{
+			return true;
+		}
+	}
+
+	for(std::size_t i = 0; i < mJobThreads.size(); ++ i)
+	{
+		if(!mJobThreads[i]->localJobs().empty())
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void ThreadPool::countEnqueue(Job& job)
+{
+	job.setEnqueueTime(Clock::now());
+
+	if(sCurrentJobThread && &sCurrentJobThread->pool() == this)
+	{
+		sCurrentJobThread->telemetry().countEnqueue();
+	}
+	else
+	{
+		mExternalEnqueuedJobs.fetchAdd(1, MemoryOrderRelaxed);
+	}
+}
+
+void ThreadPool::stopSearching(unsigned node, bool found)
+{
+	mSearchingThreadNumber.fetchSub(1);
+
+	// Enqueuers do not wake anybody while some JobThread is searching, so every searcher which finds a job wakes up an idle JobThread to search in
+	// its place while there are jobs left: with a burst of jobs JobThreads join one after another until all of them are working
+	if(found && hasPendingJobs())
+	{
+		wakeIdleThread(node);
+	}
+}
+
+void ThreadPool::wakeIdleThread(unsigned node)
+{
+	// Pairs with the idle announcement in JobThread::performJob(): either we see a searching or idle thread here or that thread sees our job before
+	// blocking
+	atomicThreadFence();
+
+	if(0 != mSearchingThreadNumber.load() || 0 == mIdleThreadNumber.load())
+	{
+		return;
+	}
+
+	// A JobThread of the given node first, any other one otherwise
+	for(int sameNode = 1; sameNode >= 0; -- sameNode)
+	{
+		for(std::size_t i = 0; i < mJobThreads.size(); ++ i)
+		{
+			if((mJobThreads[i]->node() == node) == (1 == sameNode) && mJobThreads[i]->claim())
+			{
+				mIdleThreadNumber.fetchSub(1);
+				mSearchingThreadNumber.fetchAdd(1);
+				mJobThreads[i]->resumeSearching();
+				return;
+			}
+		}
+	}
 }
 
 
@@ -86,9 +529,17 @@ void ThreadPool::enqueueJob(Shared<Job, MutexMTPolicy> job)
 //////////////////////////////////////////////////////////////////////////////////////////////
 
 
-ThreadPool::JobThread::JobThread() :
+ThreadPool::JobThread::JobThread(ThreadPool& pool, std::size_t index, const std::vector<unsigned>& cpus, unsigned node) :
 	BlockingThread<JobThread>("JobThread"),
-	mJob(0)
+	mPool(pool),
+	mIndex(index),
+	mCpus(cpus),
+	mNode(node),
+	mSearchNumber(0),
+	mSearchSpin(OLAGARRO_PARK_SPIN_NANOSECONDS),
+	mIdle(1),
+	mWokenSearching(0),
+	mExecutionDepth(0)
 {
 }
 
@@ -96,25 +547,212 @@ ThreadPool::JobThread::~JobThread()
 {
 }
 
-void ThreadPool::JobThread::setJob(Shared<Job, MutexMTPolicy> job)
+void ThreadPool::JobThread::resumeSearching()
 {
-	assert(!isWorking() && "ThreadPool::JobThread::setJob(): it is still working!");
+	// Set before resuming: the job loop run because of this resume reads it
+	mWokenSearching.store(1);
+	resumeJob();
+}
 
-	mJob = job;
+bool ThreadPool::JobThread::claim()
+{
+	int expected = 1;
+	return mIdle.compareExchange(expected, 0);
+}
 
-	resumeJob();
+ThreadPool& ThreadPool::JobThread::pool()
+{
+	return mPool;
+}
+
+std::size_t ThreadPool::JobThread::index() const
+{
+	return mIndex;
+}
+
+unsigned ThreadPool::JobThread::node() const
+{
+	return mNode;
+}
+
+const std::vector<std::size_t>& ThreadPool::JobThread::stealOrder() const
+{
+	return mStealOrder;
+}
+
+void ThreadPool::JobThread::setStealOrder(const std::vector<std::size_t>& stealOrder)
+{
+	mStealOrder = stealOrder;
+}
+
+unsigned ThreadPool::JobThread::countSearch()
+{
+	return mSearchNumber ++;
+}
+
+void ThreadPool::JobThread::setSearchSpin(Clock::Duration spin)
+{
+	mSearchSpin.store(spin, MemoryOrderRelaxed);
+}
+
+WorkStealingQueue< Shared<Job, AtomicMTPolicy> >& ThreadPool::JobThread::localJobs()
+{
+	return mLocalJobs;
+}
+
+TelemetryRecorder& ThreadPool::JobThread::telemetry()
+{
+	return mTelemetry;
+}
+
+const TelemetryRecorder& ThreadPool::JobThread::telemetry() const
+{
+	return mTelemetry;
+}
+
+void ThreadPool::JobThread::execute(Job& job)
+{
+	const Clock::TimePoint Start = Clock::now();
+
+	mTelemetry.countStart();
+
+	++ mExecutionDepth;
+	job.execute();
+	-- mExecutionDepth;
+
+	const Clock::TimePoint End = Clock::now();
+	const Clock::TimePoint EnqueueTime = job.enqueueTime();
+
+	mTelemetry.recordJob(job.typeName(), 0 == EnqueueTime || Start < EnqueueTime? 0 : static_cast<Clock::Duration>(Start - EnqueueTime),
+						 static_cast<Clock::Duration>(End - Start));
+
+	// Jobs executed while waiting for others are already inside the waiting job's time
+	if(0 == mExecutionDepth)
+	{
+		mTelemetry.addBusyTime(static_cast<Clock::Duration>(End - Start));
+	}
+}
+
+void ThreadPool::JobThread::preJobTasks()
+{
+	sCurrentJobThread = this;
+
+#if defined(OLAGARRO_TRACING)
+	std::stringstream name;
+	name << "JobThread " << mIndex << " of pool " << &mPool;
+	Trace::setThreadName(name.str());
+#endif
+
+	if(!mCpus.empty())
+	{
+		pinCurrentThread(mCpus);
+	}
 }
 
 void ThreadPool::JobThread::performJob()
 {
-	assert(!mJob.isNull() && "ThreadPool::JobThread::performJob(): job not set");
+	mTelemetry.countWakeUp();
+	OLAGARRO_TRACE_INSTANT("Wake up");
+
+	// Woken up by wakeIdleThread(), which counted us as searching until we find a job
+	bool searching = 0 != mWokenSearching.exchange(0);
+
+	while(true)
+	{
+		Shared<Job, AtomicMTPolicy> job;
+
+		while(true)
+		{
+			if(mPool.findJob(*this, job))
+			{
+				if(searching)
+				{
+					searching = false;
+					mPool.stopSearching(mNode, true);
+				}
+			}
+			else
+			{
+				// Nothing right after waking up: search like any other JobThread running out of work
+				if(searching)
+				{
+					searching = false;
+					mPool.stopSearching(mNode, false);
+				}
+
+				if(!searchJob(job))
+				{
+					break;
+				}
+			}
+
+			execute(*job);
+			job = Shared<Job, AtomicMTPolicy>();
+		}
+
+		// Announce we are idle and look again: a job enqueued meanwhile could have missed us
+		mIdle.store(1);
+		mPool.mIdleThreadNumber.fetchAdd(1);
+
+		if(!mPool.hasPendingJobs())
+		{
+			return;
+		}
+
+		if(!claim())
+		{
+			return; // Somebody claimed us and resumed our job loop, it will run again
+		}
+
+		mPool.mIdleThreadNumber.fetchSub(1);
+	}
+}
+
+void ThreadPool::JobThread::postJobTasks()
+{
+	sCurrentJobThread = 0;
 
-	mJob->execute();
+	JobAllocator::releaseThreadCache();
 }
 
-void ThreadPool::JobThread::performBeforeBlocking()
+bool ThreadPool::JobThread::searchJob(Shared<Job, AtomicMTPolicy>& job)
 {
-	ThreadPool::instance().resumeJob();
+	const Clock::Duration Spin = mSearchSpin.load(MemoryOrderRelaxed);
+
+	if(0 >= Spin)
+	{
+		return false;
+	}
+
+	if(mPool.mMaxSearchingThreadNumber <= mPool.mSearchingThreadNumber.fetchAdd(1))
+	{
+		mPool.mSearchingThreadNumber.fetchSub(1);
+		return false;
+	}
+
+	const Clock::TimePoint End = Clock::now() + Spin;
+	bool found = false;
+
+	// Reading the clock costs about as much as searching the queues, so it is checked every few searches
+	for(unsigned i = 1; ; ++ i)
+	{
+		if(mPool.findJob(*this, job))
+		{
+			found = true;
+			break;
+		}
+
+		cpuRelax();
+
+		if(0 == i % 8 && Clock::now() >= End)
+		{
+			break;
+		}
+	}
+
+	mPool.stopSearching(mNode, found);
+
+	return found;
 }
 
 }
@@ -25,10 +25,17 @@ freely, subject to the following restrictions:
 #define THREADPOOL_H
 
 #include <vector>
-#include <queue>
 #include <memory>
 #include "blockingthread.h"
-#include "mutexmtpolicy.h"
+#include "atomicmtpolicy.h"
+#include "workstealingqueue.h"
+#include "mpmcqueue.h"
+#include "atomic.h"
+#include "numatopology.h"
+#include "deadlinequeue.h"
+#include "jobpriority.h"
+#include "clock.h"
+#include "telemetry.h"
 
 
 namespace Olagarro
@@ -39,41 +46,232 @@ namespace Concurrency
 
 class Job;
 
+extern const unsigned HardwareThreadNumber;
+
 /**
  * @brief Core class for concurrency module: it enqueues Job objects and execute them as soon as it is possible, using all the physical CPU cores available in the system
+ *
+ * Jobs are scheduled using work stealing: every JobThread owns a WorkStealingQueue. Jobs enqueued from inside a running job go to the local queue of
+ * the thread running it (so they stay on the same core) and jobs enqueued from any other thread go to a shared lock-free pending queue. Idle JobThreads look for
+ * work in their own queue first, then in the shared one and finally steal the oldest job of another JobThread, so there is no dispatcher thread at all.
+ *
+ * By default everything runs in the pool given by instance(), with one JobThread per hardware thread. Subsystems which need to be isolated from the
+ * rest (latency sensitive ones, for example) can create their own pools, with as many JobThreads as needed and optionally pinned to some CPUs, and
+ * select them with a Scope:
+ *
+ * \code
+ * ThreadPool audioPool(2, cpus); // Two JobThreads, pinned to cpus[0] and cpus[1]
+ *
+ * {
+ *   ThreadPool::Scope scope(audioPool);
+ *
+ *   Future<void> mixed = launchJob(mixChannels);        // Runs in audioPool
+ *   concurrentFor(samples.begin(), samples.end(), Gain(0.5f)); // So do its slices
+ * }
+ * \endcode
+ *
+ * Jobs enqueued by a running job stay in the pool running it. Continuations (see Future::then()) go to the pool current when they were added,
+ * whichever thread completes the job they wait for.
+ *
+ * In machines with several NUMA nodes JobThreads are grouped per node: each one is pinned to the CPUs of its node (or to the given CPU) and, when
+ * looking for work, it takes jobs bound to its node first and steals from JobThreads of its own node before trying remote ones. concurrentFor()
+ * binds its slices to nodes in order (first slices to first node and so on), so if memory is first touched by a concurrentFor() over the same range
+ * later loops find every slice's memory in the node running it. The node of the memory itself is not queried: memory first touched any other way
+ * (by a serial loop, for example) gets no benefit from this binding.
+ *
+ * Pending jobs are kept in a queue per priority (see Job::PriorityScope), so a latency critical job is not delayed by thousands of bulk slices.
+ * JobThreads look for work in this order: jobs with deadline (earliest deadline first), high priority jobs, their own jobs, normal priority jobs,
+ * other JobThreads' jobs and background jobs. To avoid starvation, one of every StarvationInterval searches goes from lowest to highest priority.
+ *
+ * A JobThread which runs out of work keeps searching the queues for a short time (see setParkSpin()) before going idle, so jobs enqueued back to
+ * back are pulled by the JobThreads which just finished the previous ones, without waking anybody up. While some JobThread is searching, enqueueJob()
+ * does not wake idle ones: the searcher takes the job and, if jobs are left, wakes an idle JobThread to search in its place. Woken up JobThreads
+ * count as searching until they find a job, so they do the same and a burst of jobs gets every JobThread working.
  */
-class ThreadPool : public BlockingThread<ThreadPool>
+class ThreadPool
 {
 public:
-	static ThreadPool &instance();
+	/**
+	 * @brief Selects the pool used by launchJob(), concurrentFor() and such in calling thread while the Scope object lives. Scopes can be nested
+	 */
+	class Scope
+	{
+	public:
+		explicit Scope(ThreadPool& pool);
+		~Scope();
+
+	private:
+		Scope(const Scope&);
+		Scope& operator = (const Scope&);
+
+		ThreadPool* mPreviousPool;
+	};
+
+	/**
+	 * @brief ThreadPool Creates a pool with its own JobThreads
+	 * @param threadNumber Number of JobThreads (at least one is created)
+	 * @param cpus If not empty, JobThread i is pinned to CPU cpus[i % cpus.size()]. Otherwise, if topology has several nodes, JobThreads are
+	 * distributed evenly among them, each one pinned to its node's CPUs. Pinning is supported on Linux and Windows, elsewhere it is ignored
+	 * @param topology NUMA topology JobThreads are grouped by
+	 */
+	explicit ThreadPool(unsigned threadNumber = HardwareThreadNumber, const std::vector<unsigned>& cpus = std::vector<unsigned>(),
+						const NumaTopology& topology = NumaTopology::system());
+
+	/**
+	 * @brief ~ThreadPool Waits for the jobs being executed and abandons the ones still enqueued (see Job::abandon()): jobs with a result are
+	 * cancelled, so waiting for them throws JobCancelled, and jobs which can't be cancelled are executed by the calling thread
+	 */
 	~ThreadPool();
-	void enqueueJob(Shared<Job, MutexMTPolicy> job);
+
+	//! Default pool, with one JobThread per hardware thread
+	static ThreadPool &instance();
+
+	/**
+	 * @brief current Pool where calling thread enqueues its jobs: the one selected by the innermost Scope, otherwise the pool running calling thread
+	 * if it is a JobThread, otherwise instance()
+	 */
+	static ThreadPool& current();
+
+	unsigned threadNumber() const;
+
+	//! Number of NUMA nodes the JobThreads of this pool are in
+	unsigned nodeNumber() const;
+
+	/**
+	 * @brief setParkSpin How long, in nanoseconds, JobThreads which run out of work keep searching the queues and then spin waiting for a wake up
+	 * before blocking in the kernel. Spinning makes jobs enqueued shortly after another one finishes start sooner, at the cost of CPU time. 0 blocks
+	 * immediately. By default OLAGARRO_PARK_SPIN_NANOSECONDS
+	 */
+	void setParkSpin(Clock::Duration spin);
+
+	/**
+	 * @brief telemetry Snapshot of the pool's counters: pending jobs, time executing and idle of every JobThread and queue and execution time
+	 * histograms per job type (see Job::typeName()). JobThreads always keep them, with a couple of clock reads and relaxed stores per job. Jobs
+	 * executed by a job waiting for others count in the waiting job's execution time too. TelemetryDumper writes them periodically
+	 */
+	ThreadPoolTelemetry telemetry() const;
+
+	void enqueueJob(Shared<Job, AtomicMTPolicy> job);
+
+	/**
+	 * @brief enqueueJob Enqueues a job bound to a node: JobThreads of that node execute it before any other one, others only take it when they run
+	 * out of work
+	 * @param node Node index, from 0 to nodeNumber() - 1
+	 */
+	void enqueueJob(Shared<Job, AtomicMTPolicy> job, unsigned node);
+
+	/**
+	 * @brief executePendingJob Used by jobs waiting for other jobs: if calling thread is a JobThread it executes one pending job instead of blocking,
+	 * so nested jobs never wait for a free JobThread
+	 * @return false if calling thread is not a JobThread or there is nothing to execute
+	 */
+	static bool executePendingJob();
 
 private:
 
 	class JobThread : public BlockingThread<JobThread>
 	{
 	public:
-		JobThread();
+		//! The thread is pinned to cpus, if there is any, and belongs to node
+		JobThread(ThreadPool& pool, std::size_t index, const std::vector<unsigned>& cpus, unsigned node);
 		~JobThread();
-		void setJob(Shared<Job, MutexMTPolicy> job);
+
+		/**
+		 * @brief claim Turns an idle JobThread into a working one
+		 * @return false if it was not idle or other thread claimed it first
+		 */
+		bool claim();
+
+		//! Resumes a claimed JobThread which is counted as searching until it finds a job
+		void resumeSearching();
+
+		ThreadPool& pool();
+		std::size_t index() const;
+		unsigned node() const;
+
+		/**
+		 * @brief stealOrder Indices of the JobThreads to steal from, same node ones first
+		 */
+		const std::vector<std::size_t>& stealOrder() const;
+		void setStealOrder(const std::vector<std::size_t>& stealOrder);
+
+		//! Counts a search for a job, returning how many were done before
+		unsigned countSearch();
+
+		//! How long, in nanoseconds, the thread keeps searching for jobs once it runs out of them
+		void setSearchSpin(Clock::Duration spin);
+
+		WorkStealingQueue< Shared<Job, AtomicMTPolicy> >& localJobs();
+
+		TelemetryRecorder& telemetry();
+		const TelemetryRecorder& telemetry() const;
+
+		//! Executes a job taken from the queues, counting it in telemetry
+		void execute(Job& job);
+
 	private:
+		void preJobTasks();
 		void performJob();
-		void performBeforeBlocking();
+		void postJobTasks();
+
+		/**
+		 * @brief searchJob Looks for a job until one is found or search spin time elapses
+		 * @return false if no job was found or there were already enough threads searching
+		 */
+		bool searchJob(Shared<Job, AtomicMTPolicy>& job);
 
-		Shared<Job, MutexMTPolicy> mJob;
+		ThreadPool& mPool;
+		std::size_t mIndex;
+		std::vector<unsigned> mCpus;
+		unsigned mNode;
+		std::vector<std::size_t> mStealOrder;
+		unsigned mSearchNumber;
+		Atomic<long long> mSearchSpin;
+		Atomic<int> mIdle;
+		// Set by resumeSearching(): the next job loop starts counted as searching
+		Atomic<int> mWokenSearching;
+		WorkStealingQueue< Shared<Job, AtomicMTPolicy> > mLocalJobs;
+		TelemetryRecorder mTelemetry;
+		// Jobs being executed, more than one when a job executes other ones while waiting for them
+		unsigned mExecutionDepth;
 	};
 
-	ThreadPool();
-	void performJob();
+	typedef MPMCQueue< Shared<Job, AtomicMTPolicy> > JobQueue;
+
+	enum { StarvationInterval = 32 };
+
+	ThreadPool(const ThreadPool&);
+	ThreadPool& operator = (const ThreadPool&);
+
+	bool findJob(JobThread& thread, Shared<Job, AtomicMTPolicy>& job);
+	//! Takes a job out of the queues for findJob(), in priority order
+	bool takeJob(JobThread& thread, Shared<Job, AtomicMTPolicy>& job);
+	bool popQueuedJob(JobThread& thread, unsigned priority, Shared<Job, AtomicMTPolicy>& job);
+	bool hasPendingJobs();
+	void wakeIdleThread(unsigned node);
+	//! A searching JobThread stops searching, having found a job or not
+	void stopSearching(unsigned node, bool found);
+	void countEnqueue(Job& job);
+
+	static thread_local JobThread* sCurrentJobThread;
+	static thread_local ThreadPool* sScopePool;
 
 	std::vector< Shared<JobThread> > mJobThreads;
+	Atomic<int> mIdleThreadNumber;
+	// JobThreads looking for a job in searchJob(), at most half of them (but at least one) so searching never takes most of the CPUs
+	Atomic<int> mSearchingThreadNumber;
+	int mMaxSearchingThreadNumber;
 
-	tthread::mutex mJobQueueMutex;
-	std::queue< Shared<Job, MutexMTPolicy> > mPendingJobs;
-};
+	Clock::TimePoint mCreationTime;
+	// Jobs enqueued from threads which are not JobThreads of this pool, the rest are counted by the JobThreads
+	Atomic<unsigned long long> mExternalEnqueuedJobs;
 
-extern const unsigned HardwareThreadNumber;
+	JobQueue mPendingJobs[JobPriorityNumber];
+	DeadlineQueue<Shared<Job, AtomicMTPolicy>, Clock::TimePoint> mDeadlineJobs;
+
+	// Jobs bound to each node, one queue per node and priority (node * JobPriorityNumber + priority). Only used when the pool spans more than one
+	std::vector< Shared<JobQueue> > mNodeJobs;
+};
 
 }
 
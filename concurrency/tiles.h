@@ -0,0 +1,228 @@
+/*
+Copyright (c) 2014 Inaki Griego
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+		1. The origin of this software must not be misrepresented; you must not
+		claim that you wrote the original software. If you use this software
+		in a product, an acknowledgment in the product documentation would be
+		appreciated but is not required.
+
+		2. Altered source versions must be plainly marked as such, and must not be
+		misrepresented as being the original software.
+
+		3. This notice may not be removed or altered from any source
+		distribution.
+*/
+
+
+#ifndef TILES_H
+#define TILES_H
+
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <cassert>
+
+namespace Olagarro
+{
+
+namespace Concurrency
+{
+
+//! A rectangular tile of a 2D grid: rows [rowBegin, rowEnd) and columns [columnBegin, columnEnd)
+struct Tile2D
+{
+	unsigned rowBegin;
+	unsigned rowEnd;
+	unsigned columnBegin;
+	unsigned columnEnd;
+};
+
+//! A box shaped tile of a 3D grid: layers [layerBegin, layerEnd), rows [rowBegin, rowEnd) and columns [columnBegin, columnEnd)
+struct Tile3D
+{
+	unsigned layerBegin;
+	unsigned layerEnd;
+	unsigned rowBegin;
+	unsigned rowEnd;
+	unsigned columnBegin;
+	unsigned columnEnd;
+};
+
+/**
+ * @brief Random access iterator over the integers of a range, whose elements are the integers themselves. Lets concurrentFor() iterate over tile
+ * or chunk numbers without storing them anywhere
+ */
+class CountingIterator
+{
+public:
+	typedef std::random_access_iterator_tag iterator_category;
+	typedef unsigned value_type;
+	typedef int difference_type;
+	typedef const unsigned* pointer;
+	typedef unsigned reference;
+
+	explicit CountingIterator(unsigned value = 0) :
+		mValue(value)
+	{
+	}
+
+	unsigned operator * () const
+	{
+		return mValue;
+	}
+
+	CountingIterator& operator ++ ()
+	{
+		++ mValue;
+		return *this;
+	}
+
+	CountingIterator operator + (int offset) const
+	{
+		return CountingIterator(mValue + offset);
+	}
+
+	int operator - (const CountingIterator& other) const
+	{
+		return static_cast<int>(mValue - other.mValue);
+	}
+
+	bool operator == (const CountingIterator& other) const
+	{
+		return mValue == other.mValue;
+	}
+
+	bool operator != (const CountingIterator& other) const
+	{
+		return mValue != other.mValue;
+	}
+
+private:
+	unsigned mValue;
+};
+
+// Number of tiles of tileSize elements needed to cover size elements. size + tileSize - 1 would overflow with big tiles
+inline unsigned tileNumber(unsigned size, unsigned tileSize)
+{
+	return size / tileSize + (0 != size % tileSize? 1 : 0);
+}
+
+// Number of tiles of a grid with the given tile numbers per dimension. concurrentFor() counts elements with an int, so it must fit in one
+inline unsigned gridTileNumber(unsigned first, unsigned second, unsigned third = 1)
+{
+	const unsigned long long MaxTileNumber = static_cast<unsigned long long>(std::numeric_limits<int>::max());
+	const unsigned long long FirstTwo = static_cast<unsigned long long>(first) * second;
+
+	assert(FirstTwo <= MaxTileNumber && "concurrentFor2D()/concurrentFor3D(): too many tiles, make them bigger");
+
+	// Both factors fit in 32 bits, so this does not overflow either
+	const unsigned long long All = FirstTwo * third;
+
+	assert(All <= MaxTileNumber && "concurrentFor3D(): too many tiles, make them bigger");
+
+	return static_cast<unsigned>(All);
+}
+
+// End of the tile of tileSize elements starting at begin in a dimension of size elements. begin + tileSize could overflow with big tiles
+inline unsigned tileEnd(unsigned begin, unsigned tileSize, unsigned size)
+{
+	return begin + std::min(tileSize, size - begin);
+}
+
+/**
+ * @brief Functor used by concurrentFor2D(): turns tile numbers into tiles, in row major order, and calls user's functor with them
+ */
+template<typename Functor>
+class Tile2DFunctor
+{
+public:
+	Tile2DFunctor(unsigned rows, unsigned columns, unsigned tileSize, const Functor& functor) :
+		mRows(rows),
+		mColumns(columns),
+		mTileSize(tileSize),
+		mTileColumnNumber(tileNumber(columns, tileSize)),
+		mFunctor(functor)
+	{
+	}
+
+	void operator () (int, unsigned tileIndex)
+	{
+		const unsigned TileRow = tileIndex / mTileColumnNumber;
+		const unsigned TileColumn = tileIndex % mTileColumnNumber;
+
+		Tile2D tile;
+		tile.rowBegin = TileRow * mTileSize;
+		tile.rowEnd = tileEnd(tile.rowBegin, mTileSize, mRows);
+		tile.columnBegin = TileColumn * mTileSize;
+		tile.columnEnd = tileEnd(tile.columnBegin, mTileSize, mColumns);
+
+		mFunctor(tile);
+	}
+
+private:
+	unsigned mRows;
+	unsigned mColumns;
+	unsigned mTileSize;
+	unsigned mTileColumnNumber;
+	Functor mFunctor;
+};
+
+/**
+ * @brief Functor used by concurrentFor3D(): turns tile numbers into tiles, layer by layer and in row major order inside every layer, and calls
+ * user's functor with them
+ */
+template<typename Functor>
+class Tile3DFunctor
+{
+public:
+	Tile3DFunctor(unsigned layers, unsigned rows, unsigned columns, unsigned tileSize, const Functor& functor) :
+		mLayers(layers),
+		mRows(rows),
+		mColumns(columns),
+		mTileSize(tileSize),
+		mTileRowNumber(tileNumber(rows, tileSize)),
+		mTileColumnNumber(tileNumber(columns, tileSize)),
+		mFunctor(functor)
+	{
+	}
+
+	void operator () (int, unsigned tileIndex)
+	{
+		const unsigned TileLayer = tileIndex / (mTileRowNumber * mTileColumnNumber);
+		const unsigned TileRow = tileIndex / mTileColumnNumber % mTileRowNumber;
+		const unsigned TileColumn = tileIndex % mTileColumnNumber;
+
+		Tile3D tile;
+		tile.layerBegin = TileLayer * mTileSize;
+		tile.layerEnd = tileEnd(tile.layerBegin, mTileSize, mLayers);
+		tile.rowBegin = TileRow * mTileSize;
+		tile.rowEnd = tileEnd(tile.rowBegin, mTileSize, mRows);
+		tile.columnBegin = TileColumn * mTileSize;
+		tile.columnEnd = tileEnd(tile.columnBegin, mTileSize, mColumns);
+
+		mFunctor(tile);
+	}
+
+private:
+	unsigned mLayers;
+	unsigned mRows;
+	unsigned mColumns;
+	unsigned mTileSize;
+	unsigned mTileRowNumber;
+	unsigned mTileColumnNumber;
+	Functor mFunctor;
+};
+
+}
+
+}
+
+#endif // TILES_H
@@ -81,6 +81,8 @@ freely, subject to the following restrictions:
 	#include <signal.h>
 	#include <sched.h>
 	#include <unistd.h>
+	#include <errno.h>
+	#include <time.h>
 #endif
 
 // Generic includes
@@ -435,6 +437,45 @@ class condition_variable {
 #endif
 		}
 
+		/// Wait for the condition, at most a period of time.
+		/// Same as @c wait(), but the calling thread is woken up too once
+		/// aMicroseconds have passed.
+		/// @param[in] aMutex A mutex that will be unlocked when the wait operation
+		///   starts, an locked again as soon as the wait operation is finished.
+		/// @param[in] aMicroseconds Maximum time to wait.
+		/// @return false if the wait timed out, true otherwise.
+		template <class _mutexT>
+		inline bool timed_wait(_mutexT &aMutex, unsigned long long aMicroseconds)
+		{
+#if defined(_TTHREAD_WIN32_)
+			// Increment number of waiters
+			EnterCriticalSection(&mWaitersCountLock);
+			++ mWaitersCount;
+			LeaveCriticalSection(&mWaitersCountLock);
+
+			// Round up to milliseconds, staying below INFINITE
+			unsigned long long milliseconds = (aMicroseconds + 999) / 1000;
+			if(milliseconds >= INFINITE)
+				milliseconds = INFINITE - 1;
+
+			aMutex.unlock();
+			bool woken = _wait(DWORD(milliseconds));
+			aMutex.lock();
+			return woken;
+#else
+			timespec deadline;
+			clock_gettime(CLOCK_REALTIME, &deadline);
+			deadline.tv_sec += time_t(aMicroseconds / 1000000);
+			deadline.tv_nsec += long(aMicroseconds % 1000000) * 1000;
+			if(deadline.tv_nsec >= 1000000000)
+			{
+				++ deadline.tv_sec;
+				deadline.tv_nsec -= 1000000000;
+			}
+			return pthread_cond_timedwait(&mHandle, &aMutex.mHandle, &deadline) != ETIMEDOUT;
+#endif
+		}
+
 		/// Notify one thread that is waiting for the condition.
 		/// If at least one thread is blocked waiting for this condition variable,
 		/// one will be woken up.
@@ -463,6 +504,7 @@ class condition_variable {
 		}
 #endif
 
+#if defined(_TTHREAD_WIN32_)
 		bool isWaiting()
 		{
 			EnterCriticalSection(&mWaitersCountLock);
@@ -471,12 +513,13 @@ class condition_variable {
 
 			return waiting;
 		}
+#endif
 
 		_TTHREAD_DISABLE_ASSIGNMENT(condition_variable)
 
 	private:
 #if defined(_TTHREAD_WIN32_)
-		void _wait();
+		bool _wait(DWORD aMilliseconds = INFINITE);
 		HANDLE mEvents[2];                  ///< Signal and broadcast event HANDLEs.
 		unsigned int mWaitersCount;         ///< Count of the number of waiters.
 		CRITICAL_SECTION mWaitersCountLock; ///< Serialize access to mWaitersCount.
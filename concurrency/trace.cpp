@@ -0,0 +1,345 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <map>
+#include <sstream>
+#include <iomanip>
+#include <cstdlib>
+
+#if defined(__GNUC__)
+	#include <cxxabi.h>
+#endif
+
+namespace Olagarro
+{
+
+namespace Concurrency
+{
+
+namespace
+{
+
+// Never deleted, like the buffers: threads can finish while static objects are destroyed
+tthread::mutex& registryMutex()
+{
+	static tthread::mutex* mutex = new tthread::mutex();
+
+	return *mutex;
+}
+
+std::string demangle(const char* name)
+{
+#if defined(__GNUC__)
+	int status = 0;
+	char* demangled = abi::__cxa_demangle(name, 0, 0, &status);
+
+	if(demangled)
+	{
+		const std::string result(demangled);
+		std::free(demangled);
+		return result;
+	}
+#endif
+
+	return name;
+}
+
+void writeJsonString(std::ostream& stream, const std::string& text)
+{
+	stream << '"';
+
+	for(std::size_t i = 0; i < text.size(); ++ i)
+	{
+		if('"' == text[i] || '\\' == text[i])
+		{
+			stream << '\\';
+		}
+
+		stream << text[i];
+	}
+
+	stream << '"';
+}
+
+}
+
+thread_local Trace::Buffer* Trace::sThreadBuffer = 0;
+
+Trace::Buffer::Buffer(unsigned index) :
+	index(index),
+	eventNumber(0),
+	clearedEventNumber(0)
+{
+	reset();
+}
+
+void Trace::Buffer::reset()
+{
+	std::stringstream name;
+	name << "Thread " << index;
+	threadName = name.str();
+
+	finished = false;
+	reusable = false;
+	eventNumber.store(0);
+	clearedEventNumber.store(0);
+}
+
+Trace::Scope::Scope(const char* name, long long first, long long count) :
+	mName(name)
+{
+	record(Begin, name, 0, first, count);
+}
+
+Trace::Scope::~Scope()
+{
+	record(End, mName);
+}
+
+Trace::JobScope::JobScope(const char* typeName, const void* job) :
+	mTypeName(typeName)
+{
+	record(Begin, typeName, 0, -1, -1, true);
+	record(FlowEnd, "Job", job);
+}
+
+Trace::JobScope::~JobScope()
+{
+	record(End, mTypeName, 0, -1, -1, true);
+}
+
+void Trace::record(EventType type, const char* name, const void* id, long long first, long long count, bool isTypeName)
+{
+	Buffer& buffer = threadBuffer();
+	const unsigned long long EventNumber = buffer.eventNumber.load(MemoryOrderRelaxed);
+	Event& event = buffer.events[EventNumber % OLAGARRO_TRACE_BUFFER_EVENTS];
+
+	// Pairs with readEvent(): a reader which sees any of the writes below overwriting an event also sees that eventNumber went past it
+	atomicThreadFence(MemoryOrderRelease);
+
+	event.name = name;
+	event.id = id;
+	event.time = Clock::now();
+	event.first = first;
+	event.count = count;
+	event.type = static_cast<unsigned char>(type);
+	event.isTypeName = isTypeName;
+
+	// Publishes the event to writeChromeTrace()
+	buffer.eventNumber.store(EventNumber + 1, MemoryOrderRelease);
+}
+
+void Trace::setThreadName(const std::string& name)
+{
+	Buffer& buffer = threadBuffer();
+
+	tthread::lock_guard<tthread::mutex> guard(registryMutex());
+
+	buffer.threadName = name;
+}
+
+void Trace::writeChromeTrace(std::ostream& stream)
+{
+	tthread::lock_guard<tthread::mutex> guard(registryMutex());
+
+	const std::vector<Buffer*>& buffers = Trace::buffers();
+
+	// Timestamps are written relative to the oldest event, Clock's origin is meaningless anyway
+	Clock::TimePoint origin = Clock::now();
+
+	for(std::size_t i = 0; i < buffers.size(); ++ i)
+	{
+		const unsigned long long EventNumber = buffers[i]->eventNumber.load(MemoryOrderAcquire);
+		Event event;
+
+		for(unsigned long long j = firstEvent(*buffers[i], EventNumber); j < EventNumber; ++ j)
+		{
+			if(readEvent(*buffers[i], j, event))
+			{
+				origin = std::min(origin, event.time);
+				break;
+			}
+		}
+	}
+
+	std::map<const char*, std::string> demangledNames;
+	const std::ios_base::fmtflags Flags = stream.flags();
+	const std::streamsize Precision = stream.precision();
+	const char* separator = "\n";
+
+	stream << std::fixed << std::setprecision(3);
+	stream << "{\"traceEvents\":[";
+
+	for(std::size_t i = 0; i < buffers.size(); ++ i)
+	{
+		const Buffer& buffer = *buffers[i];
+		const unsigned long long EventNumber = buffer.eventNumber.load(MemoryOrderAcquire);
+
+		stream << separator << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer.index << ",\"args\":{\"name\":";
+		writeJsonString(stream, buffer.threadName);
+		stream << "}}";
+		separator = ",\n";
+
+		for(unsigned long long j = firstEvent(buffer, EventNumber); j < EventNumber; ++ j)
+		{
+			Event event;
+
+			if(!readEvent(buffer, j, event))
+			{
+				continue;
+			}
+
+			static const char* const Phases[] = { "B", "E", "i", "s", "f" };
+
+			std::string name;
+
+			if(event.isTypeName)
+			{
+				std::map<const char*, std::string>::iterator demangled = demangledNames.find(event.name);
+
+				if(demangledNames.end() == demangled)
+				{
+					demangled = demangledNames.insert(std::make_pair(event.name, demangle(event.name))).first;
+				}
+
+				name = demangled->second;
+			}
+			else
+			{
+				name = event.name;
+			}
+
+			stream << separator << "{\"name\":";
+			writeJsonString(stream, name);
+			stream << ",\"cat\":\"concurrency\",\"ph\":\"" << Phases[event.type] << "\",\"ts\":" << (event.time - origin) / 1000.0
+				   << ",\"pid\":1,\"tid\":" << buffer.index;
+
+			if(FlowStart == event.type || FlowEnd == event.type)
+			{
+				stream << ",\"id\":\"" << event.id << "\"";
+			}
+
+			if(FlowEnd == event.type)
+			{
+				stream << ",\"bp\":\"e\"";
+			}
+
+			if(Instant == event.type)
+			{
+				stream << ",\"s\":\"t\"";
+			}
+
+			if(Begin == event.type && 0 <= event.count)
+			{
+				stream << ",\"args\":{\"first\":" << event.first << ",\"count\":" << event.count << "}";
+			}
+
+			stream << "}";
+		}
+	}
+
+	stream << "\n],\"displayTimeUnit\":\"ns\"}\n";
+
+	stream.flags(Flags);
+	stream.precision(Precision);
+
+	releaseFinishedBuffers();
+}
+
+void Trace::clear()
+{
+	tthread::lock_guard<tthread::mutex> guard(registryMutex());
+
+	for(std::size_t i = 0; i < buffers().size(); ++ i)
+	{
+		buffers()[i]->clearedEventNumber.store(buffers()[i]->eventNumber.load(MemoryOrderAcquire), MemoryOrderRelease);
+	}
+
+	releaseFinishedBuffers();
+}
+
+unsigned long long Trace::firstEvent(const Buffer& buffer, unsigned long long eventNumber)
+{
+	const unsigned long long Capacity = OLAGARRO_TRACE_BUFFER_EVENTS;
+
+	return std::max(buffer.clearedEventNumber.load(MemoryOrderAcquire), eventNumber > Capacity? eventNumber - Capacity : 0);
+}
+
+bool Trace::readEvent(const Buffer& buffer, unsigned long long index, Event& event)
+{
+	const unsigned long long Capacity = OLAGARRO_TRACE_BUFFER_EVENTS;
+
+	event = buffer.events[index % Capacity];
+
+	// Its thread starts overwriting the event once it has recorded Capacity more
+	atomicThreadFence(MemoryOrderAcquire);
+
+	return buffer.eventNumber.load(MemoryOrderRelaxed) < index + Capacity;
+}
+
+Trace::Buffer& Trace::threadBuffer()
+{
+	if(!sThreadBuffer)
+	{
+		static ThreadExitHook* threadExitHook = 0;
+
+		tthread::lock_guard<tthread::mutex> guard(registryMutex());
+
+		for(std::size_t i = 0; i < buffers().size() && !sThreadBuffer; ++ i)
+		{
+			if(buffers()[i]->reusable)
+			{
+				sThreadBuffer = buffers()[i];
+				sThreadBuffer->reset();
+			}
+		}
+
+		if(!sThreadBuffer)
+		{
+			sThreadBuffer = new Buffer(static_cast<unsigned>(buffers().size()));
+			buffers().push_back(sThreadBuffer);
+		}
+
+		// Created here, with the registry mutex locked, so it exists even for threads tracing from other static initializers
+		if(!threadExitHook)
+		{
+			threadExitHook = new ThreadExitHook(&threadFinished);
+		}
+
+		threadExitHook->watchCallingThread(sThreadBuffer);
+	}
+
+	return *sThreadBuffer;
+}
+
+void OLAGARRO_THREAD_EXIT_CALLBACK Trace::threadFinished(void* buffer)
+{
+	tthread::lock_guard<tthread::mutex> guard(registryMutex());
+
+	static_cast<Buffer*>(buffer)->finished = true;
+	sThreadBuffer = 0;
+}
+
+void Trace::releaseFinishedBuffers()
+{
+	for(std::size_t i = 0; i < buffers().size(); ++ i)
+	{
+		if(buffers()[i]->finished)
+		{
+			buffers()[i]->reusable = true;
+		}
+	}
+}
+
+std::vector<Trace::Buffer*>& Trace::buffers()
+{
+	// Buffers outlive their threads, so events of finished threads can still be written, and then they are reused by new threads. They are never
+	// deleted: JobThreads of static pools could be tracing while static objects are destroyed
+	static std::vector<Buffer*>* buffers = new std::vector<Buffer*>();
+
+	return *buffers;
+}
+
+}
+
+}
@@ -0,0 +1,199 @@
+/*
+Copyright (c) 2014 Inaki Griego
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+		1. The origin of this software must not be misrepresented; you must not
+		claim that you wrote the original software. If you use this software
+		in a product, an acknowledgment in the product documentation would be
+		appreciated but is not required.
+
+		2. Altered source versions must be plainly marked as such, and must not be
+		misrepresented as being the original software.
+
+		3. This notice may not be removed or altered from any source
+		distribution.
+*/
+
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include "atomic.h"
+#include "clock.h"
+#include "threadexithook.h"
+#include "tinythread/tinythread.h"
+
+//! Events every thread keeps, older ones are overwritten. Each one takes 64 bytes
+#if !defined(OLAGARRO_TRACE_BUFFER_EVENTS)
+	#define OLAGARRO_TRACE_BUFFER_EVENTS 16384
+#endif
+
+#if defined(OLAGARRO_TRACING)
+	#define OLAGARRO_TRACE_SCOPE(name) ::Olagarro::Concurrency::Trace::Scope olagarroTraceScope(name)
+	#define OLAGARRO_TRACE_RANGE_SCOPE(name, first, count) ::Olagarro::Concurrency::Trace::Scope olagarroTraceScope(name, first, count)
+	#define OLAGARRO_TRACE_JOB_SCOPE(job) ::Olagarro::Concurrency::Trace::JobScope olagarroTraceJobScope((job).typeName(), &(job))
+	#define OLAGARRO_TRACE_ENQUEUE(job) ::Olagarro::Concurrency::Trace::record(::Olagarro::Concurrency::Trace::FlowStart, "Job", &(job))
+	#define OLAGARRO_TRACE_DEQUEUE(job) ::Olagarro::Concurrency::Trace::record(::Olagarro::Concurrency::Trace::Instant, "Dequeue", &(job))
+	#define OLAGARRO_TRACE_INSTANT(name) ::Olagarro::Concurrency::Trace::record(::Olagarro::Concurrency::Trace::Instant, name)
+#else
+	#define OLAGARRO_TRACE_SCOPE(name) ((void)0)
+	#define OLAGARRO_TRACE_RANGE_SCOPE(name, first, count) ((void)0)
+	#define OLAGARRO_TRACE_JOB_SCOPE(job) ((void)0)
+	#define OLAGARRO_TRACE_ENQUEUE(job) ((void)0)
+	#define OLAGARRO_TRACE_DEQUEUE(job) ((void)0)
+	#define OLAGARRO_TRACE_INSTANT(name) ((void)0)
+#endif
+
+namespace Olagarro
+{
+
+namespace Concurrency
+{
+
+/**
+ * @brief Execution timeline of the concurrency module in Chrome's trace event format, which chrome://tracing and Perfetto (ui.perfetto.dev) open.
+ *
+ * Tracing is opt-in: the module only records events when it is compiled with OLAGARRO_TRACING defined, otherwise the OLAGARRO_TRACE_* macros
+ * expand to nothing and it costs nothing. When enabled it records:
+ * - Every Job::execute() call, named after Job::typeName(), with an arrow from the point where a ThreadPool enqueued the job
+ * - Every job a JobThread takes out of the ThreadPool's queues, so the time it waited is the distance from the arrow's tail to that instant
+ * - Every range of elements a concurrentFor slice processes (the whole slice, or each batch with dynamic partitioning), with its first index and
+ *   element number
+ * - JobThread wake ups
+ *
+ * Client code can add its own events with the same macros or calling record() directly, which works whether OLAGARRO_TRACING is defined or not.
+ *
+ * Every thread writes its events in a ring buffer of its own, which keeps the last OLAGARRO_TRACE_BUFFER_EVENTS ones, without locks nor
+ * read-modify-write operations. writeChromeTrace() and clear() can be called while other threads trace: events recorded meanwhile may be left
+ * out, and events overwritten while writeChromeTrace() reads them are skipped. Buffers of finished threads are kept until their events are
+ * written or cleared, then new threads reuse them.
+ *
+ * \code
+ * concurrentFor(pixels.begin(), pixels.end(), Blur());
+ *
+ * std::ofstream file("blur.json");
+ * Trace::writeChromeTrace(file);
+ * \endcode
+ */
+class Trace
+{
+public:
+	enum EventType
+	{
+		Begin,
+		End,
+		Instant,
+		//! Tail of an arrow, like the point where a job is enqueued. FlowStart and FlowEnd events with the same name and id are linked
+		FlowStart,
+		//! Head of an arrow, bound to the innermost Begin / End pair around it
+		FlowEnd
+	};
+
+	//! Records a Begin event when created and its End event when destroyed
+	class Scope
+	{
+	public:
+		explicit Scope(const char* name, long long first = -1, long long count = -1);
+		~Scope();
+
+	private:
+		Scope(const Scope&);
+		Scope& operator = (const Scope&);
+
+		const char* mName;
+	};
+
+	//! Scope of a job execution, with the head of the arrow coming from its enqueue
+	class JobScope
+	{
+	public:
+		JobScope(const char* typeName, const void* job);
+		~JobScope();
+
+	private:
+		JobScope(const JobScope&);
+		JobScope& operator = (const JobScope&);
+
+		const char* mTypeName;
+	};
+
+	/**
+	 * @brief record Adds an event to calling thread's buffer
+	 * @param name Only the pointer is kept, so it must have static storage
+	 * @param id Links FlowStart and FlowEnd events, unused by the other ones
+	 * @param first, count Range of elements the event refers to, shown in Begin events' details if count is not negative
+	 * @param isTypeName name comes from typeid() and it is demangled when written
+	 */
+	static void record(EventType type, const char* name, const void* id = 0, long long first = -1, long long count = -1, bool isTypeName = false);
+
+	//! Name calling thread gets in the trace, "Thread n" by default
+	static void setThreadName(const std::string& name);
+
+	//! Writes every thread's events as a Chrome trace JSON document
+	static void writeChromeTrace(std::ostream& stream);
+
+	//! Forgets every recorded event. Buffers are not touched, writeChromeTrace() just starts after the events recorded so far
+	static void clear();
+
+private:
+	struct Event
+	{
+		const char* name;
+		const void* id;
+		Clock::TimePoint time;
+		long long first;
+		long long count;
+		unsigned char type;
+		bool isTypeName;
+	};
+
+	struct Buffer
+	{
+		Buffer(unsigned index);
+
+		//! Prepares the buffer for a new thread
+		void reset();
+
+		unsigned index;
+		std::string threadName;
+		//! Its thread has finished
+		bool finished;
+		//! Its thread has finished and its events have been written or cleared since, so another thread can take it
+		bool reusable;
+		// Events ever written: the last one is at (eventNumber - 1) % OLAGARRO_TRACE_BUFFER_EVENTS. Only its thread writes it
+		Atomic<unsigned long long> eventNumber;
+		// Events before this one were cleared. clear() sets it instead of eventNumber, which would race with its thread
+		Atomic<unsigned long long> clearedEventNumber;
+		Event events[OLAGARRO_TRACE_BUFFER_EVENTS];
+	};
+
+	static Buffer& threadBuffer();
+	//! First event of buffer which has not been cleared nor overwritten, when it had eventNumber events
+	static unsigned long long firstEvent(const Buffer& buffer, unsigned long long eventNumber);
+	//! Copies an event of buffer. Returns false if its thread overwrote it meanwhile, so the copy can be garbled
+	static bool readEvent(const Buffer& buffer, unsigned long long index, Event& event);
+	//! Every thread's buffer, protected by the registry mutex
+	static std::vector<Buffer*>& buffers();
+	//! Called when a thread with a buffer finishes
+	static void OLAGARRO_THREAD_EXIT_CALLBACK threadFinished(void* buffer);
+	//! Lets new threads reuse the buffers of finished threads, once their events are not needed anymore. Called with the registry mutex locked
+	static void releaseFinishedBuffers();
+
+	static thread_local Buffer* sThreadBuffer;
+};
+
+}
+
+}
+
+#endif // TRACE_H
@@ -0,0 +1,116 @@
+/*
+Copyright (c) 2014 Inaki Griego
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+		1. The origin of this software must not be misrepresented; you must not
+		claim that you wrote the original software. If you use this software
+		in a product, an acknowledgment in the product documentation would be
+		appreciated but is not required.
+
+		2. Altered source versions must be plainly marked as such, and must not be
+		misrepresented as being the original software.
+
+		3. This notice may not be removed or altered from any source
+		distribution.
+*/
+
+
+#ifndef WORKSTEALINGQUEUE_H
+#define WORKSTEALINGQUEUE_H
+
+#include <deque>
+#include "tinythread/fast_mutex.h"
+
+namespace Olagarro
+{
+
+namespace Concurrency
+{
+
+/**
+ * @brief Double ended queue owned by a single worker thread.
+ *
+ * Its owner pushes and pops elements at the back (LIFO order, so recently created jobs are executed while their data is still in cache) and other
+ * threads steal elements from the front (FIFO order, so thieves take the oldest and usually biggest pieces of work). Every operation, at either
+ * end, takes the same fast_mutex for one short critical section, so threads contending for it are never kept waiting long.
+ */
+template<typename T>
+class WorkStealingQueue
+{
+public:
+	void push(const T& element)
+	{
+		tthread::lock_guard<tthread::fast_mutex> guard(mMutex);
+
+		mElements.push_back(element);
+	}
+
+	/**
+	 * @brief pop Owner's side: takes newest element
+	 * @return false if queue was empty
+	 */
+	bool pop(T& element)
+	{
+		tthread::lock_guard<tthread::fast_mutex> guard(mMutex);
+
+		if(mElements.empty())
+		{
+			return false;
+		}
+
+		element = mElements.back();
+		mElements.pop_back();
+
+		return true;
+	}
+
+	/**
+	 * @brief steal Thieves' side: takes oldest element
+	 * @return false if queue was empty
+	 */
+	bool steal(T& element)
+	{
+		tthread::lock_guard<tthread::fast_mutex> guard(mMutex);
+
+		if(mElements.empty())
+		{
+			return false;
+		}
+
+		element = mElements.front();
+		mElements.pop_front();
+
+		return true;
+	}
+
+	bool empty() const
+	{
+		tthread::lock_guard<tthread::fast_mutex> guard(mMutex);
+
+		return mElements.empty();
+	}
+
+	void clear()
+	{
+		tthread::lock_guard<tthread::fast_mutex> guard(mMutex);
+
+		mElements.clear();
+	}
+
+private:
+	mutable tthread::fast_mutex mMutex;
+	std::deque<T> mElements;
+};
+
+}
+
+}
+
+#endif // WORKSTEALINGQUEUE_H
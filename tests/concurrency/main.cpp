@@ -25,6 +25,13 @@ freely, subject to the following restrictions:
 #include <iostream>
 #include <vector>
 #include <cstdlib>
+#include <algorithm>
+#include <numeric>
+#include <functional>
+#include <string>
+#include <list>
+#include <map>
+#include <sstream>
 
 #include <limits>
 
@@ -32,6 +39,10 @@ freely, subject to the following restrictions:
 
 #include <stdexcept>
 
+#if defined(_TTHREAD_CPP11_)
+	#include <memory>
+#endif
+
 // Class and functions used by test code
 
 struct Multiply
@@ -64,6 +75,138 @@ struct FindMax
 	float maxValue;
 };
 
+// Element number of every slice it was merged from
+struct SliceSizes
+{
+	SliceSizes() : size(0) {}
+
+	void operator()(int /*index*/, float& /*value*/)
+	{
+		++ size;
+	}
+
+	void merge(const SliceSizes& other)
+	{
+		sizes.insert(sizes.end(), other.sizes.begin(), other.sizes.end());
+		sizes.push_back(other.size);
+	}
+
+	std::vector<int> sizes;
+	int size;
+};
+
+// Counts elements per value modulo 16, how many functor copies have been merged into this one and the longest chain of merges behind it
+struct Histogram
+{
+	Histogram() :
+		counts(16, 0),
+		copies(1),
+		depth(0)
+	{
+	}
+
+	void operator()(int /*index*/, int& value)
+	{
+		++ counts[value % 16];
+	}
+
+	void merge(const Histogram& other)
+	{
+		for(std::size_t i = 0; i < counts.size(); ++ i)
+		{
+			counts[i] += other.counts[i];
+		}
+
+		copies += other.copies;
+		depth = std::max(depth, other.depth) + 1;
+	}
+
+	std::vector<int> counts;
+	int copies;
+	int depth;
+};
+
+// Increments every element of the tile it is called with, in a grid stored in row major order
+struct CountVisits
+{
+	CountVisits(std::vector<int>& grid, unsigned rows, unsigned columns) :
+		grid(&grid),
+		rows(rows),
+		columns(columns)
+	{
+	}
+
+	void operator()(const Olagarro::Concurrency::Tile2D& tile)
+	{
+		for(unsigned row = tile.rowBegin; row < tile.rowEnd; ++ row)
+		{
+			for(unsigned column = tile.columnBegin; column < tile.columnEnd; ++ column)
+			{
+				++ (*grid)[row * columns + column];
+			}
+		}
+	}
+
+	void operator()(const Olagarro::Concurrency::Tile3D& tile)
+	{
+		for(unsigned layer = tile.layerBegin; layer < tile.layerEnd; ++ layer)
+		{
+			for(unsigned row = tile.rowBegin; row < tile.rowEnd; ++ row)
+			{
+				for(unsigned column = tile.columnBegin; column < tile.columnEnd; ++ column)
+				{
+					++ (*grid)[(layer * rows + row) * columns + column];
+				}
+			}
+		}
+	}
+
+	std::vector<int>* grid;
+	unsigned rows;
+	unsigned columns;
+};
+
+void storeIndex(int index, float& value)
+{
+	value = static_cast<float>(index);
+}
+
+struct DoubleMapValue
+{
+	void operator()(int /*index*/, std::pair<const int, int>& element)
+	{
+		element.second = element.first * 2;
+	}
+};
+
+// Ping-pong between two threads through two Parkers: every side waits for the other one's unpark before answering
+struct PingPong
+{
+	PingPong(Olagarro::Concurrency::Clock::Duration spin) :
+		ping(spin),
+		pong(spin),
+		counter(0)
+	{
+	}
+
+	Olagarro::Concurrency::Parker ping;
+	Olagarro::Concurrency::Parker pong;
+	int counter;
+};
+
+const int PingPongRounds = 2000;
+
+void ponger(void* param)
+{
+	PingPong* pingPong = static_cast<PingPong*>(param);
+
+	for(int i = 0; i < PingPongRounds; ++ i)
+	{
+		pingPong->ping.park();
+		++ pingPong->counter;
+		pingPong->pong.unpark();
+	}
+}
 
 float test()
 {
@@ -141,179 +284,1925 @@ struct Test
 	}
 };
 
-class TestClass
+// Launches a concurrentFor from inside a job and waits for it, so a JobThread waits for other jobs
+float nestedConcurrentFor()
 {
-public:
-	float ZeroParam()
+	std::vector<float> values(1024, 1.0f);
+
+	Olagarro::Concurrency::concurrentFor(values.begin(), values.end(), Multiply(2)).result();
+
+	float sum = 0.0f;
+
+	for(std::size_t i = 0; i < values.size(); ++ i)
 	{
-		return test();
+		sum += values[i];
 	}
 
-	float OneParamCopy(int /*a*/)
+	return sum;
+}
+
+// Continuation stages: their input future is ready when they are called
+float doubleValue(Olagarro::Concurrency::Future<float> value)
+{
+	return value.result() * 2.0f;
+}
+
+int afterVoid(Olagarro::Concurrency::Future<void> done)
+{
+	done.result();
+	return 1;
+}
+
+// Takes long enough to check timed waits
+int slowJob()
+{
+	tthread::this_thread::sleep_for(tthread::chrono::milliseconds(200));
+	return 7;
+}
+
+// Result type without default constructor which counts its copies
+class CopyCounter
+{
+public:
+	explicit CopyCounter(int value) :
+		mValue(value)
 	{
-		return test();
 	}
 
-	float OneParamConst(const std::string& /*a*/)
+	CopyCounter(const CopyCounter& other) :
+		mValue(other.mValue)
 	{
-		return test();
+		++ sCopyNumber;
 	}
 
-	float OneParamNoConst(std::string& /*a*/)
+	int value() const
 	{
-		return test();
+		return mValue;
 	}
 
+	static int sCopyNumber;
+
+private:
+	CopyCounter& operator = (const CopyCounter&);
+
+	int mValue;
 };
 
+int CopyCounter::sCopyNumber = 0;
 
-int main(int /*argc*/, char** /*argv*/)
+CopyCounter makeCopyCounter()
 {
-	using namespace Olagarro::Concurrency;
+	return CopyCounter(5);
+}
 
-	// Some tests are doable comparing values, others not, like the testVoid() call. Also if the app finishes (it takes less than 20 seconds in my machine)
-	// it passes the thread managing test by not getting blocked forever
+int readCopyCounter(const CopyCounter& counter)
+{
+	return counter.value();
+}
 
-	const float testResult = test();
+Olagarro::Concurrency::ThreadPool* currentPool()
+{
+	return &Olagarro::Concurrency::ThreadPool::current();
+}
 
-	/////////////////////////////////////////////////////////////////
-	// FREE FUNCTIONS CALLS
-	/////////////////////////////////////////////////////////////////
+Olagarro::Concurrency::ThreadPool* continuationPool(Olagarro::Concurrency::Future<int> /*antecedent*/)
+{
+	return &Olagarro::Concurrency::ThreadPool::current();
+}
 
-	std::cout << "--------------------------------------------------------\n";
-	std::cout << "Free functions tests\n";
-	std::cout << "--------------------------------------------------------\n";
+// Blocks its JobThread until released, so other jobs can be queued up behind it
+Olagarro::Concurrency::Atomic<int> gateStarted;
+Olagarro::Concurrency::Atomic<int> gateReleased;
 
-	// Test 1: float test() call
-	Future<float> test1 = launchJob(test);
-	assert(testResult == test1.result() && "Invalid returned value in test1");
+void gate()
+{
+	gateStarted.store(1);
 
-	// Test 2: void testVoid() call
-	Future<void> test2 = launchJob(testVoid);
-	test2.result();
+	while(0 == gateReleased.load())
+	{
+		tthread::this_thread::yield();
+	}
+}
 
-	// Test 3: float testParam(int param) call. It uses the copy version
-	Future<float> test3 = launchJob(testParam, 666);
-	test3.result();
+void closeGate()
+{
+	gateStarted.store(0);
+	gateReleased.store(0);
 
-	assert(testResult == test3.result() && "Invalid returned value in test3");
+	Olagarro::Concurrency::launchJob(gate);
 
-	// Test 4: float testParamVector(const std::vector<int>& param) call. It uses the const& version
-	Future<float> test4 = launchJob(testParamVector, std::vector<int>(10));
-	test4.result();
+	while(0 == gateStarted.load())
+	{
+		tthread::this_thread::yield();
+	}
+}
 
-	assert(testResult == test4.result() && "Invalid returned value in test4");
+// Returns in which order it was executed
+Olagarro::Concurrency::Atomic<int> executionOrder;
 
-	// Test 5: float testParamNoConst(std::vector<int>& param) call. It uses the no const& version
-	std::vector<int> testVector(10);
-	Future<float> test5 = launchJob(testParamNoConst, testVector);
-	test5.result();
+int recordOrder()
+{
+	return executionOrder.fetchAdd(1);
+}
 
-	assert(testResult == test5.result() && "Invalid returned value in test5");
-	assert(testVector.empty() && "Invalid testVector size in test5");
+// Launched from a running job: a job with deadline, a high priority one and a normal one, in this order
+std::vector< Olagarro::Concurrency::Future<int> > launchNestedPriorities()
+{
+	using namespace Olagarro::Concurrency;
 
-	std::cout << "OK" << std::endl;
+	std::vector< Future<int> > futures(3);
 
+	{
+		Job::PriorityScope priorityScope(NormalPriority, Clock::now() + 10000000000ull);
+		futures[0] = launchJob(recordOrder);
+	}
 
-	/////////////////////////////////////////////////////////////////
-	// FUNCTOR TEST
-	/////////////////////////////////////////////////////////////////
+	{
+		Job::PriorityScope priorityScope(HighPriority);
+		futures[1] = launchJob(recordOrder);
+	}
 
-	std::cout << "--------------------------------------------------------\n";
-	std::cout << "Functor tests\n";
-	std::cout << "--------------------------------------------------------\n";
+	futures[2] = launchJob(recordOrder);
 
-	// Test 6: Call constant functor
-	Future<float> test6 = launchJob<float>(ConstFunctor());
+	return futures;
+}
 
-	assert(testResult == test6.result() && "Invalid returned value in test6");
+// Thread which executed every recordThread() job
+std::vector<tthread::thread::id> executingThreads;
 
-	// Test 7: Call no constant functor
-	NoConstFunctor noConstFunctor(200);
-	Future<float> test7 = launchJob<float>(noConstFunctor);
+void recordThread(int index)
+{
+	tthread::this_thread::sleep_for(tthread::chrono::milliseconds(1));
+	executingThreads[index] = tthread::this_thread::get_id();
+}
 
-	assert(testResult == test7.result() && "Invalid returned value in test7");
+// Blocks until blockingJobNumber of these jobs run at the same time, or two seconds pass. Returns true in the first case
+Olagarro::Concurrency::Atomic<int> startedBlockingJobs;
+int blockingJobNumber = 0;
 
-	std::cout << "OK" << std::endl;
+bool waitForBlockingJobs()
+{
+	const Olagarro::Concurrency::Clock::TimePoint End = Olagarro::Concurrency::Clock::now() + 2000000000ull;
 
+	startedBlockingJobs.fetchAdd(1);
 
-	/////////////////////////////////////////////////////////////////
-	// MEMBER FUNCTIONS CALLS
-	/////////////////////////////////////////////////////////////////
+	while(startedBlockingJobs.load() < blockingJobNumber)
+	{
+		if(Olagarro::Concurrency::Clock::now() >= End)
+		{
+			return false;
+		}
 
-	std::cout << "--------------------------------------------------------\n";
-	std::cout << "Member function tests\n";
-	std::cout << "--------------------------------------------------------\n";
+		tthread::this_thread::yield();
+	}
 
-	TestClass testClass;
+	return true;
+}
 
-	Future<float> test8 = launchJob(testClass, &TestClass::ZeroParam);
-	test8.result();
+void sleepMillisecond()
+{
+	tthread::this_thread::sleep_for(tthread::chrono::milliseconds(1));
+}
 
-	assert(testResult == test8.result() && "Invalid returned value in test8");
+// Pipeline tests' token: the source numbers it and stages calculate its square
+struct PipelineToken
+{
+	PipelineToken() :
+		value(0),
+		square(0)
+	{
+	}
 
-	Future<float> test9 = launchJob(testClass, &TestClass::OneParamCopy, 10);
-	test9.result();
+	int value;
+	long long square;
+};
 
-	assert(testResult == test9.result() && "Invalid returned value in test9");
+Olagarro::Concurrency::Atomic<int> tokensInFlight;
+Olagarro::Concurrency::Atomic<int> maxTokensInFlight;
 
-	Future<float> test10 = launchJob(testClass, &TestClass::OneParamConst, std::string("testString const&"));
-	test10.result();
+struct CountTo
+{
+	CountTo(int limit) :
+		next(0),
+		limit(limit)
+	{
+	}
 
-	assert(testResult == test10.result() && "Invalid returned value in test10");
+	bool operator()(PipelineToken& token)
+	{
+		if(limit == next)
+		{
+			return false;
+		}
 
-	std::string b("testString &");
-	Future<float> test11 = launchJob(testClass, &TestClass::OneParamNoConst, b);
-	test11.result();
+		token.value = next ++;
 
-	assert(testResult == test11.result() && "Invalid returned value in test11");
+		// The source is serial, so nobody else updates the maximum meanwhile
+		maxTokensInFlight.store(std::max(maxTokensInFlight.load(), tokensInFlight.fetchAdd(1) + 1));
 
-	// Test 12: Futures in a container
-	std::vector< Future<float> > resultsTest12(10);
+		return true;
+	}
 
-	for(std::size_t i = 0; i < resultsTest12.size(); ++ i)
+	int next;
+	int limit;
+};
+
+// Takes a different time for every token, so they leave this stage out of order
+void squareToken(PipelineToken& token)
+{
+	volatile int work = 0;
+
+	for(int i = 0; i < (token.value * 7919) % 5000; ++ i)
 	{
-		resultsTest12[i] = launchJob(test);
+		work += i;
 	}
 
-	// Jobs launched, wait for and check them
-	for(std::size_t i = 0; i < resultsTest12.size(); ++ i)
+	token.square = static_cast<long long>(token.value) * token.value;
+}
+
+struct ThrowAtToken
+{
+	ThrowAtToken(int value) :
+		value(value)
 	{
-		assert(testResult == resultsTest12[i].result() && "Invalid returned value in test12");
 	}
 
-	std::cout << "OK" << std::endl;
-
-	/////////////////////////////////////////////////////////////////
-	// CONCURRENT FOR CALLS
-	/////////////////////////////////////////////////////////////////
+	void operator()(PipelineToken& token) const
+	{
+		if(value == token.value)
+		{
+			throw std::runtime_error("ThrowAtToken");
+		}
+	}
 
-	const int ValueNumber = 1024 * 1024;
-	std::vector<float> values;
-	values.reserve(ValueNumber);
+	int value;
+};
 
-	std::cout << "--------------------------------------------------------\n";
-	std::cout << "concurrentFor() tests\n";
-	std::cout << "--------------------------------------------------------\n";
+struct CollectSquares
+{
+	CollectSquares(std::vector<long long>& squares, const Olagarro::Concurrency::CancellationToken& token = Olagarro::Concurrency::CancellationToken(),
+				   std::size_t cancelAt = 0) :
+		squares(&squares),
+		token(token),
+		cancelAt(cancelAt)
+	{
+	}
 
-	for(int i = 0; i < ValueNumber; ++ i)
+	void operator()(PipelineToken& token)
 	{
-		values.push_back(i);
+		squares->push_back(token.square);
+		tokensInFlight.fetchSub(1);
+
+		if(squares->size() == cancelAt)
+		{
+			this->token.cancel();
+		}
 	}
 
-	// Test 13: concurrentFor call
-	Future<void> test13 = concurrentFor(values.begin(), values.end(), Multiply(10));
-	test13.result();
+	std::vector<long long>* squares;
+	Olagarro::Concurrency::CancellationToken token;
+	std::size_t cancelAt;
+};
 
-	for(std::size_t i = 0; i < values.size(); ++ i)
+bool collectedInOrder(const std::vector<long long>& squares)
+{
+	for(std::size_t i = 0; i < squares.size(); ++ i)
 	{
-		assert(values[i] == i * 10 && "Invalid value in test13");
+		if(static_cast<long long>(i * i) != squares[i])
+		{
+			return false;
+		}
 	}
 
-	// Test 13: concurrentReductor call
-	Future<FindMax> test14 = concurrentReductorFor(values.begin(), values.end(), FindMax());
+	return true;
+}
 
-	assert(test14.result().maxValue == values.back() && "Invalid value in test14");
+void traceInThread(void* /*param*/)
+{
+	Olagarro::Concurrency::Trace::setThreadName("Tracing thread");
+	Olagarro::Concurrency::Trace::Scope scope("Traced in thread", 10, 5);
+}
+
+Olagarro::Concurrency::Atomic<int> stopTracing(0);
+
+// Records events until stopTracing is set, going around its trace buffer many times
+void traceUntilStopped(void* /*param*/)
+{
+	while(0 == stopTracing.load())
+	{
+		Olagarro::Concurrency::Trace::Scope scope("Busy");
+	}
+}
+
+// Cancels its token once it reaches element cancelIndex
+struct CancelAt
+{
+	CancelAt(const Olagarro::Concurrency::CancellationToken& token, int cancelIndex) :
+		token(token),
+		cancelIndex(cancelIndex)
+	{
+	}
+
+	void operator()(int index, float& value)
+	{
+		if(cancelIndex == index)
+		{
+			token.cancel();
+		}
+
+		value = 1.0f;
+	}
+
+	Olagarro::Concurrency::CancellationToken token;
+	int cancelIndex;
+};
+
+bool isJobCancelled(Olagarro::Concurrency::Future<float> value)
+{
+	return value.isCancelled();
+}
+
+float throwingJob()
+{
+	throw std::runtime_error("throwingJob");
+}
+
+float afterThrowingJob(Olagarro::Concurrency::Future<float> value)
+{
+	return value.result() + 1.0f;
+}
+
+float squareValue(float value)
+{
+	return value * value;
+}
+
+bool isOdd(int value)
+{
+	return 0 != value % 2;
+}
+
+// Associative but not commutative, so any reordering of partial results shows up
+std::string concatenate(const std::string& first, const std::string& second)
+{
+	return first + second;
+}
+
+struct Greater
+{
+	bool operator()(int first, int second) const
+	{
+		return first > second;
+	}
+};
+
+// Throws at the last element of every group of size elements
+struct ThrowEvery
+{
+	ThrowEvery(int size) :
+		size(size)
+	{
+	}
+
+	void operator()(int index, float& value)
+	{
+		if(size - 1 == index % size)
+		{
+			throw std::runtime_error("ThrowEvery");
+		}
+
+		value = 1.0f;
+	}
+
+	int size;
+};
+
+// Executes pending jobs at the first element, like a functor waiting for a future, and tells if a call started while another was running
+struct WaitingAccumulator
+{
+	WaitingAccumulator() :
+		running(0),
+		reentered(false),
+		count(0)
+	{
+	}
+
+	void operator()(int index, float& /*value*/)
+	{
+		if(0 < running ++)
+		{
+			reentered = true;
+		}
+
+		if(0 == index)
+		{
+			while(Olagarro::Concurrency::ThreadPool::executePendingJob())
+			{
+			}
+		}
+
+		++ count;
+		-- running;
+	}
+
+	void merge(const WaitingAccumulator& other)
+	{
+		reentered = reentered || other.reentered;
+		count += other.count;
+	}
+
+	int running;
+	bool reentered;
+	int count;
+};
+
+// Cancels its token and throws at the first element, so the rest of slices are cancelled
+struct CancelAndThrow
+{
+	explicit CancelAndThrow(const Olagarro::Concurrency::CancellationToken& token) :
+		token(token)
+	{
+	}
+
+	void operator()(int index, float& /*value*/)
+	{
+		if(0 == index)
+		{
+			token.cancel();
+			throw std::runtime_error("CancelAndThrow");
+		}
+	}
+
+	void merge(const CancelAndThrow&)
+	{
+	}
+
+	Olagarro::Concurrency::CancellationToken token;
+};
+
+#if defined(_TTHREAD_CPP11_)
+float sumThree(std::vector<float> values, float factor, const std::string& /*label*/)
+{
+	float sum = 0.0f;
+
+	for(std::size_t i = 0; i < values.size(); ++ i)
+	{
+		sum += values[i] * factor;
+	}
+
+	return sum;
+}
+
+int takeUnique(std::unique_ptr<int> value)
+{
+	return *value;
+}
+#endif
+
+class TestClass
+{
+public:
+	float ZeroParam()
+	{
+		return test();
+	}
+
+	float OneParamCopy(int /*a*/)
+	{
+		return test();
+	}
+
+	float OneParamConst(const std::string& /*a*/)
+	{
+		return test();
+	}
+
+	float OneParamNoConst(std::string& /*a*/)
+	{
+		return test();
+	}
+
+};
+
+
+int main(int /*argc*/, char** /*argv*/)
+{
+	using namespace Olagarro::Concurrency;
+
+	// Some tests are doable comparing values, others not, like the testVoid() call. Also if the app finishes (it takes less than 20 seconds in my machine)
+	// it passes the thread managing test by not getting blocked forever
+
+	const float testResult = test();
+
+	/////////////////////////////////////////////////////////////////
+	// FREE FUNCTIONS CALLS
+	/////////////////////////////////////////////////////////////////
+
+	std::cout << "--------------------------------------------------------\n";
+	std::cout << "Free functions tests\n";
+	std::cout << "--------------------------------------------------------\n";
+
+	// Test 1: float test() call
+	Future<float> test1 = launchJob(test);
+	assert(testResult == test1.result() && "Invalid returned value in test1");
+
+	// Test 2: void testVoid() call
+	Future<void> test2 = launchJob(testVoid);
+	test2.result();
+
+	// Test 3: float testParam(int param) call. It uses the copy version
+	Future<float> test3 = launchJob(testParam, 666);
+	test3.result();
+
+	assert(testResult == test3.result() && "Invalid returned value in test3");
+
+	// Test 4: float testParamVector(const std::vector<int>& param) call. It uses the const& version
+	Future<float> test4 = launchJob(testParamVector, std::vector<int>(10));
+	test4.result();
+
+	assert(testResult == test4.result() && "Invalid returned value in test4");
+
+	// Test 5: float testParamNoConst(std::vector<int>& param) call. It uses the no const& version
+	std::vector<int> testVector(10);
+	Future<float> test5 = launchJob(testParamNoConst, testVector);
+	test5.result();
+
+	assert(testResult == test5.result() && "Invalid returned value in test5");
+	assert(testVector.empty() && "Invalid testVector size in test5");
+
+	// Test 58: int readCopyCounter(const CopyCounter& param) call with a non const lvalue. It uses the const& version in every standard, which
+	// holds the parameter by reference
+	CopyCounter test58Counter(58);
+	const int copiesBeforeTest58 = CopyCounter::sCopyNumber;
+	Future<int> test58 = launchJob(readCopyCounter, test58Counter);
+
+	assert(58 == test58.result() && "Invalid returned value in test58");
+	assert(copiesBeforeTest58 == CopyCounter::sCopyNumber && "Parameter copied in test58");
+
+	std::cout << "OK" << std::endl;
+
+
+	/////////////////////////////////////////////////////////////////
+	// FUNCTOR TEST
+	/////////////////////////////////////////////////////////////////
+
+	std::cout << "--------------------------------------------------------\n";
+	std::cout << "Functor tests\n";
+	std::cout << "--------------------------------------------------------\n";
+
+	// Test 6: Call constant functor
+	Future<float> test6 = launchJob<float>(ConstFunctor());
+
+	assert(testResult == test6.result() && "Invalid returned value in test6");
+
+	// Test 7: Call no constant functor
+	NoConstFunctor noConstFunctor(200);
+	Future<float> test7 = launchJob<float>(noConstFunctor);
+
+	assert(testResult == test7.result() && "Invalid returned value in test7");
+
+	std::cout << "OK" << std::endl;
+
+
+	/////////////////////////////////////////////////////////////////
+	// MEMBER FUNCTIONS CALLS
+	/////////////////////////////////////////////////////////////////
+
+	std::cout << "--------------------------------------------------------\n";
+	std::cout << "Member function tests\n";
+	std::cout << "--------------------------------------------------------\n";
+
+	TestClass testClass;
+
+	Future<float> test8 = launchJob(testClass, &TestClass::ZeroParam);
+	test8.result();
+
+	assert(testResult == test8.result() && "Invalid returned value in test8");
+
+	Future<float> test9 = launchJob(testClass, &TestClass::OneParamCopy, 10);
+	test9.result();
+
+	assert(testResult == test9.result() && "Invalid returned value in test9");
+
+	Future<float> test10 = launchJob(testClass, &TestClass::OneParamConst, std::string("testString const&"));
+	test10.result();
+
+	assert(testResult == test10.result() && "Invalid returned value in test10");
+
+	std::string b("testString &");
+	Future<float> test11 = launchJob(testClass, &TestClass::OneParamNoConst, b);
+	test11.result();
+
+	assert(testResult == test11.result() && "Invalid returned value in test11");
+
+	// Test 12: Futures in a container
+	std::vector< Future<float> > resultsTest12(10);
+
+	for(std::size_t i = 0; i < resultsTest12.size(); ++ i)
+	{
+		resultsTest12[i] = launchJob(test);
+	}
+
+	// Jobs launched, wait for and check them
+	for(std::size_t i = 0; i < resultsTest12.size(); ++ i)
+	{
+		assert(testResult == resultsTest12[i].result() && "Invalid returned value in test12");
+	}
+
+	std::cout << "OK" << std::endl;
+
+#if defined(_TTHREAD_CPP11_)
+	/////////////////////////////////////////////////////////////////
+	// VARIADIC LAUNCHJOB
+	/////////////////////////////////////////////////////////////////
+
+	std::cout << "--------------------------------------------------------\n";
+	std::cout << "Variadic launchJob tests\n";
+	std::cout << "--------------------------------------------------------\n";
+
+	// Test 18: several parameters, the vector is moved into the job instead of copied
+	std::vector<float> bigBuffer(1000, 1.0f);
+	Future<float> test18 = launchJob(sumThree, std::move(bigBuffer), 2.0f, std::string("label"));
+
+	assert(bigBuffer.empty() && "Buffer not moved in test18");
+	assert(2000.0f == test18.result() && "Invalid returned value in test18");
+
+	// Test 19: lambdas and move-only parameters
+	Future<int> test19 = launchJob([](std::unique_ptr<int> a, int b) { return *a + b; }, std::unique_ptr<int>(new int(40)), 2);
+	Future<int> test19b = launchJob(takeUnique, std::unique_ptr<int>(new int(7)));
+
+	assert(42 == test19.result() && "Invalid returned value in test19");
+	assert(7 == test19b.result() && "Invalid returned value in test19");
+
+	// Test 20: member functions with instance as first parameter and references through std::ref
+	Future<float> test20 = launchJob(&TestClass::OneParamCopy, &testClass, 10);
+	std::vector<int> refVector(10);
+	Future<float> test20b = launchJob(testParamNoConst, std::ref(refVector));
+
+	assert(testResult == test20.result() && "Invalid returned value in test20");
+	assert(testResult == test20b.result() && refVector.empty() && "Invalid returned value in test20");
+
+	std::cout << "OK" << std::endl;
+#endif
+
+	/////////////////////////////////////////////////////////////////
+	// CONCURRENT FOR CALLS
+	/////////////////////////////////////////////////////////////////
+
+	const int ValueNumber = 1024 * 1024;
+	std::vector<float> values;
+	values.reserve(ValueNumber);
+
+	std::cout << "--------------------------------------------------------\n";
+	std::cout << "concurrentFor() tests\n";
+	std::cout << "--------------------------------------------------------\n";
+
+	for(int i = 0; i < ValueNumber; ++ i)
+	{
+		values.push_back(i);
+	}
+
+	// Test 13: concurrentFor call
+	Future<void> test13 = concurrentFor(values.begin(), values.end(), Multiply(10));
+	test13.result();
+
+	for(std::size_t i = 0; i < values.size(); ++ i)
+	{
+		assert(values[i] == i * 10 && "Invalid value in test13");
+	}
+
+	// Test 13: concurrentReductor call
+	Future<FindMax> test14 = concurrentReductorFor(values.begin(), values.end(), FindMax());
+
+	assert(test14.result().maxValue == values.back() && "Invalid value in test14");
+
+	std::cout << "OK" << std::endl;
+
+	/////////////////////////////////////////////////////////////////
+	// NESTED JOBS
+	/////////////////////////////////////////////////////////////////
+
+	std::cout << "--------------------------------------------------------\n";
+	std::cout << "Nested jobs tests\n";
+	std::cout << "--------------------------------------------------------\n";
+
+	// Test 15: more jobs waiting for other jobs than JobThreads. Waiting JobThreads execute pending jobs instead of blocking, otherwise this would never end
+	std::vector< Future<float> > resultsTest15(HardwareThreadNumber * 4);
+
+	for(std::size_t i = 0; i < resultsTest15.size(); ++ i)
+	{
+		resultsTest15[i] = launchJob(nestedConcurrentFor);
+	}
+
+	for(std::size_t i = 0; i < resultsTest15.size(); ++ i)
+	{
+		assert(2.0f * 1024 == resultsTest15[i].result() && "Invalid returned value in test15");
+	}
+
+	std::cout << "OK" << std::endl;
+
+	/////////////////////////////////////////////////////////////////
+	// PARTITIONERS
+	/////////////////////////////////////////////////////////////////
+
+	std::cout << "--------------------------------------------------------\n";
+	std::cout << "Partitioner tests\n";
+	std::cout << "--------------------------------------------------------\n";
+
+	// Test 16: every partitioner must visit every element exactly once
+	Partitioner partitioners[] = { staticPartitioner(), staticPartitioner(1000), fixedGrainPartitioner(777), adaptivePartitioner(), adaptivePartitioner(500),
+								   dynamicPartitioner(), dynamicPartitioner(333) };
+
+	for(std::size_t p = 0; p < sizeof(partitioners) / sizeof(partitioners[0]); ++ p)
+	{
+		std::vector<float> ones(100003, 1.0f);
+
+		concurrentFor(ones.begin(), ones.end(), Multiply(3), partitioners[p]).result();
+
+		for(std::size_t i = 0; i < ones.size(); ++ i)
+		{
+			assert(3.0f == ones[i] && "Invalid value in test16");
+		}
+
+		Future<FindMax> maxFuture = concurrentReductorFor(values.begin(), values.end(), FindMax(), partitioners[p]);
+
+		assert(maxFuture.result().maxValue == values.back() && "Invalid reduction in test16");
+	}
+
+	// Test 17: ranges not bigger than grain size are executed by calling thread, so they are done before concurrentFor returns
+	std::vector<float> fewValues(100, 1.0f);
+	Future<void> test17 = concurrentFor(fewValues.begin(), fewValues.end(), Multiply(2), staticPartitioner(fewValues.size()));
+
+	for(std::size_t i = 0; i < fewValues.size(); ++ i)
+	{
+		assert(2.0f == fewValues[i] && "Invalid value in test17");
+	}
+
+	test17.result();
+
+	// Test 63: Dynamic partitioning launches one slice per JobThread of the pool, and huge ranges and grain sizes do not overflow
+	assert(2 == dynamicPartitioner(1).initialSliceNumber(1000, 2) && 16 == dynamicPartitioner(1).initialSliceNumber(1000, 16) &&
+		   "Invalid Dynamic slice number in test63");
+	assert(2 == dynamicPartitioner(4000000000u).initialSliceNumber(4294967295u, 8) && "Overflow in test63");
+
+	// Test 65: FixedGrain slices have exactly grain size elements but the last one, Static slices are never smaller than the grain
+	std::vector<float> tenValues(10, 1.0f);
+	SliceSizes test65 = concurrentReductorFor(tenValues.begin(), tenValues.end(), SliceSizes(), fixedGrainPartitioner(4)).result();
+
+	// The result is a copy of the functor given, which executed no slice, merged with slices' ones
+	if(0 != test65.size)
+	{
+		test65.sizes.push_back(test65.size);
+	}
+
+	std::sort(test65.sizes.begin(), test65.sizes.end());
+
+	assert(3 == test65.sizes.size() && 2 == test65.sizes[0] && 4 == test65.sizes[1] && 4 == test65.sizes[2] && "Invalid FixedGrain slices in test65");
+	assert(1 == staticPartitioner(4).initialSliceNumber(7) && "Static slice smaller than grain in test65");
+
+	// Test 66: Static slices and Adaptive splits depend on how many JobThreads the pool has, not on hardware threads
+	assert(2 == staticPartitioner(4).initialSliceNumber(10, 8) && 8 == staticPartitioner(1).initialSliceNumber(1000, 8) &&
+		   "Static slices not one per JobThread of the pool in test66");
+	assert(adaptivePartitioner().initialSplitDepth(1) < adaptivePartitioner().initialSplitDepth(8) && "Invalid Adaptive split depth in test66");
+
+	std::cout << "OK" << std::endl;
+
+	/////////////////////////////////////////////////////////////////
+	// CONTINUATIONS
+	/////////////////////////////////////////////////////////////////
+
+	std::cout << "--------------------------------------------------------\n";
+	std::cout << "Continuation tests\n";
+	std::cout << "--------------------------------------------------------\n";
+
+	// Test 21: chained stages, then() on a not yet ready future and on an already ready one
+	Future<float> test21 = launchJob(test).then(doubleValue).then(doubleValue);
+	assert(test() * 4.0f == test21.result() && "Invalid returned value in test21");
+	assert(test() * 8.0f == test21.then(doubleValue).result() && "Invalid returned value in test21");
+
+	std::vector<float> continuationValues(10000, 1.0f);
+	Future<int> test21Void = concurrentFor(continuationValues.begin(), continuationValues.end(), Multiply(2)).then(afterVoid);
+	assert(1 == test21Void.result() && 2.0f == continuationValues.back() && "Invalid returned value in test21");
+
+	// Test 22: whenAll is ready once every future is
+	std::vector< Future<float> > test22(HardwareThreadNumber * 4);
+
+	for(std::size_t i = 0; i < test22.size(); ++ i)
+	{
+		test22[i] = launchJob(test);
+	}
+
+	std::vector< Future<float> > allReady = whenAll(test22).result();
+	assert(test22.size() == allReady.size() && "Invalid future number in test22");
+
+	for(std::size_t i = 0; i < allReady.size(); ++ i)
+	{
+		assert(test() == allReady[i].result() && "Invalid returned value in test22");
+	}
+
+	assert(whenAll(std::vector< Future<float> >()).result().empty() && "Invalid empty whenAll in test22");
+
+	// Test 23: whenAny is ready with the index of a ready future
+	std::size_t anyReady = whenAny(test22).result();
+	assert(anyReady < test22.size() && test() == test22[anyReady].result() && "Invalid returned value in test23");
+	assert(0 == whenAny(std::vector< Future<float> >()).result() && "Invalid empty whenAny in test23");
+
+	// Test 59: default constructed futures have no operation to wait for, whenAll and whenAny take them as ready
+	std::vector< Future<float> > test59(2);
+	test59[0] = launchJob(test);
+
+	assert(2 == whenAll(test59).result().size() && test() == test59[0].result() && "Invalid whenAll with a null future in test59");
+	assert(0 == whenAny(std::vector< Future<float> >(1)).result() && "Invalid whenAny with a null future in test59");
+
+#if defined(_TTHREAD_CPP11_)
+	// Test 24: any callable can be a continuation, also on composed futures
+	Future<float> test24 = whenAll(test22).then([](Future< std::vector< Future<float> > > all)
+	{
+		float sum = 0.0f;
+
+		for(const Future<float>& value : all.result())
+		{
+			sum += value.result();
+		}
+
+		return sum;
+	});
+
+	float expectedTest24 = 0.0f;
+
+	for(std::size_t i = 0; i < test22.size(); ++ i)
+	{
+		expectedTest24 += test();
+	}
+
+	assert(expectedTest24 == test24.result() && "Invalid returned value in test24");
+#endif
+
+	std::cout << "OK" << std::endl;
+
+	/////////////////////////////////////////////////////////////////
+	// TIMED WAITS
+	/////////////////////////////////////////////////////////////////
+
+	std::cout << "--------------------------------------------------------\n";
+	std::cout << "Timed wait tests\n";
+	std::cout << "--------------------------------------------------------\n";
+
+	// Test 25: polling and bounded waits return false until the value is ready, and don't need to wait the whole time once it is
+	Future<int> test25 = launchJob(slowJob);
+	assert(!test25.isReady() && "Future ready too early in test25");
+
+	Clock::TimePoint waitStart = Clock::now();
+	assert(!test25.waitFor(tthread::chrono::milliseconds(20)) && "Future ready too early in test25");
+	assert(Clock::now() - waitStart >= 20000000ull && "waitFor returned too early in test25");
+
+	assert(test25.waitUntil(Clock::now() + 10000000000ull) && test25.isReady() && 7 == test25.result() && "Future not ready in test25");
+	assert(test25.waitFor(tthread::chrono::seconds(0)) && "Ready future timed out in test25");
+
+#if defined(_TTHREAD_CPP11_)
+	// Test 26: std::chrono durations and time points
+	Future<int> test26 = launchJob(slowJob);
+	assert(!test26.waitFor(std::chrono::milliseconds(1)) && "Future ready too early in test26");
+	assert(test26.waitUntil(std::chrono::steady_clock::now() + std::chrono::seconds(10)) && 7 == test26.result() && "Future not ready in test26");
+#endif
+
+	std::cout << "OK" << std::endl;
+
+	/////////////////////////////////////////////////////////////////
+	// RESULT ACCESS
+	/////////////////////////////////////////////////////////////////
+
+	std::cout << "--------------------------------------------------------\n";
+	std::cout << "Result access tests\n";
+	std::cout << "--------------------------------------------------------\n";
+
+	// Test 27: results without default constructor, read through a reference without copying them
+	Future<CopyCounter> test27 = launchJob(makeCopyCounter);
+	test27.waitUntil(Clock::now() + 10000000000ull);
+
+	const int copiesBeforeAccess = CopyCounter::sCopyNumber;
+	const CopyCounter& counterReference = test27.resultReference();
+
+	assert(5 == counterReference.value() && &counterReference == &test27.resultReference() && "Invalid reference in test27");
+	assert(copiesBeforeAccess == CopyCounter::sCopyNumber && "Result copied in test27");
+	assert(5 == test27.result().value() && copiesBeforeAccess + 1 == CopyCounter::sCopyNumber && "Invalid copy in test27");
+
+#if defined(_TTHREAD_CPP11_)
+	// Test 28: move only results are taken out of the future
+	Future< std::unique_ptr< std::vector<int> > > test28 = launchJob([]()
+	{
+		return std::unique_ptr< std::vector<int> >(new std::vector<int>(1000, 3));
+	});
+
+	const std::vector<int>* storedVector = test28.resultReference().get();
+	std::unique_ptr< std::vector<int> > takenVector = test28.take();
+
+	assert(storedVector == takenVector.get() && 3 == takenVector->back() && "Invalid taken result in test28");
+	assert(!test28.resultReference() && "Result not moved in test28");
+#endif
+
+	std::cout << "OK" << std::endl;
+
+	/////////////////////////////////////////////////////////////////
+	// THREAD POOLS
+	/////////////////////////////////////////////////////////////////
+
+	std::cout << "--------------------------------------------------------\n";
+	std::cout << "Thread pool tests\n";
+	std::cout << "--------------------------------------------------------\n";
+
+	// Test 29: jobs launched inside a Scope run in its pool, and so do the jobs and continuations they launch
+	{
+		ThreadPool twoThreadPool(2);
+		assert(2 == twoThreadPool.threadNumber() && "Invalid thread number in test29");
+
+		Future<ThreadPool*> test29Outer = launchJob(currentPool);
+
+		{
+			ThreadPool::Scope scope(twoThreadPool);
+
+			assert(&twoThreadPool == launchJob(currentPool).result() && "Job not run in scope's pool in test29");
+			assert(2.0f * 1024 == launchJob(nestedConcurrentFor).result() && "Invalid nested result in test29");
+
+			{
+				ThreadPool::Scope innerScope(ThreadPool::instance());
+				assert(&ThreadPool::instance() == launchJob(currentPool).result() && "Job not run in inner scope's pool in test29");
+			}
+
+			std::vector< Future<float> > resultsTest29(8);
+
+			for(std::size_t i = 0; i < resultsTest29.size(); ++ i)
+			{
+				resultsTest29[i] = launchJob(nestedConcurrentFor).then(doubleValue);
+			}
+
+			for(std::size_t i = 0; i < resultsTest29.size(); ++ i)
+			{
+				assert(4.0f * 1024 == resultsTest29[i].result() && "Invalid continuation result in test29");
+			}
+		}
+
+		assert(&ThreadPool::instance() == test29Outer.result() && &ThreadPool::instance() == launchJob(currentPool).result() && "Job not run in default pool in test29");
+	}
+
+	// Test 60: continuations run in the pool current when they are added, not in the one which completes their antecedent
+	{
+		ThreadPool twoThreadPool(2);
+		Future<int> antecedent = launchJob(slowJob);
+
+		ThreadPool::Scope scope(twoThreadPool);
+		Future<ThreadPool*> pending = antecedent.then(continuationPool);
+
+		assert(&twoThreadPool == pending.result() && "Pending continuation not run in its pool in test60");
+		assert(&twoThreadPool == antecedent.then(continuationPool).result() && "Ready continuation not run in its pool in test60");
+	}
+
+	// Test 30: JobThreads pinned to a CPU
+	{
+		ThreadPool pinnedPool(1, std::vector<unsigned>(1, 0));
+		ThreadPool::Scope scope(pinnedPool);
+
+		assert(&pinnedPool == launchJob(currentPool).result() && "Job not run in pinned pool in test30");
+	}
+
+	// Test 31: NUMA topology parsing, and a pool spanning two (fake) nodes binds concurrentFor slices to them
+	std::vector<unsigned> cpuList = NumaTopology::parseCpuList("0-3,8,10-11\n");
+	unsigned expectedCpus[] = { 0, 1, 2, 3, 8, 10, 11 };
+
+	assert(std::vector<unsigned>(expectedCpus, expectedCpus + 7) == cpuList && "Invalid cpu list in test31");
+	assert(NumaTopology::parseCpuList("").empty() && "Invalid empty cpu list in test31");
+	assert(0 < NumaTopology::system().nodeNumber() && !NumaTopology::system().node(0).cpus.empty() && "Invalid system topology in test31");
+
+	{
+		std::vector<NumaTopology::Node> nodes(2);
+		nodes[0].id = 0;
+		nodes[0].cpus = NumaTopology::system().node(0).cpus;
+		nodes[1].id = 1;
+		nodes[1].cpus = NumaTopology::system().node(0).cpus;
+
+		ThreadPool twoNodePool(4, std::vector<unsigned>(), NumaTopology(nodes));
+		ThreadPool::Scope scope(twoNodePool);
+
+		assert(2 == twoNodePool.nodeNumber() && "Invalid node number in test31");
+
+		for(std::size_t p = 0; p < sizeof(partitioners) / sizeof(partitioners[0]); ++ p)
+		{
+			std::vector<float> ones(100003, 1.0f);
+
+			concurrentFor(ones.begin(), ones.end(), Multiply(3), partitioners[p]).result();
+
+			for(std::size_t i = 0; i < ones.size(); ++ i)
+			{
+				assert(3.0f == ones[i] && "Invalid value in test31");
+			}
+
+			assert(concurrentReductorFor(values.begin(), values.end(), FindMax(), partitioners[p]).result().maxValue == values.back() && "Invalid reduction in test31");
+		}
+
+		assert(2.0f * 1024 == launchJob(nestedConcurrentFor).result() && "Invalid nested result in test31");
+	}
+
+	std::cout << "OK" << std::endl;
+
+	/////////////////////////////////////////////////////////////////
+	// PRIORITIES
+	/////////////////////////////////////////////////////////////////
+
+	std::cout << "--------------------------------------------------------\n";
+	std::cout << "Priority tests\n";
+	std::cout << "--------------------------------------------------------\n";
+
+	// Test 32: high priority jobs go before normal ones and these before background ones, but background ones are not starved
+	{
+		ThreadPool onePool(1);
+		ThreadPool::Scope scope(onePool);
+
+		closeGate();
+		executionOrder.store(0);
+
+		std::vector< Future<int> > background(100);
+		std::vector< Future<int> > normal(100);
+		Future<int> high;
+
+		{
+			Job::PriorityScope priorityScope(BackgroundPriority);
+
+			for(std::size_t i = 0; i < background.size(); ++ i)
+			{
+				background[i] = launchJob(recordOrder);
+			}
+		}
+
+		for(std::size_t i = 0; i < normal.size(); ++ i)
+		{
+			normal[i] = launchJob(recordOrder);
+		}
+
+		{
+			Job::PriorityScope priorityScope(HighPriority);
+			high = launchJob(recordOrder);
+		}
+
+		gateReleased.store(1);
+
+		assert(0 == high.result() && "High priority job not executed first in test32");
+
+		int lastNormal = 0;
+		int firstBackground = static_cast<int>(background.size() + normal.size());
+		int normalSum = 0;
+		int backgroundSum = 0;
+
+		for(std::size_t i = 0; i < normal.size(); ++ i)
+		{
+			lastNormal = std::max(lastNormal, normal[i].result());
+			firstBackground = std::min(firstBackground, background[i].result());
+			normalSum += normal[i].result();
+			backgroundSum += background[i].result();
+		}
+
+		assert(normalSum < backgroundSum && "Normal priority jobs not executed before background ones in test32");
+		assert(firstBackground < lastNormal && "Background jobs starved in test32");
+	}
+
+	// Test 33: jobs with deadline go first, earliest deadline first
+	{
+		ThreadPool onePool(1);
+		ThreadPool::Scope scope(onePool);
+
+		closeGate();
+		executionOrder.store(0);
+
+		Future<int> noDeadline = launchJob(recordOrder);
+		Future<int> lateDeadline;
+		Future<int> earlyDeadline;
+
+		{
+			Job::PriorityScope priorityScope(NormalPriority, Clock::now() + 10000000000ull);
+			lateDeadline = launchJob(recordOrder);
+		}
+
+		{
+			Job::PriorityScope priorityScope(BackgroundPriority, Clock::now() + 1000000000ull);
+			earlyDeadline = launchJob(recordOrder);
+		}
+
+		gateReleased.store(1);
+
+		assert(0 == earlyDeadline.result() && 1 == lateDeadline.result() && 2 == noDeadline.result() && "Invalid deadline order in test33");
+	}
+
+	// Test 61: jobs with deadline and high priority jobs launched by a running job go to their queues, before its normal priority local jobs
+	{
+		ThreadPool onePool(1);
+		ThreadPool::Scope scope(onePool);
+
+		executionOrder.store(0);
+
+		std::vector< Future<int> > nested = launchJob(launchNestedPriorities).result();
+
+		assert(2 == nested[2].result() && nested[0].result() < 2 && nested[1].result() < 2 && "Invalid nested priority order in test61");
+	}
+
+	std::cout << "OK" << std::endl;
+
+	/////////////////////////////////////////////////////////////////
+	// CANCELLATION
+	/////////////////////////////////////////////////////////////////
+
+	std::cout << "--------------------------------------------------------\n";
+	std::cout << "Cancellation tests\n";
+	std::cout << "--------------------------------------------------------\n";
+
+	// Test 34: jobs cancelled before starting are dropped and their futures are ready and cancelled
+	{
+		ThreadPool onePool(1);
+		ThreadPool::Scope scope(onePool);
+
+		closeGate();
+
+		CancellationToken token;
+		Future<float> cancelled;
+		std::vector<float> untouched(10000, 1.0f);
+		Future<void> cancelledFor;
+
+		{
+			CancellationToken::Scope cancellationScope(token);
+
+			cancelled = launchJob(test);
+			cancelledFor = concurrentFor(untouched.begin(), untouched.end(), Multiply(2));
+		}
+
+		Future<bool> continuation = cancelled.then(isJobCancelled);
+		Future<float> notCancelled = launchJob(test);
+
+		token.cancel();
+		gateReleased.store(1);
+
+		assert(continuation.result() && cancelled.isReady() && cancelled.isCancelled() && "Job not cancelled in test34");
+		assert(!notCancelled.isCancelled() && test() == notCancelled.result() && "Job without token cancelled in test34");
+
+		bool thrown = false;
+
+		try
+		{
+			cancelled.result();
+		}
+		catch(const JobCancelled&)
+		{
+			thrown = true;
+		}
+
+		assert(thrown && "Cancelled result did not throw in test34");
+
+		cancelledFor.waitUntil(Clock::now() + 10000000000ull);
+		assert(cancelledFor.isCancelled() && "concurrentFor not cancelled in test34");
+
+		for(std::size_t i = 0; i < untouched.size(); ++ i)
+		{
+			assert(1.0f == untouched[i] && "Cancelled slice executed in test34");
+		}
+	}
+
+	// Test 35: running concurrentFor slices stop soon after cancelling
+	{
+		ThreadPool onePool(1);
+		ThreadPool::Scope scope(onePool);
+
+		CancellationToken token;
+		std::vector<float> zeros(100000, 0.0f);
+		Future<void> test35;
+
+		{
+			CancellationToken::Scope cancellationScope(token);
+			test35 = concurrentFor(zeros.begin(), zeros.end(), CancelAt(token, 1000), fixedGrainPartitioner(zeros.size() / 2));
+		}
+
+		test35.waitUntil(Clock::now() + 10000000000ull);
+		assert(test35.isCancelled() && "concurrentFor not cancelled in test35");
+		assert(1.0f == zeros[1000] && 0.0f == zeros[2000] && 0.0f == zeros.back() && "Slices not stopped in test35");
+	}
+
+	// Test 62: a concurrentFor cancelled once its last element is done is complete, not cancelled
+	{
+		ThreadPool onePool(1);
+		ThreadPool::Scope scope(onePool);
+
+		CancellationToken token;
+		std::vector<float> zeros(1000, 0.0f);
+		Future<void> test62;
+
+		{
+			CancellationToken::Scope cancellationScope(token);
+			test62 = concurrentFor(zeros.begin(), zeros.end(), CancelAt(token, static_cast<int>(zeros.size()) - 1), fixedGrainPartitioner(zeros.size()));
+		}
+
+		test62.result();
+		assert(token.isCancelled() && !test62.isCancelled() && 1.0f == zeros.front() && 1.0f == zeros.back() && "Complete concurrentFor cancelled in test62");
+	}
+
+	std::cout << "---------------------------------------------------------------------\n";
+	std::cout << "Exception tests\n";
+
+	// Test 36: an exception thrown by a job is thrown by result() and its continuations, and JobThreads survive it
+	{
+		Future<float> failed = launchJob(throwingJob);
+		Future<float> continuation = failed.then(afterThrowingJob);
+
+		bool thrown = false;
+		try
+		{
+			failed.result();
+		}
+		catch(const std::exception& exception)
+		{
+			thrown = std::string("throwingJob") == exception.what();
+		}
+
+		assert(thrown && failed.isFailed() && !failed.isCancelled() && "Exception not thrown by result() in test36");
+
+		thrown = false;
+		try
+		{
+			continuation.result();
+		}
+		catch(const std::exception& exception)
+		{
+			thrown = std::string("throwingJob") == exception.what();
+		}
+
+		assert(thrown && continuation.isFailed() && "Exception not propagated to continuation in test36");
+		assert(test() == launchJob(test).result() && "ThreadPool broken after an exception in test36");
+	}
+
+	// Test 37: exceptions of concurrentFor slices are gathered, the rest of slices go on
+	{
+		std::vector<float> values(1000, 0.0f);
+		Future<void> test37 = concurrentFor(values.begin(), values.end(), ThrowEvery(250), fixedGrainPartitioner(250));
+
+		std::size_t exceptionNumber = 0;
+		try
+		{
+			test37.result();
+		}
+		catch(const AggregateException& exception)
+		{
+			exceptionNumber = exception.exceptionNumber();
+
+			bool thrown = false;
+			try
+			{
+				exception.rethrow(0);
+			}
+			catch(const std::exception& sliceException)
+			{
+				thrown = std::string("ThrowEvery") == sliceException.what();
+			}
+
+			assert(thrown && "Slice exception lost in test37");
+		}
+
+		assert(4 == exceptionNumber && test37.isFailed() && "Slice exceptions not gathered in test37");
+		assert(1.0f == values[248] && 0.0f == values[249] && 1.0f == values[998] && 0.0f == values[999] && "Slices not stopped at their exception in test37");
+	}
+
+	// Test 67: a concurrentFor or concurrentReductorFor which failed is failed, not cancelled, even if some slices were cancelled
+	{
+		ThreadPool onePool(1);
+		ThreadPool::Scope scope(onePool);
+
+		std::vector<float> values(10, 0.0f);
+		CancellationToken forToken;
+		CancellationToken reductorToken;
+		Future<void> failedFor;
+		Future<CancelAndThrow> failedReductor;
+
+		{
+			CancellationToken::Scope cancellationScope(forToken);
+			failedFor = concurrentFor(values.begin(), values.end(), CancelAndThrow(forToken), fixedGrainPartitioner(1));
+		}
+
+		{
+			CancellationToken::Scope cancellationScope(reductorToken);
+			failedReductor = concurrentReductorFor(values.begin(), values.end(), CancelAndThrow(reductorToken), fixedGrainPartitioner(1));
+		}
+
+		bool forThrown = false;
+		try
+		{
+			failedFor.result();
+		}
+		catch(const AggregateException&)
+		{
+			forThrown = true;
+		}
+
+		bool reductorThrown = false;
+		try
+		{
+			failedReductor.result();
+		}
+		catch(const AggregateException&)
+		{
+			reductorThrown = true;
+		}
+
+		assert(forThrown && failedFor.isFailed() && !failedFor.isCancelled() && "concurrentFor exception hidden by cancellation in test67");
+		assert(reductorThrown && failedReductor.isFailed() && !failedReductor.isCancelled() &&
+			   "concurrentReductorFor exception hidden by cancellation in test67");
+	}
+
+	std::cout << "---------------------------------------------------------------------\n";
+	std::cout << "Parallel algorithm tests\n";
+
+	{
+		// Several JobThreads and small grains, so ranges are divided in many blocks even in machines with few CPUs
+		ThreadPool fourPool(4);
+		ThreadPool::Scope scope(fourPool);
+
+		std::vector<int> integers(100003);
+
+		for(std::size_t i = 0; i < integers.size(); ++ i)
+		{
+			integers[i] = static_cast<int>((i * 7919) % 10007);
+		}
+
+		// Test 38: parallelTransform
+		std::vector<float> values(10000);
+
+		for(std::size_t i = 0; i < values.size(); ++ i)
+		{
+			values[i] = static_cast<float>(i % 100);
+		}
+
+		std::vector<float> squares(values.size());
+		assert(squares.end() == parallelTransform(values.begin(), values.end(), squares.begin(), squareValue, staticPartitioner(100)) &&
+			   "Wrong end iterator in test38");
+
+		for(std::size_t i = 0; i < values.size(); ++ i)
+		{
+			assert(values[i] * values[i] == squares[i] && "Wrong value in test38");
+		}
+
+		// Test 39: parallelReduce keeps the order of a non commutative operation
+		std::vector<std::string> letters(1000);
+
+		for(std::size_t i = 0; i < letters.size(); ++ i)
+		{
+			letters[i] = std::string(1, static_cast<char>('a' + i % 26));
+		}
+
+		const std::string Concatenated = parallelReduce(letters.begin(), letters.end(), std::string(), concatenate, staticPartitioner(10));
+		assert(std::accumulate(letters.begin(), letters.end(), std::string()) == Concatenated && "Wrong reduction in test39");
+		assert(std::accumulate(integers.begin(), integers.end(), 0LL) == parallelReduce(integers.begin(), integers.end(), 0LL) &&
+			   "Wrong sum in test39");
+		assert(7 == parallelReduce(integers.begin(), integers.begin(), 7) && "Wrong empty reduction in test39");
+
+		// Test 40: inclusive and exclusive scans, the second one in place
+		std::vector<long long> expected(integers.size());
+		std::partial_sum(integers.begin(), integers.end(), expected.begin(), std::plus<long long>());
+
+		std::vector<long long> scanned(integers.size());
+		parallelInclusiveScan(integers.begin(), integers.end(), scanned.begin(), std::plus<long long>(), staticPartitioner(1000));
+		assert(expected == scanned && "Wrong inclusive scan in test40");
+
+		std::vector<long long> inPlace(integers.begin(), integers.end());
+		parallelExclusiveScan(inPlace.begin(), inPlace.end(), inPlace.begin(), 5LL, std::plus<long long>(), staticPartitioner(1000));
+		assert(5 == inPlace[0] && "Wrong exclusive scan in test40");
+
+		for(std::size_t i = 1; i < inPlace.size(); ++ i)
+		{
+			assert(expected[i - 1] + 5 == inPlace[i] && "Wrong exclusive scan in test40");
+		}
+
+		// Test 41: parallelCopyIf keeps elements' order
+		std::vector<int> odds;
+
+		for(std::size_t i = 0; i < integers.size(); ++ i)
+		{
+			if(isOdd(integers[i]))
+			{
+				odds.push_back(integers[i]);
+			}
+		}
+
+		std::vector<int> copied(integers.size(), -1);
+		std::vector<int>::iterator copiedEnd = parallelCopyIf(integers.begin(), integers.end(), copied.begin(), isOdd, staticPartitioner(1000));
+		assert(odds.size() == static_cast<std::size_t>(copiedEnd - copied.begin()) && std::equal(odds.begin(), odds.end(), copied.begin()) &&
+			   -1 == *copiedEnd && "Wrong copy in test41");
+
+		// Test 42: parallelSort with both the default and a custom comparison, for many sizes so the number of blocks is odd and even
+		for(std::size_t size = 0; size < 5000; size = size * 3 + 1)
+		{
+			std::vector<int> sorted(integers.begin(), integers.begin() + size);
+			std::vector<int> reference(sorted);
+
+			parallelSort(sorted.begin(), sorted.end(), std::less<int>(), staticPartitioner(10));
+			std::sort(reference.begin(), reference.end());
+			assert(reference == sorted && "Wrong sort in test42");
+
+			parallelSort(sorted.begin(), sorted.end(), Greater(), fixedGrainPartitioner(7));
+			std::reverse(reference.begin(), reference.end());
+			assert(reference == sorted && "Wrong descending sort in test42");
+		}
+
+		std::vector<int> sorted(integers);
+		parallelSort(sorted.begin(), sorted.end());
+		assert(sorted.end() == std::adjacent_find(sorted.begin(), sorted.end(), Greater()) && "Wrong big sort in test42");
+	}
+
+	std::cout << "---------------------------------------------------------------------\n";
+	std::cout << "Reduction tests\n";
+
+	// Test 43: slice and thread accumulators give the same reduction, the second one with a copy per thread instead of one per slice
+	{
+		ThreadPool fourPool(4);
+		ThreadPool::Scope scope(fourPool);
+
+		std::vector<int> integers(100000);
+
+		for(std::size_t i = 0; i < integers.size(); ++ i)
+		{
+			integers[i] = static_cast<int>(i);
+		}
+
+		const Histogram BySlice = concurrentReductorFor(integers.begin(), integers.end(), Histogram(), fixedGrainPartitioner(100)).result();
+		const Histogram ByThread = concurrentReductorFor(integers.begin(), integers.end(), Histogram(), fixedGrainPartitioner(100),
+														 ThreadAccumulators).result();
+
+		for(std::size_t i = 0; i < BySlice.counts.size(); ++ i)
+		{
+			assert(static_cast<int>(integers.size() / 16) == BySlice.counts[i] && BySlice.counts == ByThread.counts && "Wrong histogram in test43");
+		}
+
+		assert(1001 == BySlice.copies && "Slice functors not merged in test43");
+		// Merged as a tree: 10 levels for 1000 slices, up to 10 merges of what is left in every level and the merge into the original functor
+		assert(21 >= BySlice.depth && "Slice functors not merged as a tree in test43");
+		// JobThreads plus the calling thread, plus the original functor
+		assert(6 >= ByThread.copies && 2 <= ByThread.copies && "Thread functors not merged in test43");
+	}
+
+	// Test 68: slices a JobThread executes while one of its slices waits do not use the waiting slice's thread accumulator
+	{
+		ThreadPool onePool(1);
+		ThreadPool::Scope scope(onePool);
+
+		std::vector<float> values(8, 0.0f);
+		const WaitingAccumulator Waiting = concurrentReductorFor(values.begin(), values.end(), WaitingAccumulator(), fixedGrainPartitioner(1),
+																 ThreadAccumulators).result();
+
+		assert(!Waiting.reentered && 8 == Waiting.count && "Thread accumulator used by two slices at once in test68");
+	}
+
+	std::cout << "---------------------------------------------------------------------\n";
+	std::cout << "Tiled concurrentFor tests\n";
+
+	// Test 44: concurrentFor2D visits every element once, with tiles not dividing the grid exactly too
+	{
+		const unsigned Rows = 301;
+		const unsigned Columns = 517;
+
+		for(unsigned tileSize = 1; tileSize < 1000; tileSize *= 7)
+		{
+			std::vector<int> grid(Rows * Columns, 0);
+			concurrentFor2D(Rows, Columns, tileSize, CountVisits(grid, Rows, Columns)).result();
+
+			assert(std::count(grid.begin(), grid.end(), 1) == static_cast<int>(grid.size()) && "Wrong visits in test44");
+		}
+	}
+
+	// Test 45: concurrentFor3D visits every element once
+	{
+		const unsigned Layers = 37;
+		const unsigned Rows = 29;
+		const unsigned Columns = 53;
+
+		std::vector<int> grid(Layers * Rows * Columns, 0);
+		concurrentFor3D(Layers, Rows, Columns, 8, CountVisits(grid, Rows, Columns), adaptivePartitioner()).result();
+
+		assert(std::count(grid.begin(), grid.end(), 1) == static_cast<int>(grid.size()) && "Wrong visits in test45");
+	}
+
+	// Test 69: tiles bigger than the grid, up to the biggest unsigned, do not overflow
+	{
+		const unsigned HugeTile = std::numeric_limits<unsigned>::max();
+
+		std::vector<int> grid(10 * 10, 0);
+		concurrentFor2D(10, 10, HugeTile, CountVisits(grid, 10, 10)).result();
+		assert(std::count(grid.begin(), grid.end(), 1) == static_cast<int>(grid.size()) && "Wrong 2D visits in test69");
+
+		std::vector<int> cube(10 * 10 * 10, 0);
+		concurrentFor3D(10, 10, 10, HugeTile, CountVisits(cube, 10, 10)).result();
+		assert(std::count(cube.begin(), cube.end(), 1) == static_cast<int>(cube.size()) && "Wrong 3D visits in test69");
+
+		const unsigned HalfTile = HugeTile / 2 + 1;
+		assert(1 == tileNumber(HugeTile, HugeTile) && 2 == tileNumber(HugeTile, HalfTile) && HugeTile == tileEnd(HalfTile, HalfTile, HugeTile) &&
+			   "Overflow in test69");
+	}
+
+	std::cout << "---------------------------------------------------------------------\n";
+	std::cout << "Forward range tests\n";
+
+	// Test 46: concurrentFor over a std::list gives every element its index, also when chunks have to grow during the walk
+	{
+		ThreadPool fourPool(4);
+		ThreadPool::Scope scope(fourPool);
+
+		for(int size = 0; size < 20000; size = size * 5 + 3)
+		{
+			std::list<float> values(size, -1.0f);
+			concurrentFor(values.begin(), values.end(), storeIndex, fixedGrainPartitioner(10)).result();
+
+			int index = 0;
+			for(std::list<float>::const_iterator it = values.begin(); it != values.end(); ++ it, ++ index)
+			{
+				assert(static_cast<float>(index) == *it && "Wrong index in test46");
+			}
+		}
+	}
+
+	// Test 47: concurrentFor over a std::map
+	{
+		std::map<int, int> values;
+
+		for(int i = 0; i < 5000; ++ i)
+		{
+			values[i * 3] = 0;
+		}
+
+		concurrentFor(values.begin(), values.end(), DoubleMapValue()).result();
+
+		for(std::map<int, int>::const_iterator it = values.begin(); it != values.end(); ++ it)
+		{
+			assert(it->first * 2 == it->second && "Wrong value in test47");
+		}
+	}
+
+	std::cout << "---------------------------------------------------------------------\n";
+	std::cout << "Dynamic partitioning tests\n";
+
+	// Test 48: slices taking batches from the shared cursor give every element its index once, with batches not dividing the range exactly
+	{
+		ThreadPool fourPool(4);
+		ThreadPool::Scope scope(fourPool);
+
+		std::vector<float> values(10007, -1.0f);
+		concurrentFor(values.begin(), values.end(), storeIndex, dynamicPartitioner(10)).result();
+
+		for(std::size_t i = 0; i < values.size(); ++ i)
+		{
+			assert(static_cast<float>(i) == values[i] && "Wrong index in test48");
+		}
+
+		std::vector<int> grid(97 * 89, 0);
+		concurrentFor2D(97, 89, 4, CountVisits(grid, 97, 89), dynamicPartitioner(3)).result();
+		assert(std::count(grid.begin(), grid.end(), 1) == static_cast<int>(grid.size()) && "Wrong visits in test48");
+	}
+
+	std::cout << "---------------------------------------------------------------------\n";
+	std::cout << "Parking tests\n";
+
+	// Test 49: a Parker keeps the permit of an unpark() done before park(), several ones count as one, and wakes up blocked threads with and
+	// without spinning
+	{
+		Parker parker(0);
+		parker.unpark();
+		parker.unpark();
+		assert(parker.isNotified() && "Permit lost in test49");
+		parker.park();
+		assert(!parker.isNotified() && "Permit not consumed in test49");
+
+		const Clock::Duration Spins[] = { 0, 1000000 };
+
+		for(std::size_t s = 0; s < sizeof(Spins) / sizeof(Spins[0]); ++ s)
+		{
+			PingPong pingPong(Spins[s]);
+			tthread::thread pongThread(ponger, &pingPong);
+
+			for(int i = 0; i < PingPongRounds; ++ i)
+			{
+				pingPong.ping.unpark();
+				pingPong.pong.park();
+				// Memory written before unpark() is visible after park()
+				assert(i + 1 == pingPong.counter && "Wrong ping pong in test49");
+			}
+
+			pongThread.join();
+		}
+	}
+
+	// Test 50: JobThreads which block without spinning are woken up for every job
+	{
+		ThreadPool twoPool(2);
+		twoPool.setParkSpin(0);
+		ThreadPool::Scope scope(twoPool);
+
+		for(int i = 0; i < 200; ++ i)
+		{
+			const int Expected = executionOrder.load();
+			assert(Expected == launchJob(recordOrder).result() && "Job lost in test50");
+		}
+	}
+
+	// Test 51: while a JobThread searches for jobs enqueuers wake nobody, but the searcher hands the search over so a stream of jobs still spreads
+	// over several JobThreads
+	{
+		ThreadPool fourPool(4);
+		fourPool.setParkSpin(5000000);
+		ThreadPool::Scope scope(fourPool);
+
+		const int JobNumber = 200;
+		executingThreads.assign(JobNumber, tthread::thread::id());
+		std::vector< Future<void> > jobs;
+
+		for(int i = 0; i < JobNumber; ++ i)
+		{
+			jobs.push_back(launchJob(recordThread, i));
+		}
+
+		for(int i = 0; i < JobNumber; ++ i)
+		{
+			jobs[i].result();
+			assert(tthread::thread::id() != executingThreads[i] && "Job not executed in test51");
+		}
+
+		std::sort(executingThreads.begin(), executingThreads.end());
+		assert(1 < std::unique(executingThreads.begin(), executingThreads.end()) - executingThreads.begin() && "Jobs not spread in test51");
+	}
+
+	// Test 64: a burst of blocking jobs enqueued while a JobThread is searching still starts every one of them at once, as every JobThread which
+	// finds a job wakes up another one while jobs are queued
+	{
+		const int ThreadNumber = 4;
+		ThreadPool fourPool(ThreadNumber);
+		fourPool.setParkSpin(50000000);
+		ThreadPool::Scope scope(fourPool);
+
+		// Leaves a JobThread searching
+		launchJob(test).result();
+
+		startedBlockingJobs.store(0);
+		blockingJobNumber = ThreadNumber;
+		std::vector< Future<bool> > blockingJobs;
+
+		for(int i = 0; i < ThreadNumber; ++ i)
+		{
+			blockingJobs.push_back(launchJob(waitForBlockingJobs));
+		}
+
+		for(int i = 0; i < ThreadNumber; ++ i)
+		{
+			assert(blockingJobs[i].result() && "Blocking jobs not started at once in test64");
+		}
+	}
+
+	std::cout << "---------------------------------------------------------------------------\n";
+	std::cout << "Telemetry tests\n";
+
+	// Test 52: histogram buckets double their limit from 128 ns on and percentiles give the limit of the bucket reaching the fraction
+	{
+		assert(0 == LatencyHistogram::bucketOf(0) && 0 == LatencyHistogram::bucketOf(127) && "Wrong first bucket in test52");
+		assert(1 == LatencyHistogram::bucketOf(128) && 255 == LatencyHistogram::bucketLimit(1) && "Wrong second bucket in test52");
+		assert(LatencyHistogram::BucketNumber - 1 == LatencyHistogram::bucketOf(std::numeric_limits<long long>::max()) && "Wrong last bucket in test52");
+
+		LatencyHistogram histogram;
+		histogram.buckets[LatencyHistogram::bucketOf(1000)] = 90;
+		histogram.buckets[LatencyHistogram::bucketOf(100000)] = 10;
+		histogram.maximum = 100000;
+
+		assert(100 == histogram.count() && "Wrong count in test52");
+		assert(1023 == histogram.percentile(0.5) && 1023 == histogram.percentile(0.9) && "Wrong median in test52");
+		assert(100000 == histogram.percentile(0.99) && "Wrong 99th percentile in test52");
+	}
+
+	// Test 53: pool telemetry counts every job, once the pool is quiet nothing is pending, and jobs of different types get their own histograms
+	{
+		ThreadPool twoPool(2);
+		ThreadPool::Scope scope(twoPool);
+
+		const int JobNumber = 50;
+		std::vector< Future<void> > sleeps;
+		std::vector< Future<int> > orders;
+
+		for(int i = 0; i < JobNumber; ++ i)
+		{
+			sleeps.push_back(launchJob(sleepMillisecond));
+			orders.push_back(launchJob(recordOrder));
+		}
+
+		for(int i = 0; i < JobNumber; ++ i)
+		{
+			sleeps[i].result();
+			orders[i].result();
+		}
+
+		// Futures are ready before their jobs are counted, wait for the last ones
+		ThreadPoolTelemetry telemetry = twoPool.telemetry();
+
+		for(int i = 0; i < 1000 && (telemetry.jobTypes.size() < 2 || telemetry.jobTypes[0].executionTime.count() +
+																	   telemetry.jobTypes[1].executionTime.count() < 2 * JobNumber); ++ i)
+		{
+			tthread::this_thread::sleep_for(tthread::chrono::milliseconds(1));
+			telemetry = twoPool.telemetry();
+		}
+
+		assert(2 * JobNumber == static_cast<int>(telemetry.enqueuedJobs) && 0 == telemetry.pendingJobs && "Wrong job count in test53");
+		assert(2 == telemetry.jobThreads.size() && "Wrong JobThread number in test53");
+		assert(telemetry.startedJobs == telemetry.jobThreads[0].executedJobs + telemetry.jobThreads[1].executedJobs && "Wrong thread counts in test53");
+		assert(2 == telemetry.jobTypes.size() && "Job types not separated in test53");
+
+		// Sorted by total execution time, so the sleeping jobs go first
+		assert(JobNumber == static_cast<int>(telemetry.jobTypes[0].executionTime.count()) && "Wrong histogram in test53");
+		assert(1000000 <= telemetry.jobTypes[0].executionTime.maximum && 500000 <= telemetry.jobTypes[0].executionTime.percentile(0.5) &&
+			   "Wrong execution time in test53");
+		assert(JobNumber * 1000000ll <= telemetry.jobThreads[0].busyTime + telemetry.jobThreads[1].busyTime && "Wrong busy time in test53");
+		assert(0.0 < telemetry.jobThreads[0].utilization() + telemetry.jobThreads[1].utilization() && "Wrong utilization in test53");
+
+		std::stringstream text;
+
+		{
+			TelemetryDumper dumper(twoPool, text, 2000000);
+			tthread::this_thread::sleep_for(tthread::chrono::milliseconds(20));
+		}
+
+		assert(std::string::npos != text.str().find("ThreadPool telemetry") && "Nothing dumped in test53");
+	}
+
+	std::cout << "---------------------------------------------------------------------------\n";
+	std::cout << "Tracing tests\n";
+
+	// Test 54: events recorded in any thread are written as Chrome trace JSON, with thread names, ranges and flows, until they are cleared
+	{
+		Trace::clear();
+
+		{
+			Trace::Scope scope("Traced in main");
+			Trace::record(Trace::FlowStart, "Arrow", &scope);
+		}
+
+		tthread::thread thread(traceInThread, 0);
+		thread.join();
+
+		std::stringstream json;
+		Trace::writeChromeTrace(json);
+		const std::string Text = json.str();
+
+		assert(0 == Text.find("{\"traceEvents\":[") && "Wrong document in test54");
+		assert(std::string::npos != Text.find("{\"name\":\"Traced in main\",\"cat\":\"concurrency\",\"ph\":\"B\"") && "Begin missing in test54");
+		assert(std::string::npos != Text.find("\"ph\":\"E\"") && std::string::npos != Text.find("\"ph\":\"s\"") && "End or flow missing in test54");
+		assert(std::string::npos != Text.find("\"name\":\"Tracing thread\"") && "Thread name missing in test54");
+		assert(std::string::npos != Text.find("\"args\":{\"first\":10,\"count\":5}") && "Range missing in test54");
+
+		// Once written, the finished thread's buffer is reused by the next thread instead of adding another one
+		std::size_t bufferNumber = 0;
+
+		for(std::size_t position = Text.find("thread_name"); std::string::npos != position; position = Text.find("thread_name", position + 1))
+		{
+			++ bufferNumber;
+		}
+
+		tthread::thread reusingThread(traceInThread, 0);
+		reusingThread.join();
+
+		json.str("");
+		Trace::writeChromeTrace(json);
+
+		std::size_t reusedBufferNumber = 0;
+
+		for(std::size_t position = json.str().find("thread_name"); std::string::npos != position; position = json.str().find("thread_name", position + 1))
+		{
+			++ reusedBufferNumber;
+		}
+
+		assert(bufferNumber == reusedBufferNumber && "Finished thread's buffer not reused in test54");
+
+#if defined(OLAGARRO_TRACING)
+		// Jobs, slices and enqueues are traced by the module itself
+		std::vector<float> values(1000, 1.0f);
+		concurrentFor(values.begin(), values.end(), Multiply(2), staticPartitioner(100)).result();
+
+		json.str("");
+		Trace::writeChromeTrace(json);
+
+		assert(std::string::npos != json.str().find("concurrentFor range") && "Slices not traced in test54");
+		assert(std::string::npos != json.str().find("\"name\":\"Enqueue\"") && std::string::npos != json.str().find("\"name\":\"Dequeue\"") &&
+			   "Enqueues or dequeues not traced in test54");
+#endif
+
+		Trace::clear();
+		json.str("");
+		Trace::writeChromeTrace(json);
+
+		assert(std::string::npos == json.str().find("Traced in main") && "Events not cleared in test54");
+	}
+
+	// Test 70: writing and clearing the trace while another thread traces gives whole documents, with none of its events garbled
+	{
+		stopTracing.store(0);
+		tthread::thread thread(traceUntilStopped, 0);
+
+		for(int i = 0; i < 20; ++ i)
+		{
+			std::stringstream json;
+			Trace::writeChromeTrace(json);
+			Trace::clear();
+
+			const std::string Text = json.str();
+			const std::string Ending = "\n],\"displayTimeUnit\":\"ns\"}\n";
+
+			assert(0 == Text.find("{\"traceEvents\":[") && Text.size() > Ending.size() && Ending == Text.substr(Text.size() - Ending.size()) &&
+				   "Wrong document in test70");
+		}
+
+		stopTracing.store(1);
+		thread.join();
+
+		Trace::clear();
+		std::stringstream json;
+		Trace::writeChromeTrace(json);
+
+		assert(std::string::npos == json.str().find("\"Busy\"") && "Events not cleared in test70");
+	}
+
+	std::cout << "---------------------------------------------------------------------------\n";
+	std::cout << "Pipeline tests\n";
+
+	// Test 55: a serial stage gets every token in the source's order after a parallel stage which reorders them, with no more tokens in flight
+	// than allowed
+	{
+		ThreadPool fourPool(4);
+		ThreadPool::Scope scope(fourPool);
+
+		const int TokenNumber = 2000;
+		const std::size_t MaxTokens[] = { 1, 3, 16 };
+
+		for(std::size_t i = 0; i < sizeof(MaxTokens) / sizeof(MaxTokens[0]); ++ i)
+		{
+			std::vector<long long> squares;
+			tokensInFlight.store(0);
+			maxTokensInFlight.store(0);
+
+			Future<void> done = Pipeline<PipelineToken>().source(CountTo(TokenNumber))
+														 .stage(ParallelStage, squareToken)
+														 .stage(SerialInOrderStage, CollectSquares(squares))
+														 .run(MaxTokens[i]);
+			done.result();
+
+			assert(TokenNumber == static_cast<int>(squares.size()) && collectedInOrder(squares) && "Tokens lost or out of order in test55");
+			assert(maxTokensInFlight.load() <= static_cast<int>(MaxTokens[i]) && "Too many tokens in flight in test55");
+		}
+	}
+
+	// Test 56: an exception stops the pipeline and is thrown by its future, tokens before it still reach the serial stage in order
+	{
+		std::vector<long long> squares;
+
+		Future<void> failed = Pipeline<PipelineToken>().source(CountTo(1000))
+													   .stage(ParallelStage, squareToken)
+													   .stage(ParallelStage, ThrowAtToken(300))
+													   .stage(SerialInOrderStage, CollectSquares(squares))
+													   .run(8);
+
+		bool thrown = false;
+		try
+		{
+			failed.result();
+		}
+		catch(const std::exception& exception)
+		{
+			thrown = std::string("ThrowAtToken") == exception.what();
+		}
+
+		assert(thrown && failed.isFailed() && "Exception not thrown in test56");
+		assert(squares.size() < 1000 && collectedInOrder(squares) && "Pipeline not stopped in test56");
+	}
+
+	// Test 57: cancelling the pipeline's token stops it
+	{
+		std::vector<long long> squares;
+		CancellationToken token;
+		Future<void> cancelled;
+
+		{
+			CancellationToken::Scope cancellationScope(token);
+
+			cancelled = Pipeline<PipelineToken>().source(CountTo(100000))
+												 .stage(ParallelStage, squareToken)
+												 .stage(SerialInOrderStage, CollectSquares(squares, token, 100))
+												 .run(4);
+		}
+
+		bool thrown = false;
+		try
+		{
+			cancelled.result();
+		}
+		catch(const JobCancelled&)
+		{
+			thrown = true;
+		}
+
+		assert(thrown && cancelled.isCancelled() && squares.size() < 100000 && collectedInOrder(squares) && "Pipeline not cancelled in test57");
+	}
 
 	std::cout << "OK" << std::endl;
 